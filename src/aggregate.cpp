@@ -0,0 +1,552 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "aggregate.h"
+#include "byte_order.h"
+#include "cursor.h"
+#include "input.h"
+
+#include <string.h>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CBOR_AGGREGATE_SSE2
+#endif
+
+namespace cbor {
+
+static const uint64_t tag_typed_first = 64;     //< uint8 typed array
+static const uint64_t tag_typed_last = 87;      //< float128 little endian typed array
+
+/// integers in int64 summed exactly, everything else as doubles
+struct accumulator
+{
+    uint64_t count;
+    uint64_t nulls;
+    uint64_t ints;
+    int64_t int_sum;
+    int64_t int_min;
+    int64_t int_max;
+    double float_sum;
+    double float_min;
+    double float_max;
+    bool inexact;       //< a float, an integer outside int64 or an overflowing sum
+
+    accumulator()
+            : count(0), nulls(0), ints(0), int_sum(0), int_min(INT64_MAX), int_max(INT64_MIN), float_sum(0),
+              float_min(INFINITY), float_max(-INFINITY), inexact(false)
+    {}
+
+    void add_to_sum(int64_t value)
+    {
+        if ((value > 0 and int_sum > INT64_MAX - value) or (value < 0 and int_sum < INT64_MIN - value))
+        {
+            // keeps going in the float sum, the result is no longer exact
+            float_sum += (double) int_sum;
+            int_sum = 0;
+            inexact = true;
+        }
+        int_sum += value;
+    }
+
+    void add_int(int64_t value)
+    {
+        count++;
+        ints++;
+        add_to_sum(value);
+        int_min = value < int_min ? value : int_min;
+        int_max = value > int_max ? value : int_max;
+    }
+
+    /// n integers between min and max adding up to sum
+    void add_ints(uint64_t n, int64_t sum, int64_t min, int64_t max)
+    {
+        if (n == 0)
+            return;
+        count += n;
+        ints += n;
+        add_to_sum(sum);
+        int_min = min < int_min ? min : int_min;
+        int_max = max > int_max ? max : int_max;
+    }
+
+    void add_float(double value)
+    {
+        count++;
+        inexact = true;
+        float_sum += value;
+        float_min = value < float_min ? value : float_min;
+        float_max = value > float_max ? value : float_max;
+    }
+
+    numeric_aggregate finish() const
+    {
+        numeric_aggregate result;
+        result.count = count;
+        result.nulls = nulls;
+        result.sum = float_sum + (double) int_sum;
+        result.min = float_min;
+        result.max = float_max;
+        if (ints != 0)
+        {
+            result.min = (double) int_min < result.min ? (double) int_min : result.min;
+            result.max = (double) int_max > result.max ? (double) int_max : result.max;
+        }
+        result.exact = not inexact;
+        if (result.exact)
+        {
+            result.int_sum = int_sum;
+            result.int_min = int_min;
+            result.int_max = int_max;
+        }
+        return result;
+    }
+};
+
+/// four independent running sums, minima and maxima, so additions do not wait for each other
+class lanes {
+#ifdef CBOR_AGGREGATE_SSE2
+private:
+    __m128d _sum[2];
+    __m128d _min[2];
+    __m128d _max[2];
+
+public:
+    lanes()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            _sum[i] = _mm_setzero_pd();
+            _min[i] = _mm_set1_pd(INFINITY);
+            _max[i] = _mm_set1_pd(-INFINITY);
+        }
+    }
+
+    void add(const double *values)
+    {
+        const __m128d a = _mm_loadu_pd(values);
+        const __m128d b = _mm_loadu_pd(values + 2);
+        _sum[0] = _mm_add_pd(_sum[0], a);
+        _sum[1] = _mm_add_pd(_sum[1], b);
+        // minpd/maxpd return the second operand when one is NaN, so NaN never sticks
+        _min[0] = _mm_min_pd(a, _min[0]);
+        _min[1] = _mm_min_pd(b, _min[1]);
+        _max[0] = _mm_max_pd(a, _max[0]);
+        _max[1] = _mm_max_pd(b, _max[1]);
+    }
+
+    void store(double *sum, double *min, double *max) const
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            _mm_storeu_pd(sum + 2 * i, _sum[i]);
+            _mm_storeu_pd(min + 2 * i, _min[i]);
+            _mm_storeu_pd(max + 2 * i, _max[i]);
+        }
+    }
+#else
+private:
+    double _sum[4];
+    double _min[4];
+    double _max[4];
+
+public:
+    lanes()
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            _sum[i] = 0;
+            _min[i] = INFINITY;
+            _max[i] = -INFINITY;
+        }
+    }
+
+    void add(const double *values)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            _sum[i] += values[i];
+            _min[i] = values[i] < _min[i] ? values[i] : _min[i];
+            _max[i] = values[i] > _max[i] ? values[i] : _max[i];
+        }
+    }
+
+    void store(double *sum, double *min, double *max) const
+    {
+        memcpy(sum, _sum, sizeof(_sum));
+        memcpy(min, _min, sizeof(_min));
+        memcpy(max, _max, sizeof(_max));
+    }
+#endif
+
+    /// adds the n values that went through the lanes to acc
+    void finish(accumulator &acc, uint64_t n) const
+    {
+        if (n == 0)
+            return;
+
+        double sum[4], min[4], max[4];
+        store(sum, min, max);
+        acc.count += n;
+        acc.inexact = true;
+        acc.float_sum += (sum[0] + sum[1]) + (sum[2] + sum[3]);
+        for (int i = 0; i < 4; ++i)
+        {
+            acc.float_min = min[i] < acc.float_min ? min[i] : acc.float_min;
+            acc.float_max = max[i] > acc.float_max ? max[i] : acc.float_max;
+        }
+    }
+};
+
+static double bits_to_double(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double bits_to_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Consecutive float64 items from p on, at most n of them, in blocks of
+ * four whose heads are checked together. Returns how many it took, the
+ * rest goes through add_item().
+ */
+static size_t float64_run(const unsigned char *p, const unsigned char *end, uint64_t n, accumulator &acc)
+{
+    const size_t available = (size_t) (end - p) / 9;
+    const size_t limit = n < available ? (size_t) n : available;
+
+    lanes sums;
+    size_t i = 0;
+    for (; i + 4 <= limit; i += 4)
+    {
+        const unsigned char *item = p + i * 9;
+        if ((item[0] ^ 0xfb) | (item[9] ^ 0xfb) | (item[18] ^ 0xfb) | (item[27] ^ 0xfb))
+            break;
+
+        double values[4];
+        for (int k = 0; k < 4; ++k)
+            values[k] = bits_to_double(load_be64(item + 9 * k + 1));
+        sums.add(values);
+    }
+    sums.finish(acc, i);
+    return i;
+}
+
+/// one element of any numeric kind
+static error_code add_item(cursor &in, accumulator &acc)
+{
+    unsigned major, info;
+    uint64_t argument;
+    const error_code error = read_head(in, major, info, argument);
+    if (error != error_code::ok)
+        return error;
+    if (info == 31)
+        return error_code::wrong_type;
+
+    switch (major)
+    {
+        case 0:
+            if (argument <= (uint64_t) INT64_MAX)
+                acc.add_int((int64_t) argument);
+            else
+                acc.add_float((double) argument);
+            return error_code::ok;
+        case 1:
+            if (argument <= (uint64_t) INT64_MAX)
+                acc.add_int(-1 - (int64_t) argument);
+            else
+                acc.add_float(-1.0 - (double) argument);
+            return error_code::ok;
+        case 7:
+            switch (info)
+            {
+                // null and undefined
+                case 22:
+                case 23:
+                    acc.nulls++;
+                    return error_code::ok;
+                case 25:
+                    acc.add_float(half_to_double((uint16_t) argument));
+                    return error_code::ok;
+                case 26:
+                    acc.add_float(bits_to_float((uint32_t) argument));
+                    return error_code::ok;
+                case 27:
+                    acc.add_float(bits_to_double(argument));
+                    return error_code::ok;
+            }
+            return error_code::wrong_type;
+    }
+    return error_code::wrong_type;
+}
+
+static uint64_t load_u8(const unsigned char *p) { return *p; }
+static uint64_t load_be_u16(const unsigned char *p) { return load_be16(p); }
+static uint64_t load_be_u32(const unsigned char *p) { return load_be32(p); }
+static uint64_t load_be_u64(const unsigned char *p) { return load_be64(p); }
+static uint64_t load_le_u16(const unsigned char *p) { return load_le16(p); }
+static uint64_t load_le_u32(const unsigned char *p) { return load_le32(p); }
+static uint64_t load_le_u64(const unsigned char *p) { return load_le64(p); }
+
+static double load_be_f16(const unsigned char *p) { return half_to_double(load_be16(p)); }
+static double load_be_f32(const unsigned char *p) { return bits_to_float(load_be32(p)); }
+static double load_be_f64(const unsigned char *p) { return bits_to_double(load_be64(p)); }
+static double load_le_f16(const unsigned char *p) { return half_to_double(load_le16(p)); }
+static double load_le_f32(const unsigned char *p) { return bits_to_float(load_le32(p)); }
+static double load_le_f64(const unsigned char *p) { return bits_to_double(load_le64(p)); }
+
+/// typed array of integers narrower than 64 bits: summed in plain int64 blocks that cannot overflow
+template<typename T, uint64_t (*load)(const unsigned char *)>
+static void typed_small_ints(const unsigned char *p, size_t n, accumulator &acc)
+{
+    const size_t block = (size_t) 1 << 24;
+    for (size_t first = 0; first < n; first += block)
+    {
+        const size_t last = n - first < block ? n : first + block;
+        int64_t sum = 0;
+        T min = std::numeric_limits<T>::max();
+        T max = std::numeric_limits<T>::min();
+        for (size_t i = first; i < last; ++i)
+        {
+            const T value = (T) load(p + i * sizeof(T));
+            sum += value;
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+        }
+        acc.add_ints(last - first, sum, min, max);
+    }
+}
+
+template<bool is_signed, uint64_t (*load)(const unsigned char *)>
+static void typed_wide_ints(const unsigned char *p, size_t n, accumulator &acc)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint64_t bits = load(p + i * 8);
+        if (is_signed or bits <= (uint64_t) INT64_MAX)
+            acc.add_int((int64_t) bits);
+        else
+            acc.add_float((double) bits);
+    }
+}
+
+template<size_t width, double (*load)(const unsigned char *)>
+static void typed_floats(const unsigned char *p, size_t n, accumulator &acc)
+{
+    lanes sums;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        double values[4];
+        for (size_t k = 0; k < 4; ++k)
+            values[k] = load(p + (i + k) * width);
+        sums.add(values);
+    }
+    sums.finish(acc, i);
+    for (; i < n; ++i)
+        acc.add_float(load(p + i * width));
+}
+
+/**
+ * RFC 8746 typed array, tag 0b010fsell: f float, s signed, e little
+ * endian, ll the width. Floats have s clear and ll counts from 16 bits.
+ */
+static error_code typed_array(uint64_t tag, const unsigned char *p, size_t size, uint64_t max_size, accumulator &acc)
+{
+    const bool floating = (tag & 16) != 0;
+    const unsigned ll = (unsigned) (tag & 3);
+    const size_t width = floating ? (size_t) 2 << ll : (size_t) 1 << ll;
+    if (floating and ll == 3)
+        return error_code::wrong_type;
+    // 76 would be a signed clamped byte, which is reserved
+    if (tag == 76)
+        return error_code::invalid_tag_content;
+    if (size % width != 0)
+        return error_code::invalid_tag_content;
+
+    const size_t n = size / width;
+    if (n > max_size)
+        return error_code::size_limit;
+
+    if (floating)
+    {
+        const bool little = (tag & 4) != 0;
+        switch (ll)
+        {
+            case 0: little ? typed_floats<2, load_le_f16>(p, n, acc) : typed_floats<2, load_be_f16>(p, n, acc); break;
+            case 1: little ? typed_floats<4, load_le_f32>(p, n, acc) : typed_floats<4, load_be_f32>(p, n, acc); break;
+            default: little ? typed_floats<8, load_le_f64>(p, n, acc) : typed_floats<8, load_be_f64>(p, n, acc); break;
+        }
+        return error_code::ok;
+    }
+
+    // for bytes e marks the clamped variant, which reads the same
+    const bool is_signed = (tag & 8) != 0;
+    const bool little = (tag & 4) != 0;
+    switch (ll)
+    {
+        case 0:
+            is_signed ? typed_small_ints<int8_t, load_u8>(p, n, acc) : typed_small_ints<uint8_t, load_u8>(p, n, acc);
+            break;
+        case 1:
+            if (is_signed)
+                little ? typed_small_ints<int16_t, load_le_u16>(p, n, acc)
+                       : typed_small_ints<int16_t, load_be_u16>(p, n, acc);
+            else
+                little ? typed_small_ints<uint16_t, load_le_u16>(p, n, acc)
+                       : typed_small_ints<uint16_t, load_be_u16>(p, n, acc);
+            break;
+        case 2:
+            if (is_signed)
+                little ? typed_small_ints<int32_t, load_le_u32>(p, n, acc)
+                       : typed_small_ints<int32_t, load_be_u32>(p, n, acc);
+            else
+                little ? typed_small_ints<uint32_t, load_le_u32>(p, n, acc)
+                       : typed_small_ints<uint32_t, load_be_u32>(p, n, acc);
+            break;
+        default:
+            if (is_signed)
+                little ? typed_wide_ints<true, load_le_u64>(p, n, acc) : typed_wide_ints<true, load_be_u64>(p, n, acc);
+            else
+                little ? typed_wide_ints<false, load_le_u64>(p, n, acc)
+                       : typed_wide_ints<false, load_be_u64>(p, n, acc);
+            break;
+    }
+    return error_code::ok;
+}
+
+static error_code aggregate_item(cursor &in, uint64_t max_size, accumulator &acc)
+{
+    unsigned major, info;
+    uint64_t argument;
+    error_code error = read_head(in, major, info, argument);
+    if (error != error_code::ok)
+        return error;
+
+    if (major == 6)
+    {
+        if (info == 31 or argument < tag_typed_first or argument > tag_typed_last)
+            return error_code::wrong_type;
+
+        unsigned bytes_major, bytes_info;
+        uint64_t size;
+        error = read_head(in, bytes_major, bytes_info, size);
+        if (error != error_code::ok)
+            return error;
+        if (bytes_major != 2 or bytes_info == 31)
+            return error_code::invalid_tag_content;
+        if (size > (uint64_t) (in.end - in.p))
+            return error_code::truncated;
+
+        error = typed_array(argument, in.p, (size_t) size, max_size, acc);
+        in.p += size;
+        return error;
+    }
+
+    if (major != 4)
+        return error_code::wrong_type;
+
+    const bool indefinite = info == 31;
+    if (not indefinite)
+    {
+        if (argument > max_size)
+            return error_code::size_limit;
+        // every element takes at least a byte
+        if (argument > (uint64_t) (in.end - in.p))
+            return error_code::truncated;
+    }
+
+    uint64_t left = indefinite ? UINT64_MAX : argument;
+    while (left != 0)
+    {
+        if (in.p == in.end)
+            return error_code::truncated;
+        if (indefinite and *in.p == 0xff)
+        {
+            in.p++;
+            return error_code::ok;
+        }
+
+        // only worth it when the next item is a float64 too, lone ones go item by item
+        if (*in.p == 0xfb and in.end - in.p >= 36 and in.p[9] == 0xfb)
+        {
+            const size_t run = float64_run(in.p, in.end, left, acc);
+            in.p += run * 9;
+            left -= run;
+            if (run != 0)
+                continue;
+        }
+
+        error = add_item(in, acc);
+        if (error != error_code::ok)
+            return error;
+        left--;
+    }
+    return error_code::ok;
+}
+
+static result<numeric_aggregate> aggregate(const unsigned char *data, size_t size, uint64_t max_size,
+                                           size_t &consumed)
+{
+    cursor in = {data, data + size};
+    accumulator acc;
+    const error_code error = aggregate_item(in, max_size, acc);
+    if (error != error_code::ok)
+        return error;
+
+    consumed = (size_t) (in.p - data);
+    return acc.finish();
+}
+
+static numeric_aggregate checked(result<numeric_aggregate> &&value)
+{
+    if (not value)
+        raise(value.error());
+    return value.value();
+}
+
+result<numeric_aggregate> try_aggregate_array(const unsigned char *data, size_t size, size_t &consumed)
+{
+    return aggregate(data, size, UINT64_MAX, consumed);
+}
+
+numeric_aggregate aggregate_array(const unsigned char *data, size_t size)
+{
+    size_t consumed;
+    return checked(try_aggregate_array(data, size, consumed));
+}
+
+result<numeric_aggregate> try_read_aggregate(decoder &dec)
+{
+    size_t consumed;
+    auto value = aggregate(dec.current(), dec.remaining(), dec.limits().max_container_size, consumed);
+    if (value)
+        dec.advance(consumed);
+    return value;
+}
+
+numeric_aggregate read_aggregate(decoder &dec)
+{
+    return checked(try_read_aggregate(dec));
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "decoder.h"
+#include "error.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cbor {
+
+    /**
+     * Count, sum, minimum and maximum of the numbers in an array.
+     *
+     * Integers and floats may be mixed. Null and undefined elements are
+     * skipped like SQL aggregates skip NULL; NaN turns the sum into NaN but
+     * is ignored by min and max. Sums of floats are kept in several lanes
+     * and added up at the end, so they can differ from a left to right sum
+     * in the last bits.
+     */
+    struct numeric_aggregate
+    {
+        uint64_t count;         //< numbers aggregated
+        uint64_t nulls;         //< null and undefined elements
+        double sum;
+        double min;             //< +inf when count is 0
+        double max;             //< -inf when count is 0
+
+        /// all numbers were integers within int64 and so was their sum; the int_ fields are exact then
+        bool exact;
+        int64_t int_sum;
+        int64_t int_min;
+        int64_t int_max;
+
+        numeric_aggregate()
+                : count(0), nulls(0), sum(0), min(INFINITY), max(-INFINITY), exact(true), int_sum(0),
+                  int_min(INT64_MAX), int_max(INT64_MIN)
+        {}
+
+        double mean() const { return count == 0 ? NAN : sum / (double) count; }
+    };
+
+    /*
+     * Aggregates an array of numbers straight from its encoding, nothing is
+     * decoded into values or allocated. The array may be definite or
+     * indefinite length with any mix of integer and float heads; runs of
+     * float64 items (0xfb and 8 bytes each) take a vectorized path. RFC
+     * 8746 typed arrays (tags 64 to 87 on a byte string) are accepted in
+     * place of an array and summed in bulk; float128 ones are not.
+     * Any other element is error_code::wrong_type.
+     */
+
+    /// the array at data, e.g. a value found by map_index; consumed is set to its encoded size
+    result<numeric_aggregate> try_aggregate_array(const unsigned char *data, size_t size, size_t &consumed);
+    numeric_aggregate aggregate_array(const unsigned char *data, size_t size);
+
+    /// pull API: the array at the decoder's position, which it moves past; left where it was on error
+    result<numeric_aggregate> try_read_aggregate(decoder &dec);
+    numeric_aggregate read_aggregate(decoder &dec);
+}
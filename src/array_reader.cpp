@@ -0,0 +1,63 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "array_reader.h"
+
+
+namespace cbor {
+
+size_t array_reader::read_header(const unsigned char *data, size_t size, size_t &count)
+{
+    input in(data, size);
+    decoder dec(in);
+    count = dec.read_array();
+    return dec.offset();
+}
+
+array_reader::array_reader(const unsigned char *data, size_t size, thread_pool &pool, memory_resource *resource)
+        : _count(0),
+          _header(read_header(data, size, _count)),
+          _elements(data + _header, size - _header, pool, resource)
+{
+}
+
+size_t array_reader::scan()
+{
+    if (_elements.scan(_count) != _count)
+        raise("truncated array");
+    return _count;
+}
+
+size_t array_reader::encoded_size() const
+{
+    size_t size = 0;
+    if (_count > 0)
+    {
+        const unsigned char *first = _elements.record(0, size);
+        const unsigned char *last = _elements.record(_count - 1, size);
+        size += last - first;
+    }
+    return _header + size;
+}
+
+void array_reader::run(record_handler &handler)
+{
+    if (_count == 0)
+        return;
+    if (_elements.size() != _count)
+        scan();
+    _elements.run(handler, false);
+}
+
+}
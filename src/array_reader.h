@@ -0,0 +1,75 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "decoder.h"
+#include "sequence_reader.h"
+
+namespace cbor {
+
+    /**
+     * Parallel decoder for the elements of one large array.
+     *
+     * The elements of an array are a CBOR sequence, so boundaries are found
+     * by a sequence_reader limited to the declared element count.
+     */
+    class array_reader {
+    private:
+        size_t _count;
+        size_t _header;
+        sequence_reader _elements;
+
+        static size_t read_header(const unsigned char *data, size_t size, size_t &count);
+
+    public:
+        /// data points at an encoded array
+        array_reader(const unsigned char *data, size_t size, thread_pool &pool,
+                     memory_resource *resource = get_default_resource());
+
+        /// finds element boundaries, throws if the array is truncated
+        size_t scan();
+
+        size_t size() const { return _count; }
+
+        /// encoded size of the whole array, valid after scan()
+        size_t encoded_size() const;
+
+        const unsigned char *element(size_t index, size_t &size) const { return _elements.record(index, size); }
+
+        void set_chunk_size(size_t elements) { _elements.set_chunk_size(elements); }
+
+        void run(record_handler &handler);
+
+        /// decodes element i into slots[i] with fn(decoder &, T &) in parallel
+        template<typename T, typename F>
+        void decode(T *slots, F fn)
+        {
+            class slot_handler : public record_handler {
+                T *_slots;
+                F &_fn;
+            public:
+                slot_handler(T *slots, F &fn) : _slots(slots), _fn(fn) {}
+
+                virtual void on_record(unsigned worker, size_t index, const unsigned char *data, size_t size)
+                {
+                    input in(data, size);
+                    decoder dec(in);
+                    _fn(dec, _slots[index]);
+                }
+            } handler(slots, fn);
+
+            run(handler);
+        }
+    };
+}
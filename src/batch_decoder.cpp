@@ -0,0 +1,141 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "batch_decoder.h"
+#include "byte_order.h"
+#include "cursor.h"
+
+#include <string.h>
+
+namespace cbor {
+
+batch_decoder::batch_decoder(input &in, batch_consumer &consumer)
+        : _in(&in), _consumer(&consumer), _batch(new event_batch)
+{
+    _batch->size = 0;
+    _batch->base = nullptr;
+}
+
+void batch_decoder::flush()
+{
+    if (_batch->size == 0)
+        return;
+
+    _consumer->on_batch(*_batch);
+    _batch->size = 0;
+}
+
+error_code batch_decoder::run()
+{
+    event_batch &batch = *_batch;
+    batch.base = _in->current() - _in->offset();
+
+    cursor in = {_in->current(), _in->current() + _in->remaining()};
+    error_code error = error_code::ok;
+
+    while (in.p < in.end)
+    {
+        const unsigned char *start = in.p;
+        unsigned major, info;
+        uint64_t argument;
+        error = read_definite_head(in, major, info, argument);
+        if (error != error_code::ok)
+            break;
+
+        if ((major == 2 or major == 3) and argument > (uint64_t) (in.end - in.p))
+        {
+            in.p = start;
+            error = error_code::truncated;
+            break;
+        }
+
+        const size_t i = batch.size;
+        batch.value[i] = (int64_t) argument;
+
+        switch (major)
+        {
+            case 0:
+                batch.type[i] = argument <= INT64_MAX ? event_type::integer : event_type::big_positive;
+                break;
+            case 1:
+                if (argument <= INT64_MAX)
+                {
+                    batch.type[i] = event_type::integer;
+                    batch.value[i] = -1 - (int64_t) argument;
+                } else
+                {
+                    batch.type[i] = event_type::big_negative;
+                }
+                break;
+            case 2:
+            case 3:
+                // strings stay in the input
+                batch.type[i] = major == 2 ? event_type::bytes : event_type::string;
+                batch.offset[i] = in.p - batch.base;
+                in.p += argument;
+                break;
+            case 4:
+                batch.type[i] = event_type::array;
+                break;
+            case 5:
+                batch.type[i] = event_type::map;
+                break;
+            case 6:
+                batch.type[i] = event_type::tag;
+                break;
+            default:
+                switch (info)
+                {
+                    case 20:
+                    case 21:
+                        batch.type[i] = event_type::boolean;
+                        batch.value[i] = info == 21;
+                        break;
+                    case 22:
+                        batch.type[i] = event_type::null;
+                        break;
+                    case 23:
+                        batch.type[i] = event_type::undefined;
+                        break;
+                    case 25:
+                        batch.type[i] = event_type::floating;
+                        batch.number[i] = half_to_double((uint16_t) argument);
+                        break;
+                    case 26: {
+                        const uint32_t bits = (uint32_t) argument;
+                        float value;
+                        memcpy(&value, &bits, sizeof(value));
+                        batch.type[i] = event_type::floating;
+                        batch.number[i] = value;
+                        break;
+                    }
+                    case 27:
+                        batch.type[i] = event_type::floating;
+                        memcpy(&batch.number[i], &argument, sizeof(double));
+                        break;
+                    default:
+                        batch.type[i] = event_type::simple;
+                }
+        }
+
+        if (++batch.size == event_batch::capacity)
+            flush();
+    }
+
+    _in->advance(in.p - _in->current());
+    flush();
+    return error;
+}
+
+}
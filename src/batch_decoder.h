@@ -0,0 +1,97 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "input.h"
+#include "error.h"
+
+#include <stdint.h>
+#include <memory>
+
+namespace cbor {
+
+    enum class event_type : uint8_t
+    {
+        integer,        //< value
+        big_positive,   //< value holds the bits of a uint64_t above INT64_MAX
+        big_negative,   //< -1 - value, value holds the bits of the uint64_t argument
+        bytes,          //< offset and value (length) into the input
+        string,         //< offset and value (length) into the input
+        array,          //< value elements follow
+        map,            //< value key/value pairs follow
+        tag,            //< value, the tagged item follows
+        simple,         //< value
+        boolean,        //< value 0 or 1
+        null,
+        undefined,
+        floating        //< number, half and single precision are widened
+    };
+
+    /**
+     * Struct of arrays holding up to capacity events. Only the columns the
+     * type uses are written, so loops should switch on type[i] or filter on
+     * it first.
+     */
+    struct event_batch
+    {
+        static const size_t capacity = 1024;
+
+        size_t size;
+        /// start of the input, offsets are relative to it
+        const unsigned char *base;
+
+        event_type type[capacity];
+        int64_t value[capacity];
+        double number[capacity];
+        uint64_t offset[capacity];
+
+        const unsigned char *data(size_t i) const { return base + offset[i]; }
+    };
+
+    class batch_consumer {
+    public:
+        virtual ~batch_consumer() {}
+
+        /// the batch and the strings it points at are valid during the call
+        virtual void on_batch(const event_batch &batch) = 0;
+    };
+
+    /**
+     * Decodes a flat stream of events into batches instead of calling a
+     * listener per item. Nesting is not tracked: arrays, maps and tags are
+     * events carrying their size and the items follow them.
+     */
+    class batch_decoder {
+    private:
+        input *_in;
+        batch_consumer *_consumer;
+        std::unique_ptr<event_batch> _batch;
+
+        void flush();
+
+    public:
+        batch_decoder(input &in, batch_consumer &consumer);
+
+        /// continue on another buffer, see decoder::set_input()
+        void set_input(input &in) { _in = &in; }
+
+        /**
+         * Decodes until the input is used up and hands over every event,
+         * the last batch may be partly filled. Returns truncated if it
+         * stopped before an incomplete item (input::remaining() bytes are
+         * left), invalid_additional_info on malformed input.
+         */
+        error_code run();
+    };
+}
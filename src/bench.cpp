@@ -0,0 +1,1031 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbor.h"
+#include "perf_counters.h"
+
+/*
+ * cbor-bench [--filter text] [--samples n] [--min-time ms] [--json file] [--list] [--counters]
+ *
+ * Micro benchmarks of the encoder, the pull decoder, run(), skip() and the
+ * output sinks, and macro benchmarks over generated corpora. Each benchmark
+ * is calibrated so one sample takes at least min-time, then timed over
+ * several samples and reported as MB/s and items/s with the relative
+ * standard deviation; benchmarks that do not read all their input, like
+ * decoding blobs in place, report items/s only. --json writes every
+ * sample so runs can be diffed.
+ *
+ * --counters adds one sample under hardware counters (perf_counters) and
+ * reports cycles per byte, instructions per item, IPC and misses per item.
+ * Only the calling thread is counted, not the workers of parallel runs.
+ *
+ * Built with CBORCPP_STATS the totals of get_stats() over the whole run
+ * follow the results.
+ */
+
+using namespace cbor;
+
+namespace {
+
+// results go here so the compiler can not drop the work
+volatile uint64_t sink;
+
+struct options
+{
+    std::string filter;
+    std::string json;
+    int samples;
+    double min_time;    // seconds per sample
+    bool list;
+    bool counters;
+
+    options() : samples(10), min_time(0.05), list(false), counters(false) {}
+};
+
+struct bench_result
+{
+    std::string name;
+    double bytes;       // per iteration
+    double items;
+    size_t iterations;  // per sample
+    std::vector<double> seconds; // per iteration, one entry per sample
+    bool counted;
+    double counters[perf_counters::counter_count]; // per iteration, when counted
+};
+
+class harness {
+private:
+    options _options;
+    std::vector<bench_result> _results;
+    std::unique_ptr<perf_counters> _counters;
+
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static double time(size_t iterations, const std::function<void()> &body)
+    {
+        const double start = now();
+        for (size_t i = 0; i < iterations; ++i)
+            body();
+        return now() - start;
+    }
+
+    static void mean_stddev(const std::vector<double> &values, double &mean, double &stddev)
+    {
+        mean = 0;
+        for (double v : values)
+            mean += v;
+        mean /= values.size();
+
+        stddev = 0;
+        for (double v : values)
+            stddev += (v - mean) * (v - mean);
+        stddev = values.size() > 1 ? sqrt(stddev / (values.size() - 1)) : 0;
+    }
+
+public:
+    explicit harness(const options &opts) : _options(opts)
+    {
+        if (not opts.counters or opts.list)
+            return;
+
+        _counters.reset(new perf_counters);
+        if (not _counters->available())
+        {
+            fprintf(stderr, "cbor-bench: no hardware counters (%s), timing only\n", _counters->error().c_str());
+            _counters.reset();
+        }
+    }
+
+    bool selected(const std::string &name) const
+    {
+        return _options.filter.empty() or name.find(_options.filter) != std::string::npos;
+    }
+
+    /// body processes bytes bytes and items items per call
+    void run(const std::string &name, double bytes, double items, const std::function<void()> &body)
+    {
+        if (not selected(name))
+            return;
+        if (_options.list)
+        {
+            printf("%s\n", name.c_str());
+            return;
+        }
+
+        body(); // warm up caches and allocations
+
+        size_t iterations = 1;
+        double elapsed;
+        while ((elapsed = time(iterations, body)) < _options.min_time / 8)
+            iterations *= 2;
+        iterations = std::max<size_t>(1, (size_t) (iterations * _options.min_time / elapsed));
+
+        bench_result result;
+        result.name = name;
+        result.bytes = bytes;
+        result.items = items;
+        result.iterations = iterations;
+        for (int s = 0; s < _options.samples; ++s)
+            result.seconds.push_back(time(iterations, body) / iterations);
+
+        result.counted = _counters != nullptr;
+        if (result.counted)
+        {
+            _counters->start();
+            time(iterations, body);
+            _counters->stop();
+            for (int c = 0; c < perf_counters::counter_count; ++c)
+                result.counters[c] = (double) _counters->value((perf_counters::counter) c) / iterations;
+        }
+
+        std::vector<double> mbs, ips;
+        for (double t : result.seconds)
+        {
+            mbs.push_back(bytes / t / 1e6);
+            ips.push_back(items / t);
+        }
+        double mb_mean, mb_dev, items_mean, items_dev;
+        mean_stddev(mbs, mb_mean, mb_dev);
+        mean_stddev(ips, items_mean, items_dev);
+
+        if (bytes > 0)
+            printf("%-48s %10.1f MB/s", name.c_str(), mb_mean);
+        else
+            printf("%-48s %10s MB/s", name.c_str(), "-");
+        printf(" %12.2f Mitems/s  +-%4.1f%%\n", items_mean / 1e6, mb_mean > 0 ? 100 * mb_dev / mb_mean : 100 * items_dev / items_mean);
+        if (result.counted)
+            print_counters(result);
+        fflush(stdout);
+
+        _results.push_back(result);
+    }
+
+    void print_counters(const bench_result &r) const
+    {
+        const double *c = r.counters;
+        printf("    ");
+        if (_counters->has(perf_counters::cycles) and r.bytes > 0)
+            printf(" %.2f cycles/byte", c[perf_counters::cycles] / r.bytes);
+        if (_counters->has(perf_counters::cycles))
+            printf(" %.1f cycles/item", c[perf_counters::cycles] / r.items);
+        if (_counters->has(perf_counters::instructions))
+            printf(" %.1f instructions/item", c[perf_counters::instructions] / r.items);
+        if (_counters->has(perf_counters::cycles) and _counters->has(perf_counters::instructions) and c[perf_counters::cycles] > 0)
+            printf(" %.2f IPC", c[perf_counters::instructions] / c[perf_counters::cycles]);
+        if (_counters->has(perf_counters::branch_misses))
+            printf(" %.3f branch-misses/item", c[perf_counters::branch_misses] / r.items);
+        if (_counters->has(perf_counters::l1d_misses))
+            printf(" %.3f L1D-misses/item", c[perf_counters::l1d_misses] / r.items);
+        if (_counters->has(perf_counters::llc_misses))
+            printf(" %.3f LLC-misses/item", c[perf_counters::llc_misses] / r.items);
+        printf("\n");
+    }
+
+    void write_json() const
+    {
+        if (_options.json.empty())
+            return;
+
+        FILE *file = fopen(_options.json.c_str(), "w");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "cbor-bench: cannot write %s\n", _options.json.c_str());
+            return;
+        }
+
+        fprintf(file, "{\"samples\":%d,\"min_time\":%g,\"benchmarks\":[\n", _options.samples, _options.min_time);
+        for (size_t i = 0; i < _results.size(); ++i)
+        {
+            const bench_result &r = _results[i];
+            std::vector<double> mbs, ips;
+            for (double t : r.seconds)
+            {
+                mbs.push_back(r.bytes / t / 1e6);
+                ips.push_back(r.items / t);
+            }
+            double mb_mean, mb_dev, items_mean, items_dev;
+            mean_stddev(mbs, mb_mean, mb_dev);
+            mean_stddev(ips, items_mean, items_dev);
+
+            fprintf(file, "{\"name\":\"%s\",\"bytes\":%.0f,\"items\":%.0f,\"iterations\":%zu,"
+                          "\"mb_per_s\":%.3f,\"mb_per_s_stddev\":%.3f,\"items_per_s\":%.1f,\"items_per_s_stddev\":%.1f,"
+                          "\"seconds\":[",
+                    r.name.c_str(), r.bytes, r.items, r.iterations, mb_mean, mb_dev, items_mean, items_dev);
+            for (size_t s = 0; s < r.seconds.size(); ++s)
+                fprintf(file, "%s%.9g", s == 0 ? "" : ",", r.seconds[s]);
+            fprintf(file, "]");
+
+            if (r.counted)
+            {
+                // per iteration; missing counters are left out
+                fprintf(file, ",\"counters\":{");
+                bool first = true;
+                for (int c = 0; c < perf_counters::counter_count; ++c)
+                {
+                    if (not _counters->has((perf_counters::counter) c))
+                        continue;
+                    fprintf(file, "%s\"%s\":%.1f", first ? "" : ",", perf_counters::name((perf_counters::counter) c), r.counters[c]);
+                    first = false;
+                }
+                fprintf(file, "}");
+                if (_counters->has(perf_counters::cycles) and r.bytes > 0)
+                    fprintf(file, ",\"cycles_per_byte\":%.4f", r.counters[perf_counters::cycles] / r.bytes);
+                if (_counters->has(perf_counters::instructions))
+                    fprintf(file, ",\"instructions_per_item\":%.4f", r.counters[perf_counters::instructions] / r.items);
+            }
+            fprintf(file, "}%s\n", i + 1 == _results.size() ? "" : ",");
+        }
+        fprintf(file, "]}\n");
+        fclose(file);
+    }
+};
+
+class null_listener : public listener {
+public:
+    uint64_t events;
+
+    null_listener() : events(0) {}
+
+    void on_integer(int value) override { events++; }
+    void on_bytes(unsigned char *data, int size) override { events++; }
+    void on_string(std::string &str) override { events++; }
+    void on_array(int size) override { events++; }
+    void on_map(int size) override { events++; }
+    void on_tag(unsigned int tag) override { events++; }
+    void on_special(unsigned int code) override { events++; }
+    void on_bool(bool) override { events++; }
+    void on_null() override { events++; }
+    void on_undefined() override { events++; }
+    void on_half(float v) override { events++; }
+    void on_float(float v) override { events++; }
+    void on_double(double v) override { events++; }
+    void on_error(const char *error) override { fprintf(stderr, "cbor-bench: %s\n", error); exit(1); }
+    void on_extra_integer(unsigned long long value, int sign) override { events++; }
+    void on_extra_tag(unsigned long long tag) override { events++; }
+    void on_extra_special(unsigned long long tag) override { events++; }
+    void on_extra_array(unsigned long long size) override { events++; }
+    void on_extra_map(unsigned long long size) override { events++; }
+    void on_extra_bytes(unsigned char *data, unsigned long long size) override { events++; }
+};
+
+class null_consumer : public batch_consumer {
+public:
+    uint64_t events;
+
+    null_consumer() : events(0) {}
+
+    void on_batch(const event_batch &batch) override { events += batch.size; }
+};
+
+/// generated test data, one CBOR sequence per corpus
+struct corpus
+{
+    std::string name;
+    std::vector<unsigned char> data;
+    size_t records;
+    uint64_t items;     // data items, as counted by run()
+};
+
+corpus make_corpus(const std::string &name, size_t records, const std::function<void(encoder &, size_t)> &write)
+{
+    output_dynamic out(1 << 20);
+    encoder enc(out);
+    for (size_t i = 0; i < records; ++i)
+        write(enc, i);
+
+    corpus c;
+    c.name = name;
+    c.data.assign(out.data(), out.data() + out.size());
+    c.records = records;
+
+    input in(c.data.data(), c.data.size());
+    null_listener counter;
+    decoder dec(in, counter);
+    dec.run();
+    c.items = counter.events;
+    return c;
+}
+
+std::vector<corpus> make_corpora()
+{
+    std::vector<corpus> corpora;
+    std::mt19937_64 random(42);
+
+    // small-int telemetry: fixed arrays of sensor readings
+    corpora.push_back(make_corpus("telemetry", 200000, [&](encoder &enc, size_t i) {
+        enc.write_array(8);
+        enc.write_int((unsigned int) i);
+        for (int k = 0; k < 7; ++k)
+            enc.write_int((int) (random() % 2000) - 1000);
+    }));
+
+    // string keyed records
+    static const char *const names[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot"};
+    corpora.push_back(make_corpus("records", 50000, [&](encoder &enc, size_t i) {
+        enc.write_map(7);
+        enc.write_string("id");
+        enc.write_int((unsigned long long) i);
+        enc.write_string("name");
+        enc.write_string(std::string(names[i % 6]) + " " + std::to_string(random() % 100000));
+        enc.write_string("email");
+        enc.write_string("user" + std::to_string(i) + "@example.com");
+        enc.write_string("active");
+        enc.write_bool(i % 3 != 0);
+        enc.write_string("score");
+        enc.write_double((double) (random() % 1000000) / 1000);
+        enc.write_string("tags");
+        enc.write_array(2);
+        enc.write_string(names[random() % 6]);
+        enc.write_string(names[random() % 6]);
+        enc.write_string("region");
+        enc.write_int((int) (random() % 50));
+    }));
+
+    // float arrays
+    corpora.push_back(make_corpus("floats", 1000, [&](encoder &enc, size_t i) {
+        enc.write_array(1000);
+        std::uniform_real_distribution<double> values(-1e6, 1e6);
+        for (int k = 0; k < 1000; ++k)
+            enc.write_double(values(random));
+    }));
+
+    // deep nesting, under the default depth limit
+    corpora.push_back(make_corpus("nesting", 2000, [&](encoder &enc, size_t i) {
+        for (int depth = 0; depth < 200; ++depth)
+        {
+            if (depth % 2 == 0)
+                enc.write_array(1);
+            else
+            {
+                enc.write_map(1);
+                enc.write_string("k");
+            }
+        }
+        enc.write_int((unsigned int) i);
+    }));
+
+    // big blobs
+    corpora.push_back(make_corpus("blobs", 64, [&](encoder &enc, size_t i) {
+        std::vector<unsigned char> blob(256 * 1024);
+        for (size_t k = 0; k < blob.size(); ++k)
+            blob[k] = (unsigned char) random();
+        enc.write_bytes(blob.data(), (unsigned int) blob.size());
+    }));
+
+    return corpora;
+}
+
+/// n items written by write, encoded once
+std::vector<unsigned char> encode_items(size_t n, const std::function<void(encoder &, size_t)> &write)
+{
+    output_dynamic out(1 << 16);
+    encoder enc(out);
+    for (size_t i = 0; i < n; ++i)
+        write(enc, i);
+    return std::vector<unsigned char>(out.data(), out.data() + out.size());
+}
+
+void bench_encoder(harness &h)
+{
+    const size_t n = 10000;
+    output_dynamic out(1 << 20);
+    encoder enc(out);
+
+    // generic lambdas, so write is inlined into the loop
+    auto encode = [&](const std::string &name, size_t count, auto write) {
+        if (not h.selected(name))
+            return;
+        out.clear();
+        for (size_t i = 0; i < count; ++i)
+            write(i);
+        const double bytes = out.size();
+        h.run(name, bytes, (double) count, [&]() {
+            out.clear();
+            for (size_t i = 0; i < count; ++i)
+                write(i);
+            sink += out.size();
+        });
+    };
+
+    encode("encoder/write_int/small", n, [&](size_t i) { enc.write_int((int) (i & 15)); });
+    encode("encoder/write_int/uint32", n, [&](size_t i) { enc.write_int((unsigned int) (i * 2654435761u)); });
+    encode("encoder/write_int/int64", n, [&](size_t i) { enc.write_int(-(long long) (i * 0x9E3779B97F4AULL)); });
+    encode("encoder/write_float", n, [&](size_t i) { enc.write_float((float) i * 0.5f); });
+    encode("encoder/write_double", n, [&](size_t i) { enc.write_double((double) i * 0.1); });
+    encode("encoder/write_string/16", n, [&](size_t i) { enc.write_string("0123456789abcdef", 16); });
+    static const unsigned char kilobyte[1024] = {0};
+    encode("encoder/write_bytes/1k", n / 10, [&](size_t i) { enc.write_bytes(kilobyte, sizeof(kilobyte)); });
+    encode("encoder/write_array", n, [&](size_t i) { enc.write_array(i & 31); });
+    encode("encoder/write_map", n, [&](size_t i) { enc.write_map(i & 31); });
+    encode("encoder/write_tag", n, [&](size_t i) { enc.write_tag(1); });
+    encode("encoder/write_bool", n, [&](size_t i) { enc.write_bool(i & 1); });
+    encode("encoder/write_null", n, [&](size_t i) { enc.write_null(); });
+    encode("encoder/write_undefined", n, [&](size_t i) { enc.write_undefined(); });
+    encode("encoder/write_special", n, [&](size_t i) { enc.write_special((int) (i & 255)); });
+    encode("encoder/write_negative", n, [&](size_t i) { enc.write_negative(i * 0x9E3779B97F4A7C15ULL); });
+
+    const std::string text16 = "0123456789abcdef";
+    encode("encoder/write_string/std_string_16", n, [&](size_t i) { enc.write_string(text16); });
+
+    // tagged items
+    const std::string datetime = "2024-05-01T12:30:00Z";
+    static const unsigned char magnitude[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    encode("encoder/write_datetime", n, [&](size_t i) { enc.write_datetime(datetime); });
+    encode("encoder/write_epoch/int", n, [&](size_t i) { enc.write_epoch((long long) (1700000000 + i)); });
+    encode("encoder/write_epoch/double", n, [&](size_t i) { enc.write_epoch(1700000000.5 + (double) i); });
+    encode("encoder/write_bignum/16", n, [&](size_t i) { enc.write_bignum(magnitude, sizeof(magnitude), i & 1); });
+#ifdef __SIZEOF_INT128__
+    encode("encoder/write_int128", n, [&](size_t i) { enc.write_int128((__int128) i << 70); });
+#endif
+    encode("encoder/write_decimal", n, [&](size_t i) { enc.write_decimal(-2, (long long) i * 12345); });
+    encode("encoder/write_bigfloat", n, [&](size_t i) { enc.write_bigfloat(-1, (long long) i * 3); });
+}
+
+void bench_decoder(harness &h)
+{
+    const size_t n = 10000;
+
+    auto decode = [&](const std::string &name, size_t count, const std::vector<unsigned char> &data, auto read) {
+        h.run(name, (double) data.size(), (double) count, [&]() {
+            input in(data.data(), data.size());
+            decoder dec(in);
+            for (size_t i = 0; i < count; ++i)
+                read(dec);
+        });
+    };
+
+    const std::vector<unsigned char> uints = encode_items(n, [](encoder &enc, size_t i) { enc.write_int((unsigned int) (i * 2654435761u)); });
+    const std::vector<unsigned char> longs = encode_items(n, [](encoder &enc, size_t i) { enc.write_int(-(long long) (i * 0x9E3779B97F4AULL)); });
+    const std::vector<unsigned char> floats = encode_items(n, [](encoder &enc, size_t i) { enc.write_float((float) i * 0.5f); });
+    const std::vector<unsigned char> doubles = encode_items(n, [](encoder &enc, size_t i) { enc.write_double((double) i * 0.1); });
+    const std::vector<unsigned char> strings = encode_items(n, [](encoder &enc, size_t i) { enc.write_string("0123456789abcdef", 16); });
+    const std::vector<unsigned char> bools = encode_items(n, [](encoder &enc, size_t i) { enc.write_bool(i & 1); });
+    const std::vector<unsigned char> arrays = encode_items(n, [](encoder &enc, size_t i) { enc.write_array(0); });
+    const std::vector<unsigned char> maps = encode_items(n, [](encoder &enc, size_t i) { enc.write_map(0); });
+    const std::vector<unsigned char> tags = encode_items(n, [](encoder &enc, size_t i) { enc.write_tag(1); enc.write_int(0); });
+
+    const std::vector<unsigned char> ints = encode_items(n, [](encoder &enc, size_t i) { enc.write_int((int) (i * 2654435761u) >> 4); });
+    const std::vector<unsigned char> ulongs = encode_items(n, [](encoder &enc, size_t i) { enc.write_int((unsigned long long) (i * 0x9E3779B97F4A7C15ULL)); });
+
+    static const char *const key_names[] = {"id", "name", "email", "active", "score", "tags", "region", "created"};
+    const std::vector<std::string> key_list(key_names, key_names + 8);
+    const key_table keys(key_list);
+    const std::vector<unsigned char> key_strings = encode_items(n, [&](encoder &enc, size_t i) { enc.write_string(key_list[i % 8]); });
+
+    decode("decoder/read_uint", n, uints, [](decoder &dec) { sink += dec.read_uint(); });
+    decode("decoder/read_int", n, ints, [](decoder &dec) { sink += dec.read_int(); });
+    decode("decoder/read_ulong", n, ulongs, [](decoder &dec) { sink += dec.read_ulong(); });
+    decode("decoder/try_read_uint", n, uints, [](decoder &dec) { sink += dec.try_read_uint().value(); });
+    decode("decoder/read_long", n, longs, [](decoder &dec) { sink += dec.read_long(); });
+    decode("decoder/read_float", n, floats, [](decoder &dec) { sink += (uint64_t) dec.read_float(); });
+    decode("decoder/read_double", n, doubles, [](decoder &dec) { sink += (uint64_t) dec.read_double(); });
+    decode("decoder/read_string", n, strings, [](decoder &dec) { sink += dec.read_string().size(); });
+    decode("decoder/read_pmr_string", n, strings, [](decoder &dec) { sink += dec.read_pmr_string().size(); });
+    decode("decoder/read_string/zero_copy", n, strings, [](decoder &dec) {
+        size_t size;
+        dec.read_string(size);
+        sink += size;
+    });
+    decode("decoder/read_bool", n, bools, [](decoder &dec) { sink += dec.read_bool(); });
+    decode("decoder/read_array", n, arrays, [](decoder &dec) { sink += dec.read_array(); });
+    decode("decoder/read_map", n, maps, [](decoder &dec) { sink += dec.read_map(); });
+    decode("decoder/read_tag", n, tags, [](decoder &dec) { sink += dec.read_tag() + dec.read_uint(); });
+    decode("decoder/read_key", n, key_strings, [&](decoder &dec) { sink += dec.read_key(keys); });
+    decode("decoder/skip/strings", n, strings, [](decoder &dec) { dec.skip(); });
+
+    // the probing path: asking a string whether it is an integer
+    decode("decoder/mismatch/try_read_uint", n, strings, [](decoder &dec) {
+        if (not dec.try_read_uint().ok())
+            dec.skip();
+    });
+#ifndef CBOR_NO_EXCEPTIONS
+    decode("decoder/mismatch/read_uint_throw", n, strings, [](decoder &dec) {
+        try
+        {
+            sink += dec.read_uint();
+        } catch (const decode_error &)
+        {
+            dec.skip();
+        }
+    });
+#endif
+
+    // big-endian loads
+    h.run("input/get_long", (double) doubles.size(), (double) n, [&]() {
+        input in(doubles.data(), doubles.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            in.get_byte();
+            sink += in.get_long();
+        }
+    });
+}
+
+void bench_outputs(harness &h)
+{
+    const size_t n = 100000;
+    static const unsigned char chunk[64] = {0};
+
+    output_dynamic dynamic(1 << 20);
+    h.run("output/dynamic/put_byte", (double) n, (double) n, [&]() {
+        dynamic.clear();
+        for (size_t i = 0; i < n; ++i)
+            dynamic.put_byte((unsigned char) i);
+        sink += dynamic.size();
+    });
+    h.run("output/dynamic/put_bytes/64", 64.0 * n, (double) n, [&]() {
+        dynamic.clear();
+        for (size_t i = 0; i < n; ++i)
+            dynamic.put_bytes(chunk, sizeof(chunk));
+        sink += dynamic.size();
+    });
+
+    output_static fixed(n * 64);
+    h.run("output/static/put_bytes/64", 64.0 * n, (double) n, [&]() {
+        fixed.clear();
+        for (size_t i = 0; i < n; ++i)
+            fixed.put_bytes(chunk, sizeof(chunk));
+        sink += fixed.size();
+    });
+
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0)
+    {
+        output_file file(null_fd);
+        h.run("output/file/put_bytes/64", 64.0 * n, (double) n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                file.put_bytes(chunk, sizeof(chunk));
+            file.flush();
+        });
+        h.run("output/file/put_byte", (double) n, (double) n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                file.put_byte((unsigned char) i);
+            file.flush();
+        });
+    }
+    if (null_fd >= 0)
+        close(null_fd);
+}
+
+void bench_corpora(harness &h, const std::vector<corpus> &corpora)
+{
+    for (const corpus &c : corpora)
+    {
+        const double bytes = (double) c.data.size();
+        const double items = (double) c.items;
+        const std::string prefix = "corpus/" + c.name + "/";
+        // run(), skip() and batch_decoder hand out byte strings in place, so
+        // blob payloads are never read and MB/s would only count headers
+        const double scanned = c.name == "blobs" ? 0 : bytes;
+
+        h.run(prefix + "run", scanned, items, [&]() {
+            input in(c.data.data(), c.data.size());
+            null_listener counter;
+            decoder dec(in, counter);
+            dec.run();
+            sink += counter.events;
+        });
+
+        h.run(prefix + "skip", scanned, (double) c.records, [&]() {
+            input in(c.data.data(), c.data.size());
+            decoder dec(in);
+            for (size_t i = 0; i < c.records; ++i)
+                dec.skip();
+            sink += in.offset();
+        });
+
+        h.run(prefix + "batch_decoder", scanned, items, [&]() {
+            input in(c.data.data(), c.data.size());
+            null_consumer consumer;
+            batch_decoder dec(in, consumer);
+            dec.run();
+            sink += consumer.events;
+        });
+
+        output_dynamic text(1 << 20);
+        h.run(prefix + "listener_json", bytes, items, [&]() {
+            text.clear();
+            input in(c.data.data(), c.data.size());
+            listener_json json(text);
+            decoder dec(in, json);
+            dec.run();
+            json.flush();
+            sink += text.size();
+        });
+
+        h.run(prefix + "listener_diag", bytes, items, [&]() {
+            text.clear();
+            input in(c.data.data(), c.data.size());
+            listener_diag diag(text);
+            decoder dec(in, diag);
+            dec.run();
+            diag.flush();
+            sink += text.size();
+        });
+
+        // back from JSON; blobs are not worth it as base64
+        if (c.name == "blobs")
+            continue;
+
+        text.clear();
+        {
+            input in(c.data.data(), c.data.size());
+            listener_json json(text);
+            decoder dec(in, json);
+            dec.run();
+        }
+        const std::string json_text((const char *) text.data(), text.size());
+        output_dynamic encoded(1 << 20);
+        json_reader reader;
+        h.run(prefix + "json_reader", (double) json_text.size(), items, [&]() {
+            encoded.clear();
+            encoder enc(encoded);
+            reader.try_convert(json_text.data(), json_text.size(), enc);
+            sink += encoded.size();
+        });
+    }
+}
+
+void bench_text(harness &h)
+{
+    const size_t size = 1 << 20;
+    std::mt19937_64 random(7);
+
+    std::string ascii(size, ' ');
+    for (size_t i = 0; i < size; ++i)
+        ascii[i] = (char) (' ' + random() % 95);
+
+    // mostly two and three byte sequences
+    std::string mixed;
+    static const char *const pieces[] = {"a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "text "};
+    while (mixed.size() < size)
+        mixed += pieces[random() % 5];
+
+    h.run("utf8/validate/ascii", (double) ascii.size(), 1, [&]() { sink += is_valid_utf8(ascii.data(), ascii.size()); });
+    h.run("utf8/validate/mixed", (double) mixed.size(), 1, [&]() { sink += is_valid_utf8(mixed.data(), mixed.size()); });
+
+    const size_t n = 10000;
+    std::vector<double> values(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint64_t bits = random() % 0x7fe0000000000000ULL;
+        memcpy(&values[i], &bits, sizeof(double));
+    }
+    h.run("dtoa/format_double", 8.0 * n, (double) n, [&]() {
+        char text[32];
+        for (double v : values)
+            sink += format_double(v, text);
+    });
+    h.run("dtoa/snprintf_17g", 8.0 * n, (double) n, [&]() {
+        char text[32];
+        for (double v : values)
+            sink += snprintf(text, sizeof(text), "%.17g", v);
+    });
+}
+
+void bench_log(harness &h)
+{
+    const size_t size = 1 << 20;
+    std::vector<unsigned char> block(size);
+    std::mt19937_64 random(11);
+    for (auto &b : block)
+        b = (unsigned char) random();
+
+    h.run("crc32c/1M", (double) size, 1, [&]() { sink += crc32c(block.data(), block.size()); });
+    h.run("crc32c/64", 64.0 * 16384, 16384, [&]() {
+        uint32_t crc = 0;
+        for (size_t i = 0; i + 64 <= size; i += 64)
+            crc ^= crc32c(block.data() + i, 64);
+        sink += crc;
+    });
+
+    // records of 48 bytes, the size of a small event
+    const size_t n = 100000, record = 48;
+    output_dynamic framed(n * (record + log_header_size));
+    h.run("log/append/48", (double) (n * record), (double) n, [&]() {
+        framed.clear();
+        log_writer writer(framed);
+        for (size_t i = 0; i < n; ++i)
+            writer.append(block.data() + i % 1024, record);
+        sink += framed.size();
+    });
+    h.run("log/read/48", (double) (n * record), (double) n, [&]() {
+        input in(framed.data(), framed.size());
+        log_reader reader(in);
+        const unsigned char *data;
+        size_t length;
+        while (reader.next(data, length))
+            sink += length;
+    });
+
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0)
+    {
+        output_file file(null_fd);
+        log_options options;
+        options.group_records = 1000;
+        options.sync = false;
+        h.run("log/file/group_1000", (double) (n * record), (double) n, [&]() {
+            log_writer writer(file, options);
+            for (size_t i = 0; i < n; ++i)
+                writer.append(block.data() + i % 1024, record);
+            writer.commit();
+        });
+        close(null_fd);
+    }
+}
+
+void bench_columnar(harness &h)
+{
+    // [{ts, host, value}, ...] as analytics jobs see it
+    const size_t rows = 100000;
+    output_dynamic array;
+    encoder enc(array);
+    enc.write_array(rows);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        char host[16];
+        const int size = snprintf(host, sizeof(host), "host-%d", (int) (i % 64));
+        enc.write_map(3);
+        enc.write_string("ts", 2);
+        enc.write_int((unsigned long long) (1700000000000ULL + i));
+        enc.write_string("host", 4);
+        enc.write_string(host, (unsigned int) size);
+        enc.write_string("value", 5);
+        enc.write_double(i * 0.25);
+    }
+
+    h.run("columnar/read", array.size(), (double) rows, [&]() {
+        columnar_table table;
+        columnar_reader reader;
+        reader.read(array.data(), array.size(), table);
+        sink += table.rows();
+    });
+    h.run("columnar/run_null_listener", array.size(), (double) rows, [&]() {
+        input in(array.data(), array.size());
+        null_listener listener;
+        decoder dec(in, listener);
+        dec.run();
+    });
+
+    columnar_table table;
+    columnar_reader reader;
+    reader.read(array.data(), array.size(), table);
+    const column &value = *table.find("value");
+    h.run("columnar/sum_float64", 8.0 * rows, (double) rows, [&]() {
+        double sum = 0;
+        for (double v : value.doubles)
+            sum += v;
+        sink += (uint64_t) sum;
+    });
+
+    output_dynamic columns(array.size());
+    h.run("columnar/write_columns", array.size(), (double) rows, [&]() {
+        columns.clear();
+        encoder out(columns);
+        write_columns(out, table);
+        sink += columns.size();
+    });
+}
+
+void bench_aggregate(harness &h)
+{
+    const size_t n = 1 << 20;
+    std::vector<double> values(n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = i * 0.25 - 1000;
+
+    output_dynamic doubles(n * 9 + 16);
+    encoder enc(doubles);
+    enc.write_array(n);
+    for (double v : values)
+        enc.write_double(v);
+
+    // small ints, int16, float32 and float64 heads interleaved
+    output_dynamic mixed(n * 9 + 16);
+    encoder mixed_enc(mixed);
+    mixed_enc.write_array(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        switch (i % 4)
+        {
+            case 0: mixed_enc.write_int((int) (i % 20)); break;
+            case 1: mixed_enc.write_int(-(int) (i % 30000)); break;
+            case 2: mixed_enc.write_float((float) values[i]); break;
+            default: mixed_enc.write_double(values[i]); break;
+        }
+    }
+
+    // RFC 8746 float64 little endian typed array
+    std::vector<unsigned char> typed = {0xd8, 86, 0x5a, 0, 0, 0, 0};
+    store_be32(typed.data() + 3, (uint32_t) (n * 8));
+    typed.resize(typed.size() + n * 8);
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t bits;
+        memcpy(&bits, &values[i], 8);
+        for (int k = 0; k < 8; ++k)
+            typed[7 + i * 8 + k] = (unsigned char) (bits >> (8 * k));
+    }
+
+    h.run("aggregate/float64_array", doubles.size(), (double) n, [&]() {
+        sink += (uint64_t) aggregate_array(doubles.data(), doubles.size()).sum;
+    });
+    h.run("aggregate/read_double_loop", doubles.size(), (double) n, [&]() {
+        input in(doubles.data(), doubles.size());
+        decoder dec(in);
+        const size_t size = dec.read_array();
+        double sum = 0;
+        for (size_t i = 0; i < size; ++i)
+            sum += dec.read_double();
+        sink += (uint64_t) sum;
+    });
+    h.run("aggregate/mixed_array", mixed.size(), (double) n, [&]() {
+        sink += (uint64_t) aggregate_array(mixed.data(), mixed.size()).sum;
+    });
+    h.run("aggregate/typed_float64le", typed.size(), (double) n, [&]() {
+        sink += (uint64_t) aggregate_array(typed.data(), typed.size()).sum;
+    });
+}
+
+std::vector<unsigned> thread_counts()
+{
+    std::vector<unsigned> counts;
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned t = 1; t < hardware; t *= 2)
+        counts.push_back(t);
+    counts.push_back(hardware);
+    return counts;
+}
+
+void bench_parallel(harness &h, const std::vector<corpus> &corpora)
+{
+    const corpus &records = corpora[1];
+
+    for (unsigned threads : thread_counts())
+    {
+        const std::string suffix = "/threads=" + std::to_string(threads);
+        if (not h.selected("parallel/sequence_reader" + suffix) and not h.selected("parallel/sharded_array/maps" + suffix)
+            and not h.selected("parallel/sharded_array/doubles" + suffix))
+            continue;
+
+        thread_pool pool(threads);
+
+        h.run("parallel/sequence_reader" + suffix, (double) records.data.size(), (double) records.records, [&]() {
+            sequence_reader reader(records.data.data(), records.data.size(), pool);
+            std::vector<null_listener> counters(threads);
+            std::vector<listener *> listeners;
+            for (null_listener &l : counters)
+                listeners.push_back(&l);
+            reader.run(listeners);
+            for (null_listener &l : counters)
+                sink += l.events;
+        });
+
+        sharded_array array(threads);
+        output_dynamic out(1 << 20);
+        const size_t maps = 50000;
+        auto encode_maps = [&]() {
+            array.clear();
+            pool.run(threads, [&](unsigned worker, size_t task) {
+                encoder &enc = array.shard((unsigned) task);
+                const size_t first = maps * task / threads, last = maps * (task + 1) / threads;
+                for (size_t i = first; i < last; ++i)
+                {
+                    enc.write_map(3);
+                    enc.write_string("id");
+                    enc.write_int((unsigned long long) i);
+                    enc.write_string("name");
+                    enc.write_string("sensor", 6);
+                    enc.write_string("value");
+                    enc.write_double(i * 0.25);
+                }
+                array.add_items((unsigned) task, last - first);
+            });
+            out.clear();
+            array.copy_to(out);
+            sink += out.size();
+        };
+        encode_maps();
+        h.run("parallel/sharded_array/maps" + suffix, (double) out.size(), (double) maps, encode_maps);
+
+        const size_t doubles = 1000000;
+        h.run("parallel/sharded_array/doubles" + suffix, 9.0 * doubles, (double) doubles, [&]() {
+            array.clear();
+            pool.run(threads, [&](unsigned worker, size_t task) {
+                encoder &enc = array.shard((unsigned) task);
+                const size_t first = doubles * task / threads, last = doubles * (task + 1) / threads;
+                for (size_t i = first; i < last; ++i)
+                    enc.write_double(i * 0.5);
+                array.add_items((unsigned) task, last - first);
+            });
+            sink += array.encoded_size();
+        });
+    }
+}
+
+void print_stats()
+{
+    static const char *const names[8] = {"uint", "nint", "bytes", "text", "array", "map", "tag", "simple"};
+
+    const stats_snapshot stats = get_stats();
+    printf("\n%-8s %16s %16s %16s %16s\n", "major", "decoded", "decoded bytes", "encoded", "encoded bytes");
+    for (int i = 0; i < 8; ++i)
+    {
+        printf("%-8s %16llu %16llu %16llu %16llu\n", names[i],
+               (unsigned long long) stats.decoded_items[i], (unsigned long long) stats.decoded_bytes[i],
+               (unsigned long long) stats.encoded_items[i], (unsigned long long) stats.encoded_bytes[i]);
+    }
+    printf("max depth %llu, %llu allocations of %llu bytes\n",
+           (unsigned long long) stats.max_depth, (unsigned long long) stats.allocations,
+           (unsigned long long) stats.allocated_bytes);
+
+    const latency_snapshot &latency = stats.decode_latency;
+    printf("run() latency over %llu calls: mean %.0f ns, p50 %llu, p99 %llu, p99.9 %llu, max %llu ns\n",
+           (unsigned long long) latency.count(), latency.mean(),
+           (unsigned long long) latency.percentile(0.5), (unsigned long long) latency.percentile(0.99),
+           (unsigned long long) latency.percentile(0.999), (unsigned long long) latency.max());
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: cbor-bench [--filter text] [--samples n] [--min-time ms] [--json file] [--list] [--counters]\n");
+    exit(2);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    options opts;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--list")
+            opts.list = true;
+        else if (arg == "--counters")
+            opts.counters = true;
+        else if (i + 1 >= argc)
+            usage();
+        else if (arg == "--filter")
+            opts.filter = argv[++i];
+        else if (arg == "--samples")
+            opts.samples = std::max(1, atoi(argv[++i]));
+        else if (arg == "--min-time")
+            opts.min_time = std::max(1, atoi(argv[++i])) / 1000.0;
+        else if (arg == "--json")
+            opts.json = argv[++i];
+        else
+            usage();
+    }
+
+    harness h(opts);
+
+    bench_encoder(h);
+    bench_decoder(h);
+    bench_outputs(h);
+    bench_text(h);
+    bench_log(h);
+    bench_columnar(h);
+    bench_aggregate(h);
+
+    const std::vector<corpus> corpora = make_corpora();
+    bench_corpora(h, corpora);
+    bench_parallel(h, corpora);
+
+    h.write_json();
+    if (stats_enabled() and not opts.list)
+        print_stats();
+    return 0;
+}
@@ -13,5 +13,8 @@ public:
 
 std::string hexlify(const uint8_t* data, int length);
 
+/// writes 2 * length lower case hex digits to out
+void hexlify(const uint8_t* data, size_t length, char* out);
+
 
 }
\ No newline at end of file
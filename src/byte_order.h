@@ -0,0 +1,119 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#if __cplusplus > 202002L && defined(__has_include)
+#if __has_include(<bit>)
+#include <bit>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+/*
+ * Unaligned big-endian loads and stores. memcpy compiles to a single
+ * (unaligned) load or store and the swap to a single bswap/rev instruction.
+ */
+
+namespace cbor {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    inline uint16_t to_big_endian(uint16_t v) { return v; }
+    inline uint32_t to_big_endian(uint32_t v) { return v; }
+    inline uint64_t to_big_endian(uint64_t v) { return v; }
+#elif defined(__cpp_lib_byteswap)
+    inline uint16_t to_big_endian(uint16_t v) { return std::byteswap(v); }
+    inline uint32_t to_big_endian(uint32_t v) { return std::byteswap(v); }
+    inline uint64_t to_big_endian(uint64_t v) { return std::byteswap(v); }
+#elif defined(__GNUC__) || defined(__clang__)
+    inline uint16_t to_big_endian(uint16_t v) { return __builtin_bswap16(v); }
+    inline uint32_t to_big_endian(uint32_t v) { return __builtin_bswap32(v); }
+    inline uint64_t to_big_endian(uint64_t v) { return __builtin_bswap64(v); }
+#elif defined(_MSC_VER)
+    inline uint16_t to_big_endian(uint16_t v) { return _byteswap_ushort(v); }
+    inline uint32_t to_big_endian(uint32_t v) { return _byteswap_ulong(v); }
+    inline uint64_t to_big_endian(uint64_t v) { return _byteswap_uint64(v); }
+#else
+    inline uint16_t to_big_endian(uint16_t v) { return (uint16_t) ((v >> 8) | (v << 8)); }
+    inline uint32_t to_big_endian(uint32_t v)
+    {
+        return ((v & 0xff000000u) >> 24) | ((v & 0x00ff0000u) >> 8) |
+               ((v & 0x0000ff00u) << 8) | ((v & 0x000000ffu) << 24);
+    }
+    inline uint64_t to_big_endian(uint64_t v)
+    {
+        return ((uint64_t) to_big_endian((uint32_t) v) << 32) | to_big_endian((uint32_t) (v >> 32));
+    }
+#endif
+
+    inline uint16_t load_be16(const unsigned char *p)
+    {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return to_big_endian(v);
+    }
+
+    inline uint32_t load_be32(const unsigned char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return to_big_endian(v);
+    }
+
+    inline uint64_t load_be64(const unsigned char *p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return to_big_endian(v);
+    }
+
+    /// little-endian loads, for formats such as RFC 8746 typed arrays; folded into one load on little-endian hosts
+    inline uint16_t load_le16(const unsigned char *p)
+    {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    inline uint32_t load_le32(const unsigned char *p)
+    {
+        return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    inline uint64_t load_le64(const unsigned char *p)
+    {
+        return (uint64_t) load_le32(p) | ((uint64_t) load_le32(p + 4) << 32);
+    }
+
+    inline void store_be16(unsigned char *p, uint16_t v)
+    {
+        v = to_big_endian(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+    inline void store_be32(unsigned char *p, uint32_t v)
+    {
+        v = to_big_endian(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+    inline void store_be64(unsigned char *p, uint64_t v)
+    {
+        v = to_big_endian(v);
+        memcpy(p, &v, sizeof(v));
+    }
+}
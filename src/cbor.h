@@ -15,11 +15,36 @@
 	   limitations under the License.
 */
 
+#include "error.h"
+#include "memory_resource.h"
+#include "byte_order.h"
 #include "input.h"
 #include "encoder.h"
 #include "decoder.h"
 #include "listener.h"
 #include "output_static.h"
 #include "output_dynamic.h"
+#include "output_file.h"
 #include "listener_debug.h"
+#include "map_index.h"
+#include "projection.h"
+#include "sequence_reader.h"
+#include "array_reader.h"
+#include "sharded_array.h"
+#include "mapped_file.h"
+#include "utf8.h"
+#include "batch_decoder.h"
+#include "key_table.h"
+#include "tags.h"
+#include "dtoa.h"
+#include "listener_text.h"
+#include "listener_json.h"
+#include "json_reader.h"
+#include "listener_diag.h"
+#include "stats.h"
+#include "crc32c.h"
+#include "record_log.h"
+#include "indexed_file.h"
+#include "columnar.h"
+#include "aggregate.h"
 
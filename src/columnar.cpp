@@ -0,0 +1,597 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "columnar.h"
+#include "byte_order.h"
+#include "cursor.h"
+#include "decoder.h"
+#include "input.h"
+#include "map_index.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace cbor {
+
+const uint32_t column::null_code;
+
+const char *to_string(column_type type)
+{
+    switch (type)
+    {
+        case column_type::int64:
+            return "int64";
+        case column_type::float64:
+            return "float64";
+        case column_type::string:
+            return "string";
+    }
+    return "unknown";
+}
+
+column::column(const std::string &name, column_type type, memory_resource *resource)
+        : name(name), type(type), inferred(false), ints(resource), doubles(resource), codes(resource),
+          dictionary(resource), nulls(resource), null_count(0), slots(resource)
+{
+}
+
+size_t column::size() const
+{
+    switch (type)
+    {
+        case column_type::int64:
+            return ints.size();
+        case column_type::float64:
+            return doubles.size();
+        case column_type::string:
+            return codes.size();
+    }
+    return 0;
+}
+
+columnar_table::columnar_table(memory_resource *resource)
+        : _resource(resource), _rows(0)
+{
+}
+
+column &columnar_table::add(const std::string &name, column_type type)
+{
+    _columns.emplace_back(name, type, _resource);
+    column &added = _columns.back();
+    for (size_t row = 0; row < _rows; ++row)
+        added.nulls.push_back(1);
+    added.null_count = _rows;
+    switch (type)
+    {
+        case column_type::int64:
+            added.ints.resize(_rows, 0);
+            break;
+        case column_type::float64:
+            added.doubles.resize(_rows, NAN);
+            break;
+        case column_type::string:
+            added.codes.resize(_rows, column::null_code);
+            break;
+    }
+    return added;
+}
+
+const column *columnar_table::find(const std::string &name) const
+{
+    for (const column &c : _columns)
+    {
+        if (c.name == name)
+            return &c;
+    }
+    return nullptr;
+}
+
+void columnar_table::clear()
+{
+    _columns.clear();
+    _rows = 0;
+}
+
+static void push_null(column &c)
+{
+    if (c.nulls.empty())
+        c.nulls.assign(c.size(), 0);
+    c.nulls.push_back(1);
+    c.null_count++;
+
+    switch (c.type)
+    {
+        case column_type::int64:
+            c.ints.push_back(0);
+            break;
+        case column_type::float64:
+            c.doubles.push_back(NAN);
+            break;
+        case column_type::string:
+            c.codes.push_back(column::null_code);
+            break;
+    }
+}
+
+static void push_valid(column &c)
+{
+    if (not c.nulls.empty())
+        c.nulls.push_back(0);
+}
+
+/// what a row changes besides appending its values, so that a failed row can be undone
+struct row_changes
+{
+    size_t columns;                                         //< before the row, the others it inferred
+    std::vector<size_t> interned;                           //< columns with a new dictionary entry
+    std::vector<std::pair<size_t, column_type>> retyped;    //< columns and their type before
+
+    void clear(size_t column_count)
+    {
+        columns = column_count;
+        interned.clear();
+        retyped.clear();
+    }
+};
+
+/// all rows null, of another type
+static void reset_nulls(column &c, column_type type)
+{
+    const size_t rows = c.size();
+    c.ints.clear();
+    c.doubles.clear();
+    c.codes.clear();
+    c.type = type;
+    c.nulls.clear();
+    c.null_count = 0;
+    for (size_t row = 0; row < rows; ++row)
+        push_null(c);
+}
+
+/// widens an inferred int64 column to float64, or retypes one holding only nulls
+static bool retype(column &c, size_t index, column_type type, row_changes &changes)
+{
+    if (not c.inferred)
+        return false;
+
+    if (c.type == column_type::int64 and type == column_type::float64)
+    {
+        // the integers stay until the row is complete, see commit_row()
+        c.doubles.reserve(c.ints.capacity());
+        for (size_t row = 0; row < c.ints.size(); ++row)
+            c.doubles.push_back(c.is_null(row) ? NAN : (double) c.ints[row]);
+        changes.retyped.emplace_back(index, c.type);
+        c.type = type;
+        return true;
+    }
+
+    if (c.null_count != c.size())
+        return false;
+
+    changes.retyped.emplace_back(index, c.type);
+    reset_nulls(c, type);
+    return true;
+}
+
+/// like map_index, the high bits of the hash pick the slot
+static size_t slot_of(uint32_t hash, size_t slots)
+{
+    return (size_t) (((uint64_t) hash * slots) >> 32);
+}
+
+static void rehash(column &c, size_t slots)
+{
+    c.slots.assign(slots, 0);
+    for (uint32_t code = 0; code < c.dictionary.size(); ++code)
+    {
+        const pmr_string &text = c.dictionary[code];
+        size_t slot = slot_of(map_index::hash((const unsigned char *) text.data(), text.size()), slots);
+        while (c.slots[slot] != 0)
+        {
+            if (++slot == slots)
+                slot = 0;
+        }
+        c.slots[slot] = code + 1;
+    }
+}
+
+/// code of a string in the column's dictionary, added if new
+static uint32_t intern(column &c, const char *data, size_t size)
+{
+    // at most half full
+    if (c.slots.size() < 2 * (c.dictionary.size() + 1))
+        rehash(c, c.slots.empty() ? 16 : c.slots.size() * 2);
+
+    size_t slot = slot_of(map_index::hash((const unsigned char *) data, size), c.slots.size());
+    while (c.slots[slot] != 0)
+    {
+        const uint32_t code = c.slots[slot] - 1;
+        const pmr_string &text = c.dictionary[code];
+        if (text.size() == size and memcmp(text.data(), data, size) == 0)
+            return code;
+        if (++slot == c.slots.size())
+            slot = 0;
+    }
+
+    const uint32_t code = (uint32_t) c.dictionary.size();
+    c.dictionary.push_back(pmr_string(data, size, c.dictionary.get_allocator().resource()));
+    c.slots[slot] = code + 1;
+    return code;
+}
+
+static void reserve(column &c, size_t rows)
+{
+    switch (c.type)
+    {
+        case column_type::int64:
+            c.ints.reserve(rows);
+            break;
+        case column_type::float64:
+            c.doubles.reserve(rows);
+            break;
+        case column_type::string:
+            c.codes.reserve(rows);
+            break;
+    }
+}
+
+/// drops the values of an incomplete row
+static void truncate(column &c, size_t rows)
+{
+    for (size_t row = rows; row < c.nulls.size(); ++row)
+        c.null_count -= c.nulls[row];
+    if (c.nulls.size() > rows)
+        c.nulls.resize(rows);
+    if (c.ints.size() > rows)
+        c.ints.resize(rows);
+    if (c.doubles.size() > rows)
+        c.doubles.resize(rows);
+    if (c.codes.size() > rows)
+        c.codes.resize(rows);
+}
+
+/// frees what a complete row no longer needs to be undone
+static void commit_row(std::vector<column> &columns, const row_changes &changes)
+{
+    for (const auto &retyped : changes.retyped)
+    {
+        column &c = columns[retyped.first];
+        if (retyped.second == column_type::int64 and c.type == column_type::float64)
+        {
+            c.ints.clear();
+            c.ints.shrink_to_fit();
+        }
+    }
+}
+
+/// puts the columns back as they were before a failed row
+static void undo_row(std::vector<column> &columns, size_t rows, const row_changes &changes)
+{
+    for (column &c : columns)
+        truncate(c, rows);
+
+    // one value per column and row, so at most one new entry each
+    for (size_t index : changes.interned)
+    {
+        column &c = columns[index];
+        c.dictionary.pop_back();
+        rehash(c, c.slots.size());
+    }
+    for (const auto &retyped : changes.retyped)
+    {
+        column &c = columns[retyped.first];
+        if (retyped.second == column_type::int64 and c.type == column_type::float64)
+        {
+            c.doubles.clear();
+            c.type = column_type::int64;
+        } else
+        {
+            reset_nulls(c, retyped.second);
+        }
+    }
+    columns.erase(columns.begin() + changes.columns, columns.end());
+}
+
+static error_code skip_item(cursor &in)
+{
+    input rest(in.p, (size_t) (in.end - in.p));
+    decoder dec(rest);
+    const error_code error = dec.try_skip();
+    if (error == error_code::ok)
+        in.p += dec.offset();
+    return error;
+}
+
+static error_code read_value(cursor &in, column &c, size_t index, row_changes &changes)
+{
+    const unsigned char *start = in.p;
+    unsigned major, info;
+    uint64_t argument;
+    error_code error = read_definite_head(in, major, info, argument);
+    if (error != error_code::ok)
+        return error;
+
+    switch (major)
+    {
+        case 0:
+        case 1:
+        {
+            if (argument > INT64_MAX)
+                error = error_code::value_too_large;
+            else if (c.type == column_type::string and not retype(c, index, column_type::int64, changes))
+                error = error_code::wrong_type;
+            if (error != error_code::ok)
+                break;
+
+            // a negative integer encodes -1 - argument
+            const int64_t value = major == 0 ? (int64_t) argument : -1 - (int64_t) argument;
+            if (c.type == column_type::int64)
+                c.ints.push_back(value);
+            else
+                c.doubles.push_back((double) value);
+            push_valid(c);
+            return error_code::ok;
+        }
+        case 3:
+        {
+            if (argument > (uint64_t) (in.end - in.p))
+                error = error_code::truncated;
+            else if (c.type != column_type::string and not retype(c, index, column_type::string, changes))
+                error = error_code::wrong_type;
+            if (error != error_code::ok)
+                break;
+
+            const size_t known = c.dictionary.size();
+            c.codes.push_back(intern(c, (const char *) in.p, (size_t) argument));
+            if (c.dictionary.size() != known)
+                changes.interned.push_back(index);
+            in.p += argument;
+            push_valid(c);
+            return error_code::ok;
+        }
+        case 7:
+        {
+            // null and undefined
+            if (info == 22 or info == 23)
+            {
+                push_null(c);
+                return error_code::ok;
+            }
+            if (info < 25 or info > 27)
+                error = error_code::wrong_type;
+            else if (c.type != column_type::float64 and not retype(c, index, column_type::float64, changes))
+                error = error_code::wrong_type;
+            if (error != error_code::ok)
+                break;
+
+            double value;
+            if (info == 25)
+            {
+                value = half_to_double((uint16_t) argument);
+            } else if (info == 26)
+            {
+                const uint32_t bits = (uint32_t) argument;
+                float single;
+                memcpy(&single, &bits, sizeof(single));
+                value = single;
+            } else
+            {
+                memcpy(&value, &argument, sizeof(value));
+            }
+            c.doubles.push_back(value);
+            push_valid(c);
+            return error_code::ok;
+        }
+        default:
+            error = error_code::wrong_type;
+            break;
+    }
+
+    in.p = start;
+    return error;
+}
+
+static result<column_type> infer_type(const cursor &in)
+{
+    if (in.p == in.end)
+        return error_code::truncated;
+
+    switch (*in.p >> 5)
+    {
+        case 0:
+        case 1:
+            return column_type::int64;
+        case 3:
+            return column_type::string;
+        case 7:
+            if ((*in.p & 31) >= 25 and (*in.p & 31) <= 27)
+                return column_type::float64;
+            // a null, settled by the first value
+            return column_type::int64;
+        default:
+            return error_code::wrong_type;
+    }
+}
+
+static bool name_is(const column &c, const unsigned char *name, size_t size)
+{
+    return c.name.size() == size and memcmp(c.name.data(), name, size) == 0;
+}
+
+static error_code read_row(cursor &in, columnar_table &table, std::vector<column> &columns, size_t row, bool infer,
+                           row_changes &changes)
+{
+    unsigned major, info;
+    uint64_t entries;
+    error_code error = read_definite_head(in, major, info, entries);
+    if (error != error_code::ok)
+        return error;
+    if (major != 5)
+        return error_code::wrong_type;
+
+    size_t next = 0;
+    for (uint64_t entry = 0; entry < entries; ++entry)
+    {
+        uint64_t size;
+        error = read_definite_head(in, major, info, size);
+        if (error != error_code::ok)
+            return error;
+        if (major != 3)
+            return error_code::wrong_type;
+        if (size > (uint64_t) (in.end - in.p))
+            return error_code::truncated;
+        const unsigned char *name = in.p;
+        in.p += size;
+
+        // usually the column after the previous one
+        size_t index = next;
+        if (index >= columns.size() or not name_is(columns[index], name, (size_t) size))
+        {
+            index = 0;
+            while (index < columns.size() and not name_is(columns[index], name, (size_t) size))
+                index++;
+        }
+
+        if (index == columns.size() and infer)
+        {
+            auto inferred = infer_type(in);
+            if (not inferred)
+                return inferred.error();
+            table.add(std::string((const char *) name, (size_t) size), inferred.value()).inferred = true;
+        }
+
+        // unknown fields and repeated keys are skipped
+        if (index == columns.size() or columns[index].size() > row)
+            error = skip_item(in);
+        else
+            error = read_value(in, columns[index], index, changes);
+        if (error != error_code::ok)
+            return error;
+        next = index + 1;
+    }
+
+    for (column &c : columns)
+    {
+        if (c.size() == row)
+            push_null(c);
+    }
+    return error_code::ok;
+}
+
+error_code columnar_reader::try_read(const unsigned char *data, size_t size, columnar_table &table)
+{
+    _errorRow = 0;
+    _offset = 0;
+
+    cursor in = {data, data + size};
+    unsigned major, info;
+    uint64_t rows;
+    error_code error = read_definite_head(in, major, info, rows);
+    if (error != error_code::ok)
+        return error;
+    if (major != 4)
+        return error_code::wrong_type;
+
+    // the array header caps the row count, unless it is corrupt
+    const size_t expected = table._rows + (size_t) std::min(rows, (uint64_t) (in.end - in.p));
+    // the first row of a table adds columns for the fields add() did not declare
+    const bool infer = table._rows == 0;
+    row_changes changes;
+    for (uint64_t row = 0; row < rows; ++row)
+    {
+        // before the first row, and after it for the inferred columns
+        if (row <= 1)
+        {
+            for (column &c : table._columns)
+                reserve(c, expected);
+        }
+        changes.clear(table._columns.size());
+        error = read_row(in, table, table._columns, table._rows, infer and row == 0, changes);
+        if (error != error_code::ok)
+        {
+            // rows before stay
+            undo_row(table._columns, table._rows, changes);
+            _errorRow = (size_t) row;
+            return error;
+        }
+        commit_row(table._columns, changes);
+        table._rows++;
+    }
+
+    _offset = (size_t) (in.p - data);
+    return error_code::ok;
+}
+
+void columnar_reader::read(const unsigned char *data, size_t size, columnar_table &table)
+{
+    const error_code error = try_read(data, size, table);
+    if (error != error_code::ok)
+        raise(error, "in row " + std::to_string(_errorRow));
+}
+
+static void write_value(encoder &enc, const column &c, size_t row)
+{
+    if (c.is_null(row))
+    {
+        enc.write_null();
+        return;
+    }
+
+    switch (c.type)
+    {
+        case column_type::int64:
+            enc.write_int((long long) c.ints[row]);
+            break;
+        case column_type::float64:
+            enc.write_double(c.doubles[row]);
+            break;
+        case column_type::string:
+        {
+            const pmr_string &text = c.text(row);
+            enc.write_string(text.data(), (unsigned int) text.size());
+            break;
+        }
+    }
+}
+
+void write_columns(encoder &enc, const columnar_table &table)
+{
+    enc.write_map(table.size());
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        const column &c = table[i];
+        enc.write_string(c.name.data(), (unsigned int) c.name.size());
+        enc.write_array(table.rows());
+        for (size_t row = 0; row < table.rows(); ++row)
+            write_value(enc, c, row);
+    }
+}
+
+void write_rows(encoder &enc, const columnar_table &table)
+{
+    enc.write_array(table.rows());
+    for (size_t row = 0; row < table.rows(); ++row)
+    {
+        enc.write_map(table.size());
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            const column &c = table[i];
+            enc.write_string(c.name.data(), (unsigned int) c.name.size());
+            write_value(enc, c, row);
+        }
+    }
+}
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "encoder.h"
+#include "error.h"
+#include "memory_resource.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    enum class column_type : uint8_t
+    {
+        int64,
+        float64,
+        string
+    };
+
+    const char *to_string(column_type type);
+
+    /**
+     * One field of an array of maps as a contiguous vector. Only the vector
+     * of the column's type is filled. Null values and missing fields are
+     * flagged in nulls and hold 0, NaN or null_code.
+     */
+    struct column
+    {
+        static const uint32_t null_code = UINT32_MAX;
+
+        std::string name;
+        column_type type;
+        bool inferred;                  //< type taken from the data, may still widen
+        pmr_vector<int64_t> ints;
+        pmr_vector<double> doubles;
+        pmr_vector<uint32_t> codes;     //< string columns: index into dictionary
+        pmr_vector<pmr_string> dictionary; //< distinct strings, in order of first appearance
+        pmr_vector<uint8_t> nulls;      //< 1 per null row, empty while there are none
+        size_t null_count;
+        pmr_vector<uint32_t> slots;     //< dictionary hash table, code + 1 per slot
+
+        column(const std::string &name, column_type type, memory_resource *resource);
+
+        size_t size() const;
+
+        bool is_null(size_t row) const { return not nulls.empty() and nulls[row] != 0; }
+
+        const pmr_string &text(size_t row) const { return dictionary[codes[row]]; }
+    };
+
+    /// struct of arrays for an array of same shaped maps
+    class columnar_table {
+    private:
+        memory_resource *_resource;
+        std::vector<column> _columns;
+        size_t _rows;
+
+        friend class columnar_reader;
+
+    public:
+        explicit columnar_table(memory_resource *resource = get_default_resource());
+
+        /// fixes a column and its type, before reading; other fields are inferred
+        column &add(const std::string &name, column_type type);
+
+        size_t rows() const { return _rows; }
+
+        size_t size() const { return _columns.size(); }
+
+        const column &operator[](size_t index) const { return _columns[index]; }
+
+        /// nullptr if there is no such column
+        const column *find(const std::string &name) const;
+
+        /// drops rows and columns
+        void clear();
+    };
+
+    /**
+     * Decodes an array of maps with text keys straight into the columns of
+     * a table, without listener callbacks or per value allocations.
+     *
+     * Columns declared with add() keep their type: integers go into
+     * float64 columns as doubles, anything else of the wrong type fails.
+     * The other fields of the first row of an empty table become columns
+     * too, typed by their values: integers become int64 and widen to
+     * float64 when a float turns up, and a column of nulls takes the type
+     * of its first value. Fields the table has no column for are skipped,
+     * missing ones are null. Keys are expected in the order of the previous
+     * row, other orders cost a search over the column names. A row that
+     * fails is undone whole, with the columns, widenings and dictionary
+     * entries it added, so the table keeps just the rows before it.
+     */
+    class columnar_reader {
+    private:
+        size_t _errorRow;
+        size_t _offset;
+
+    public:
+        columnar_reader() : _errorRow(0), _offset(0) {}
+
+        /// appends the rows of the array at data to table
+        error_code try_read(const unsigned char *data, size_t size, columnar_table &table);
+
+        /// throwing version of try_read()
+        void read(const unsigned char *data, size_t size, columnar_table &table);
+
+        /// row of the last error
+        size_t error_row() const { return _errorRow; }
+
+        /// bytes the last read consumed
+        size_t offset() const { return _offset; }
+    };
+
+    /// a map from column names to arrays of values, nulls included
+    void write_columns(encoder &enc, const columnar_table &table);
+
+    /// the table as an array of maps again, null fields are written as null
+    void write_rows(encoder &enc, const columnar_table &table);
+}
@@ -0,0 +1,154 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "crc32c.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CBOR_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CBOR_CRC32C_ARM
+#endif
+
+namespace cbor {
+
+typedef uint32_t (*crc32c_function)(uint32_t crc, const unsigned char *data, size_t size);
+
+/// reflected Castagnoli polynomial
+static const uint32_t polynomial = 0x82f63b78;
+
+struct crc32c_tables
+{
+    uint32_t table[8][256];
+
+    crc32c_tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            for (int k = 1; k < 8; ++k)
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+        }
+    }
+};
+
+static uint32_t crc32c_software(uint32_t crc, const unsigned char *data, size_t size)
+{
+    static const crc32c_tables tables;
+    const uint32_t (*t)[256] = tables.table;
+
+    // slicing-by-8, little endian word order
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        const uint32_t low = crc ^ ((uint32_t) data[0] | (uint32_t) data[1] << 8 |
+                                    (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+    }
+    while (size-- != 0)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+    return crc;
+}
+
+#ifdef CBOR_CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *data, size_t size)
+{
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t) crc64;
+#endif
+    for (; size >= 4; data += 4, size -= 4)
+    {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    while (size-- != 0)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+static crc32c_function select_crc32c()
+{
+    return __builtin_cpu_supports("sse4.2") ? crc32c_sse42 : crc32c_software;
+}
+
+#elif defined(CBOR_CRC32C_ARM)
+
+static uint32_t crc32c_arm(uint32_t crc, const unsigned char *data, size_t size)
+{
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+    }
+    while (size-- != 0)
+        crc = __crc32cb(crc, *data++);
+    return crc;
+}
+
+static crc32c_function select_crc32c()
+{
+    return crc32c_arm;
+}
+
+#else
+
+static crc32c_function select_crc32c()
+{
+    return crc32c_software;
+}
+
+#endif
+
+static crc32c_function implementation()
+{
+    static const crc32c_function selected = select_crc32c();
+    return selected;
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc)
+{
+    return ~implementation()(~crc, (const unsigned char *) data, size);
+}
+
+bool crc32c_hardware()
+{
+    return implementation() != crc32c_software;
+}
+
+uint32_t crc32c_portable(const void *data, size_t size, uint32_t crc)
+{
+    return ~crc32c_software(~crc, (const unsigned char *) data, size);
+}
+
+}
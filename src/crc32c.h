@@ -0,0 +1,34 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cbor {
+
+    /**
+     * CRC-32C (Castagnoli), as used by iSCSI, ext4 and most storage formats.
+     * Pass the previous result as crc to continue a checksum over several
+     * buffers. Uses the SSE 4.2 or ARMv8 CRC instructions when the CPU has
+     * them, a slicing-by-8 table otherwise.
+     */
+    uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+    /// true if crc32c() runs on CRC instructions
+    bool crc32c_hardware();
+
+    /// crc32c() on the slicing-by-8 table whatever the CPU has, e.g. to check the instructions against
+    uint32_t crc32c_portable(const void *data, size_t size, uint32_t crc = 0);
+}
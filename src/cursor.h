@@ -0,0 +1,84 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "byte_order.h"
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cbor {
+
+    /// position in an encoding whose heads are parsed in place, without a decoder
+    struct cursor
+    {
+        const unsigned char *p;
+        const unsigned char *end;
+    };
+
+    /**
+     * Reads the head at in.p and moves past it. Additional info 31, an
+     * indefinite length or a break, gives argument 0 and is up to the
+     * caller; 28 to 30 are invalid_additional_info. On errors in.p stays.
+     */
+    inline error_code read_head(cursor &in, unsigned &major, unsigned &info, uint64_t &argument)
+    {
+        if (in.p == in.end)
+            return error_code::truncated;
+
+        major = *in.p >> 5;
+        info = *in.p & 31;
+        if (info < 24)
+        {
+            argument = info;
+            in.p++;
+            return error_code::ok;
+        }
+        if (info > 27)
+        {
+            if (info != 31)
+                return error_code::invalid_additional_info;
+            argument = 0;
+            in.p++;
+            return error_code::ok;
+        }
+
+        const size_t length = (size_t) 1 << (info - 24);
+        if ((size_t) (in.end - in.p) < 1 + length)
+            return error_code::truncated;
+        const unsigned char *p = in.p + 1;
+        switch (length)
+        {
+            case 1: argument = *p; break;
+            case 2: argument = load_be16(p); break;
+            case 4: argument = load_be32(p); break;
+            default: argument = load_be64(p); break;
+        }
+        in.p = p + length;
+        return error_code::ok;
+    }
+
+    /// read_head() for layouts without indefinite lengths, where 31 is invalid_additional_info too
+    inline error_code read_definite_head(cursor &in, unsigned &major, unsigned &info, uint64_t &argument)
+    {
+        const error_code error = read_head(in, major, info, argument);
+        if (error == error_code::ok and info == 31)
+        {
+            in.p--;
+            return error_code::invalid_additional_info;
+        }
+        return error;
+    }
+}
@@ -16,10 +16,12 @@
 */
 
 #include "decoder.h"
+#include "byte_order.h"
 #include "log.h"
+#include "stats.h"
+#include "tags.h"
 
 #include <limits.h>
-#include <stdexcept>
 
 
 namespace cbor
@@ -41,20 +43,39 @@ std::string to_string(majorType value)
         case majorType::floatingPoint: return "floatingPoint";
         case majorType::simpleValue: return "simpleValue";
     }
-    throw std::runtime_error("invalid major type");
+    return "invalid major type";
 }
 
-decoder::decoder(input &in)
+decoder::decoder(input &in, memory_resource *resource)
+        : _stack(resource)
 {
     _in = &in;
+    _resource = resource;
+    _listener = nullptr;
     _state = STATE_TYPE;
+    _currentLength = 0;
+    _chunkOffset = 0;
+    _chunkThreshold = 0;
+    _allocated = 0;
+    _validateUtf8 = false;
+    _keys = nullptr;
+    _tags = nullptr;
 }
 
-decoder::decoder(input &in, listener &listener)
+decoder::decoder(input &in, listener &listener, memory_resource *resource)
+        : _stack(resource)
 {
     _in = &in;
+    _resource = resource;
     _listener = &listener;
     _state = STATE_TYPE;
+    _currentLength = 0;
+    _chunkOffset = 0;
+    _chunkThreshold = 0;
+    _allocated = 0;
+    _validateUtf8 = false;
+    _keys = nullptr;
+    _tags = nullptr;
 }
 
 decoder::~decoder()
@@ -67,6 +88,98 @@ void decoder::set_listener(listener & listener_instance)
     _listener = &listener_instance;
 }
 
+void decoder::set_limits(const decoder_limits &limits)
+{
+    _limits = limits;
+    _allocated = 0;
+}
+
+void decoder::fail(const char *error)
+{
+    _state = STATE_ERROR;
+    _listener->on_error(error);
+}
+
+bool decoder::begin_container(uint64_t size, bool map)
+{
+    // the stack keeps twice the map size and a flag bit
+    if (size > _limits.max_container_size or size > (UINT64_MAX >> 2))
+    {
+        fail(map ? "map too large" : "array too large");
+        return false;
+    }
+
+    if (size == 0)
+    {
+        item_done();
+        return true;
+    }
+
+    if (_stack.size() >= _limits.max_depth)
+    {
+        fail("nesting too deep");
+        return false;
+    }
+
+    _stack.push_back(map ? (size * 2) << 1 | 1 : size << 1);
+    CBOR_STATS_DEPTH(_stack.size());
+    return true;
+}
+
+bool decoder::begin_tag()
+{
+    // a tag is a container of one item, so it counts towards max_depth as in skip_item()
+    if (_stack.size() >= _limits.max_depth)
+    {
+        fail("nesting too deep");
+        return false;
+    }
+
+    _stack.push_back(1 << 1);
+    CBOR_STATS_DEPTH(_stack.size());
+    return true;
+}
+
+void decoder::begin_array(uint64_t size)
+{
+    if (not begin_container(size, false))
+        return;
+
+    if (size <= INT_MAX)
+        _listener->on_array((int) size);
+    else
+        _listener->on_extra_array(size);
+}
+
+void decoder::begin_map(uint64_t size)
+{
+    if (not begin_container(size, true))
+        return;
+
+    if (size <= INT_MAX)
+        _listener->on_map((int) size);
+    else
+        _listener->on_extra_map(size);
+}
+
+void decoder::item_done()
+{
+    while (not _stack.empty())
+    {
+        _stack.back() -= 2;
+        if (_stack.back() >> 1 != 0)
+            return;
+        // the finished container is an item of its parent
+        _stack.pop_back();
+    }
+}
+
+bool decoder::at_map_key() const
+{
+    // keys are at an even number of items left
+    return not _stack.empty() and (_stack.back() & 1) != 0 and (_stack.back() & 2) == 0;
+}
+
 inline
 int sizeFromAdditionalInfo(uint8_t in)
 {
@@ -85,23 +198,140 @@ int sizeFromAdditionalInfo(uint8_t in)
         case 27:
             return 8;
     }
-    throw std::runtime_error("invalid additional info: " + to_string(additionalInfo));
+    return -1;
+}
+
+/**
+ * Passes a registered tag and its item to the handler. Returns false if the
+ * tag is not registered, its head is invalid or the item is incomplete; the
+ * input is then left after the head byte, or at start if more input is
+ * needed.
+ */
+bool decoder::run_registered_tag(size_t start, bool &incomplete)
+{
+    incomplete = false;
+
+    // the tag number is read in place, only registered tags get a decoder
+    const unsigned char *head = _in->current() - 1;
+    const int length = sizeFromAdditionalInfo(*head);
+    if (length < 0)
+        return false;
+    if (_in->remaining() < (size_t) length)
+    {
+        incomplete = true;
+        _in->rewind(start);
+        return false;
+    }
+
+    uint64_t tag = 0;
+    switch (length)
+    {
+        case 0: tag = *head & 31; break;
+        case 1: tag = head[1]; break;
+        case 2: tag = load_be16(head + 1); break;
+        case 4: tag = load_be32(head + 1); break;
+        default: tag = load_be64(head + 1); break;
+    }
+
+    tag_handler *handler = _tags->find(tag);
+    if (handler == nullptr)
+        return false;
+
+    // the tag is one level of nesting, the item gets what is left
+    if (_stack.size() >= _limits.max_depth)
+    {
+        fail("nesting too deep");
+        return true;
+    }
+    decoder_limits limits = _limits;
+    limits.max_depth -= _stack.size() + 1;
+    limits.allocation_budget = _limits.allocation_budget - _allocated;
+
+    const size_t item_start = 1 + (size_t) length;
+    input tagged(head + item_start, _in->remaining() - length);
+    decoder scan(tagged);
+    scan.set_limits(limits);
+    error_code error = scan.try_skip();
+    if (error == error_code::truncated)
+    {
+        incomplete = true;
+        _in->rewind(start);
+        return false;
+    }
+
+    if (error == error_code::ok)
+    {
+        input item(head + item_start, scan.offset());
+        decoder item_decoder(item, _resource);
+        item_decoder.set_limits(limits);
+        item_decoder.set_validate_utf8(_validateUtf8);
+        error = handler->on_tagged(tag, item_decoder);
+        // the item shares the budget of the whole input
+        _allocated += item_decoder.allocated();
+    }
+
+    _in->advance(length + scan.offset());
+    if (error != error_code::ok)
+        fail(to_string(error));
+    return true;
+}
+
+void decoder::begin_string(uint64_t length, decoder_state state)
+{
+    if (length > _limits.max_string_length)
+    {
+        fail("string too long");
+        return;
+    }
+    CBOR_STATS_STRING(state == STATE_STRING_DATA ? 3 : 2, length);
+
+    if (_chunkThreshold != 0 and length > _chunkThreshold)
+    {
+        // delivered in place as it arrives, nothing is allocated
+        _currentLength = length;
+        _chunkOffset = 0;
+        _state = state == STATE_STRING_DATA ? STATE_STRING_CHUNKS : STATE_BYTES_CHUNKS;
+        _utf8.reset();
+        return;
+    }
+
+    if (state == STATE_STRING_DATA)
+    {
+        // text is copied into a std::string, byte strings are passed in place
+        if (length > _limits.allocation_budget - _allocated)
+        {
+            fail("allocation budget exceeded");
+            return;
+        }
+        _allocated += length;
+        CBOR_STATS_ALLOCATION(length);
+    }
+
+    _currentLength = length;
+    _state = state;
 }
 
 void decoder::run()
 {
+    CBOR_STATS_DECODE_TIMER();
     unsigned int temp;
-    while (1)
+    while (_state != STATE_ERROR)
     {
-        const auto expected_len = _state == STATE_TYPE ? 1 : _currentLength;
+        const auto expected_len = _state == STATE_TYPE or _state == STATE_BYTES_CHUNKS or _state == STATE_STRING_CHUNKS ? 1 : _currentLength;
         if (!_in->has_bytes(expected_len))
             break;
 
+        // container headers and tags do not complete an item of their parent
+        bool header = false;
+
         switch (_state) {
             case STATE_TYPE: {
                 unsigned char type = _in->get_byte();
                 unsigned char majorType = type >> 5;
                 auto minorType = (unsigned char) (type & 31);
+                // a registered tag may need more input first, it is counted below once
+                if (majorType != 6)
+                    CBOR_STATS_DECODED(majorType, 1 + sizeFromAdditionalInfo(minorType));
 
                 switch (majorType) {
                     case 0: // positive integer
@@ -142,8 +372,7 @@ void decoder::run()
                     case 2: // bytes
                         if (minorType < 24)
                         {
-                            _state = STATE_BYTES_DATA;
-                            _currentLength = minorType;
+                            begin_string(minorType, STATE_BYTES_DATA);
                         } else if (minorType >= 24 and minorType <= 27)
                         {
                             _currentLength = sizeFromAdditionalInfo(minorType);
@@ -157,8 +386,7 @@ void decoder::run()
                     case 3: // string
                         if (minorType < 24)
                         {
-                            _state = STATE_STRING_DATA;
-                            _currentLength = minorType;
+                            begin_string(minorType, STATE_STRING_DATA);
                         } else if (minorType >= 24 and minorType <= 27)
                         {
                             _state = STATE_STRING_SIZE;
@@ -172,7 +400,8 @@ void decoder::run()
                     case 4: // array
                         if (minorType < 24)
                         {
-                            _listener->on_array(minorType);
+                            header = true;
+                            begin_array(minorType);
                         } else if (minorType >= 24 and minorType <= 27)
                         {
                             _state = STATE_ARRAY;
@@ -186,7 +415,8 @@ void decoder::run()
                     case 5: // map
                         if (minorType < 24)
                         {
-                            _listener->on_map(minorType);
+                            header = true;
+                            begin_map(minorType);
                         } else if (minorType >= 24 and minorType <= 27)
                         {
                             _state = STATE_MAP;
@@ -198,9 +428,25 @@ void decoder::run()
                         }
                         break;
                     case 6: // tag
+                        if (_tags != nullptr)
+                        {
+                            bool incomplete;
+                            const bool handled = run_registered_tag(_in->offset() - 1, incomplete);
+                            if (incomplete)
+                                return;
+                            if (handled)
+                            {
+                                CBOR_STATS_DECODED(6, 1 + sizeFromAdditionalInfo(minorType));
+                                break;
+                            }
+                        }
+                        CBOR_STATS_DECODED(6, 1 + sizeFromAdditionalInfo(minorType));
+
                         if (minorType < 24)
                         {
-                            _listener->on_tag(minorType);
+                            header = true;
+                            if (begin_tag())
+                                _listener->on_tag(minorType);
                         } else if (minorType >= 24 and minorType <= 27)
                         {
                             _state = STATE_TAG;
@@ -274,22 +520,20 @@ void decoder::run()
             {
                 switch (_currentLength)
                 {
+                    // a negative integer encodes -1 - argument
                     case 1:
-                        _listener->on_integer(-(int) _in->get_byte());
+                        _listener->on_integer(-1 - (int) _in->get_byte());
                         _state = STATE_TYPE;
                         break;
                     case 2:
-                        _listener->on_integer(-(int) _in->get_short());
+                        _listener->on_integer(-1 - (int) _in->get_short());
                         _state = STATE_TYPE;
                         break;
                     case 4:
                         temp = _in->get_int();
                         if (temp <= INT_MAX)
                         {
-                            _listener->on_integer(-(int) temp);
-                        } else if (temp == 2147483648u)
-                        {
-                            _listener->on_integer(INT_MIN);
+                            _listener->on_integer(-1 - (int) temp);
                         } else
                         {
                             _listener->on_extra_integer(temp, -1);
@@ -298,6 +542,7 @@ void decoder::run()
                         break;
                     case 8:
                         _listener->on_extra_integer(_in->get_long(), -1);
+                        _state = STATE_TYPE;
                         break;
                     default:
                         logger("unknown minor state in STATE_NINT");
@@ -308,20 +553,16 @@ void decoder::run()
                 switch (_currentLength)
                 {
                     case 1:
-                        _currentLength = _in->get_byte();
-                        _state = STATE_BYTES_DATA;
+                        begin_string(_in->get_byte(), STATE_BYTES_DATA);
                         break;
                     case 2:
-                        _currentLength = _in->get_short();
-                        _state = STATE_BYTES_DATA;
+                        begin_string(_in->get_short(), STATE_BYTES_DATA);
                         break;
                     case 4:
-                        _currentLength = _in->get_int();
-                        _state = STATE_BYTES_DATA;
+                        begin_string(_in->get_int(), STATE_BYTES_DATA);
                         break;
                     case 8:
-                        _state = STATE_ERROR;
-                        _listener->on_error("extra long bytes");
+                        begin_string(_in->get_long(), STATE_BYTES_DATA);
                         break;
                     default:
                         logger("unknown minor state in STATE_BYTES_SIZE");
@@ -329,30 +570,30 @@ void decoder::run()
                 break;
             };
             case STATE_BYTES_DATA: {
-                auto *data = new unsigned char[_currentLength];
-                _in->get_bytes(data, _currentLength);
+                // passed in place, valid for the duration of the call
+                auto *data = (unsigned char *) _in->current();
+                _in->advance(_currentLength);
                 _state = STATE_TYPE;
-                _listener->on_bytes(data, _currentLength);
+                if (_currentLength <= INT_MAX)
+                    _listener->on_bytes(data, (int) _currentLength);
+                else
+                    _listener->on_extra_bytes(data, _currentLength);
                 break;
             }
             case STATE_STRING_SIZE: {
                 switch (_currentLength)
                 {
                     case 1:
-                        _currentLength = _in->get_byte();
-                        _state = STATE_STRING_DATA;
+                        begin_string(_in->get_byte(), STATE_STRING_DATA);
                         break;
                     case 2:
-                        _currentLength = _in->get_short();
-                        _state = STATE_STRING_DATA;
+                        begin_string(_in->get_short(), STATE_STRING_DATA);
                         break;
                     case 4:
-                        _currentLength = _in->get_int();
-                        _state = STATE_STRING_DATA;
+                        begin_string(_in->get_int(), STATE_STRING_DATA);
                         break;
                     case 8:
-                        _state = STATE_ERROR;
-                        _listener->on_error("extra long array");
+                        begin_string(_in->get_long(), STATE_STRING_DATA);
                         break;
                     default:
                         logger("unknown minor state in STATE_STRING_SIZE");
@@ -360,31 +601,78 @@ void decoder::run()
                 break;
             }
             case STATE_STRING_DATA: {
-                auto *data = new unsigned char[_currentLength];
-                _in->get_bytes(data, _currentLength);
+                if (_validateUtf8 and not is_valid_utf8((const char *) _in->current(), (size_t) _currentLength))
+                {
+                    fail("invalid utf-8 string");
+                    break;
+                }
+                if (_keys != nullptr and at_map_key())
+                {
+                    const int symbol = _keys->find((const char *) _in->current(), (size_t) _currentLength);
+                    if (symbol != key_table::npos)
+                    {
+                        _in->advance(_currentLength);
+                        _state = STATE_TYPE;
+                        _listener->on_key(symbol);
+                        break;
+                    }
+                }
+
+                _text.assign((const char *) _in->current(), (size_t) _currentLength);
+                _in->advance(_currentLength);
                 _state = STATE_TYPE;
-                std::string str((const char *) data, (size_t) _currentLength);
-                _listener->on_string(str);
+                _listener->on_string(_text);
+                break;
+            }
+            case STATE_BYTES_CHUNKS:
+            case STATE_STRING_CHUNKS: {
+                uint64_t size = _currentLength - _chunkOffset;
+                if (size > _in->remaining())
+                    size = _in->remaining();
+
+                const unsigned char *data = _in->current();
+                _in->advance(size);
+
+                const uint64_t offset = _chunkOffset;
+                _chunkOffset += size;
+                const bool last = _chunkOffset == _currentLength;
+
+                if (_state == STATE_STRING_CHUNKS and _validateUtf8)
+                {
+                    // checked as it arrives, a code point split between
+                    // chunks is completed by the next one
+                    if (not _utf8.update((const char *) data, size) or (last and not _utf8.finish()))
+                    {
+                        fail("invalid utf-8 string");
+                        break;
+                    }
+                }
+
+                if (_state == STATE_BYTES_CHUNKS)
+                    _listener->on_bytes_chunk(data, size, offset, _currentLength);
+                else
+                    _listener->on_string_chunk((const char *) data, size, offset, _currentLength);
+
+                if (last)
+                    _state = STATE_TYPE;
                 break;
             }
             case STATE_ARRAY: {
+                header = true;
+                _state = STATE_TYPE;
                 switch (_currentLength)
                 {
                     case 1:
-                        _listener->on_array(_in->get_byte());
-                        _state = STATE_TYPE;
+                        begin_array(_in->get_byte());
                         break;
                     case 2:
-                        _listener->on_array(_currentLength = _in->get_short());
-                        _state = STATE_TYPE;
+                        begin_array(_in->get_short());
                         break;
                     case 4:
-                        _listener->on_array(_in->get_int());
-                        _state = STATE_TYPE;
+                        begin_array(_in->get_int());
                         break;
                     case 8:
-                        _state = STATE_ERROR;
-                        _listener->on_error("extra long array");
+                        begin_array(_in->get_long());
                         break;
                     default:
                         logger("unknown minor state in STATE_ARRAY");
@@ -392,23 +680,21 @@ void decoder::run()
                 break;
             }
             case STATE_MAP: {
+                header = true;
+                _state = STATE_TYPE;
                 switch (_currentLength)
                 {
                     case 1:
-                        _listener->on_map(_in->get_byte());
-                        _state = STATE_TYPE;
+                        begin_map(_in->get_byte());
                         break;
                     case 2:
-                        _listener->on_map(_currentLength = _in->get_short());
-                        _state = STATE_TYPE;
+                        begin_map(_in->get_short());
                         break;
                     case 4:
-                        _listener->on_map(_in->get_int());
-                        _state = STATE_TYPE;
+                        begin_map(_in->get_int());
                         break;
                     case 8:
-                        _state = STATE_ERROR;
-                        _listener->on_error("extra long map");
+                        begin_map(_in->get_long());
                         break;
                     default:
                         logger("unknown minor state in STATE_MAP");
@@ -416,27 +702,32 @@ void decoder::run()
                 break;
             }
             case STATE_TAG: {
+                header = true;
+                _state = STATE_TYPE;
+                uint64_t tag = 0;
                 switch (_currentLength)
                 {
                     case 1:
-                        _listener->on_tag(_in->get_byte());
-                        _state = STATE_TYPE;
+                        tag = _in->get_byte();
                         break;
                     case 2:
-                        _listener->on_tag(_in->get_short());
-                        _state = STATE_TYPE;
+                        tag = _in->get_short();
                         break;
                     case 4:
-                        _listener->on_tag(_in->get_int());
-                        _state = STATE_TYPE;
+                        tag = _in->get_int();
                         break;
                     case 8:
-                        _listener->on_extra_tag(_in->get_long());
-                        _state = STATE_TYPE;
+                        tag = _in->get_long();
                         break;
                     default:
                         logger("unknown minor state in STATE_TAG");
                 }
+                if (not begin_tag())
+                    break;
+                if (_currentLength == 8)
+                    _listener->on_extra_tag(tag);
+                else
+                    _listener->on_tag((unsigned int) tag);
                 break;
             }
             case STATE_SPECIAL: {
@@ -447,7 +738,7 @@ void decoder::run()
                         _state = STATE_TYPE;
                         break;
                     case 2:
-                        _listener->on_special(_in->get_short());
+                        _listener->on_half(_in->get_half());
                         _state = STATE_TYPE;
                         break;
                     case 4:
@@ -465,23 +756,39 @@ void decoder::run()
                 break;
             }
             case STATE_ERROR: {
-                break;
+                return;
             }
             default:
                 logger("UNKNOWN STATE");
         }
+
+        if (_state == STATE_TYPE and not header)
+            item_done();
     }
 }
 
 //* \brief returns next type without consuming it
 type decoder::peekType() const
 {
+    auto type = try_peek_type();
+    if (not type)
+        raise(type.error());
+    return type.value();
+}
+
+result<type> decoder::try_peek_type() const
+{
+    if (_in->remaining() < 1)
+        return error_code::truncated;
+
     uint8_t typeByte = _in->peek_byte();
     uint8_t majorTypeValue = typeByte >> 5;
     uint8_t minorType = typeByte & 0x1f;
 
-    majorType typeEnum;
-    size_t typeSize = sizeFromAdditionalInfo(minorType);
+    majorType typeEnum = majorType::simpleValue;
+    int typeSize = sizeFromAdditionalInfo(minorType);
+    if (typeSize < 0)
+        return error_code::invalid_additional_info;
 
     switch (majorTypeValue)
     {
@@ -511,172 +818,471 @@ type decoder::peekType() const
             typeEnum = majorType::tag;
             break;
         case 7: // special
-            if (minorType > 19 and minorType < 24) typeEnum = majorType::simpleValue;
             if (minorType > 24 and minorType < 28) typeEnum = majorType::floatingPoint;
+            else typeEnum = majorType::simpleValue;
             break;
     }
 
-    return cbor::type(typeEnum, typeSize, minorType);
+    return cbor::type(typeEnum, (size_t) typeSize, minorType);
 }
 
-size_t decoder::read_map()
+error_code decoder::read_argument(majorType expected, type &t, uint64_t &value)
 {
-    auto type = peekType();
-    if (type.major() != majorType::map)
-        throw std::runtime_error("wrong type" + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    if (peeked.value().major() != expected)
+        return error_code::wrong_type;
+
+    t = peeked.value();
+    if (_in->remaining() < 1 + t.size())
+        return error_code::truncated;
+
     _in->advance(1);
+    CBOR_STATS_DECODED((unsigned) expected, 1 + t.size());
+    return get_value(t, value);
+}
+
+error_code decoder::read_integer(int64_t min, int64_t max, int64_t &value)
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+
+    auto major = peeked.value().major();
+    if (major != majorType::unsignedInteger and major != majorType::signedInteger)
+        return error_code::wrong_type;
+
+    const size_t start = _in->offset();
+    type t;
+    uint64_t argument;
+    auto error = read_argument(major, t, argument);
+    if (error != error_code::ok)
+        return error;
 
-    return get_value<size_t>(type);
+    if (major == majorType::unsignedInteger)
+    {
+        if (argument > (uint64_t) max)
+        {
+            rewind(start);
+            return error_code::value_too_large;
+        }
+        value = (int64_t) argument;
+    } else
+    {
+        // a negative integer encodes -1 - argument
+        if (argument > (uint64_t) -(min + 1))
+        {
+            rewind(start);
+            return error_code::value_too_large;
+        }
+        value = -1 - (int64_t) argument;
+    }
+    return error_code::ok;
+}
+
+template<typename T>
+static T checked(decoder &dec, result<T> &&value)
+{
+    if (not value)
+    {
+        if (value.error() == error_code::wrong_type)
+            raise(value.error(), to_string(dec.peekType().major()));
+        raise(value.error());
+    }
+    return std::move(value.value());
+}
+
+error_code decoder::read_container(majorType expected, size_t &size)
+{
+    const size_t start = _in->offset();
+    type t;
+    uint64_t declared;
+    auto error = read_argument(expected, t, declared);
+    if (error != error_code::ok)
+        return error;
+
+    if (declared > _limits.max_container_size)
+        error = error_code::size_limit;
+    // every item takes at least one byte
+    else if (_limits.container_fits_input and declared > _in->remaining() / (expected == majorType::map ? 2 : 1))
+        error = error_code::truncated;
+
+    if (error != error_code::ok)
+    {
+        rewind(start);
+        return error;
+    }
+    size = (size_t) declared;
+    return error_code::ok;
+}
+
+size_t decoder::read_map()
+{
+    return checked(*this, try_read_map());
+}
+
+result<size_t> decoder::try_read_map()
+{
+    size_t size;
+    auto error = read_container(majorType::map, size);
+    if (error != error_code::ok)
+        return error;
+    return size;
 }
 
 size_t decoder::read_array()
 {
-    auto type = peekType();
-    if (type.major() != majorType::array)
-        throw std::runtime_error("wrong type" + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
+    return checked(*this, try_read_array());
+}
 
-    return get_value<size_t>(type);
+result<size_t> decoder::try_read_array()
+{
+    size_t size;
+    auto error = read_container(majorType::array, size);
+    if (error != error_code::ok)
+        return error;
+    return size;
 }
 
 void decoder::skip()
 {
-    auto type = peekType();
+    auto error = try_skip();
+    if (error != error_code::ok)
+        raise(error);
+}
+
+error_code decoder::try_skip()
+{
+    const size_t start = _in->offset();
+    const error_code error = skip_item(0);
+    if (error != error_code::ok)
+        rewind(start);
+    return error;
+}
+
+error_code decoder::skip_item(size_t depth)
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+
+    auto type = peeked.value();
+    if (_in->remaining() < 1 + type.size())
+        return error_code::truncated;
     _in->advance(1);
 
     switch (type.major())
     {
         case majorType::unsignedInteger:
         case majorType::signedInteger:
-        case majorType::tag:
         case majorType::floatingPoint:
+        case majorType::simpleValue:
             _in->advance(type.size());
             break;
+        case majorType::tag:
+            if (depth >= _limits.max_depth)
+                return error_code::depth_limit;
+            _in->advance(type.size());
+            return skip_item(depth + 1); // tagged item
         case majorType::byteString:
         case majorType::utf8String:
         {
-            size_t typeSize = get_value<size_t>(type);
-            _in->advance(typeSize + type.size());
+            uint64_t size;
+            const error_code error = get_value(type, size);
+            if (error != error_code::ok)
+                return error;
+            if (size > _limits.max_string_length)
+                return error_code::size_limit;
+            if (size > _in->remaining())
+                return error_code::truncated;
+            _in->advance(size);
         }
             break;
         case majorType::array:
-        {
-            size_t typeSize = get_value<size_t>(type);
-
-            while(typeSize--)
-            {
-                // skip sub element
-                skip();
-            }
-        }
-        break;
         case majorType::map:
         {
-            size_t typeSize = get_value<size_t>(type);
+            if (depth >= _limits.max_depth)
+                return error_code::depth_limit;
 
-            while(typeSize--)
+            uint64_t size;
+            error_code error = get_value(type, size);
+            if (error != error_code::ok)
+                return error;
+            if (size > _limits.max_container_size)
+                return error_code::size_limit;
+            if (size > _in->remaining())
+                return error_code::truncated;
+            if (type.major() == majorType::map)
+                size *= 2; // key and value
+
+            while (size--)
             {
-                skip(); // key
-                skip(); // value
+                error = skip_item(depth + 1);
+                if (error != error_code::ok)
+                    return error;
             }
         }
             break;
-
-        case majorType::simpleValue:
-            break;
     }
+    return error_code::ok;
 }
 
 uint32_t decoder::read_uint()
 {
-    auto type = peekType();
-    if (type.major() != majorType::unsignedInteger)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
+    return checked(*this, try_read_uint());
+}
 
-    return get_value<uint32_t>(type);
+result<uint32_t> decoder::try_read_uint()
+{
+    const size_t start = _in->offset();
+    type t;
+    uint64_t value;
+    auto error = read_argument(majorType::unsignedInteger, t, value);
+    if (error != error_code::ok)
+        return error;
+    if (value > UINT32_MAX)
+    {
+        rewind(start);
+        return error_code::value_too_large;
+    }
+    return (uint32_t) value;
 }
 
 uint64_t decoder::read_ulong()
 {
-    auto type = peekType();
-    if (type.major() != majorType::unsignedInteger)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
+    return checked(*this, try_read_ulong());
+}
 
-    return get_value<uint64_t>(type);
+result<uint64_t> decoder::try_read_ulong()
+{
+    type t;
+    uint64_t value;
+    auto error = read_argument(majorType::unsignedInteger, t, value);
+    if (error != error_code::ok)
+        return error;
+    return value;
 }
 
 int32_t decoder::read_int()
 {
-    auto type = peekType();
-    if (type.major() != majorType::signedInteger && type.major() != majorType::unsignedInteger)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
-
-    int32_t value = get_value<int32_t>(type);
-
-    if (type.major() == majorType::signedInteger)
-        return -value;
+    return checked(*this, try_read_int());
+}
 
-    return value;
+result<int32_t> decoder::try_read_int()
+{
+    int64_t value;
+    auto error = read_integer(INT32_MIN, INT32_MAX, value);
+    if (error != error_code::ok)
+        return error;
+    return (int32_t) value;
 }
 
 int64_t decoder::read_long()
 {
-    auto type = peekType();
-    if (type.major() != majorType::signedInteger)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
-
-    int64_t value = get_value<uint64_t>(type);
+    return checked(*this, try_read_long());
+}
 
-    if (type.major() == majorType::signedInteger)
-        return -value;
+result<int64_t> decoder::try_read_long()
+{
+    int64_t value;
+    auto error = read_integer(INT64_MIN, INT64_MAX, value);
+    if (error != error_code::ok)
+        return error;
     return value;
 }
 
 float decoder::read_float()
 {
-    auto type = peekType();
-    if (type.major() != majorType::floatingPoint and type.size() == 4)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
+    return checked(*this, try_read_float());
+}
+
+result<float> decoder::try_read_float()
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    if (peeked.value().major() != majorType::floatingPoint or peeked.value().size() != 4)
+        return error_code::wrong_type;
+    if (_in->remaining() < 5)
+        return error_code::truncated;
     _in->advance(1);
+    CBOR_STATS_DECODED(7, 5);
     return _in->get_float();
 }
 
 double decoder::read_double()
 {
-    auto type = peekType();
-    if (type.major() != majorType::floatingPoint and type.size() == 8)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
-    return _in->get_double();
+    return checked(*this, try_read_double());
+}
+
+result<double> decoder::try_read_double()
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    if (peeked.value().major() != majorType::floatingPoint)
+        return error_code::wrong_type;
+    if (_in->remaining() < 1 + peeked.value().size())
+        return error_code::truncated;
+
+    switch (peeked.value().size())
+    {
+        case 4:
+            _in->advance(1);
+            CBOR_STATS_DECODED(7, 5);
+            return (double) _in->get_float();
+        case 8:
+            _in->advance(1);
+            CBOR_STATS_DECODED(7, 9);
+            return _in->get_double();
+    }
+    return error_code::wrong_type;
 }
 
 std::string decoder::read_string()
 {
-    auto type = peekType();
-    if (type.major() != majorType::byteString && type.major() != majorType::utf8String)
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
-    _in->advance(1);
+    return checked(*this, try_read_string());
+}
 
-    size_t stringSize = get_value<size_t>(type);
+result<std::string> decoder::try_read_string()
+{
+    const size_t start = _in->offset();
+    size_t size;
+    auto data = try_read_string(size);
+    if (not data)
+        return data.error();
 
-    std::string tmpStr;
-    tmpStr.resize(stringSize);
+    if (size > _limits.allocation_budget - _allocated)
+    {
+        rewind(start);
+        return error_code::allocation_limit;
+    }
+    _allocated += size;
+    CBOR_STATS_ALLOCATION(size);
 
-    _in->get_bytes((char*)tmpStr.data(), stringSize);
+    return std::string(data.value(), size);
+}
 
-    return std::move(tmpStr);
+pmr_string decoder::read_pmr_string()
+{
+    return checked(*this, try_read_pmr_string());
+}
+
+result<pmr_string> decoder::try_read_pmr_string()
+{
+    const size_t start = _in->offset();
+    size_t size;
+    auto data = try_read_string(size);
+    if (not data)
+        return data.error();
+
+    if (size > _limits.allocation_budget - _allocated)
+    {
+        rewind(start);
+        return error_code::allocation_limit;
+    }
+    _allocated += size;
+    CBOR_STATS_ALLOCATION(size);
+
+    return pmr_string(data.value(), size, _resource);
+}
+
+const char *decoder::read_string(size_t &size)
+{
+    return checked(*this, try_read_string(size));
+}
+
+result<const char *> decoder::try_read_string(size_t &size)
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+
+    auto major = peeked.value().major();
+    if (major != majorType::byteString && major != majorType::utf8String)
+        return error_code::wrong_type;
+
+    const size_t start = _in->offset();
+    type t;
+    uint64_t length;
+    auto error = read_argument(major, t, length);
+    if (error != error_code::ok)
+        return error;
+
+    if (length > _limits.max_string_length)
+        error = error_code::size_limit;
+    else if (length > _in->remaining())
+        error = error_code::truncated;
+    else if (_validateUtf8 and major == majorType::utf8String and
+             not is_valid_utf8((const char *) _in->current(), (size_t) length))
+        error = error_code::invalid_utf8;
+
+    if (error != error_code::ok)
+    {
+        rewind(start);
+        return error;
+    }
+
+    size = (size_t) length;
+    CBOR_STATS_STRING((unsigned) major, size);
+    const char *data = (const char *) _in->current();
+    _in->advance(size);
+    return data;
+}
+
+int decoder::read_key(const key_table &table)
+{
+    return checked(*this, try_read_key(table));
+}
+
+result<int> decoder::try_read_key(const key_table &table)
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    if (peeked.value().major() != majorType::utf8String)
+        return error_code::wrong_type;
+
+    size_t size;
+    auto data = try_read_string(size);
+    if (not data)
+        return data.error();
+
+    return table.find(data.value(), size);
+}
+
+uint64_t decoder::read_tag()
+{
+    return checked(*this, try_read_tag());
+}
+
+result<uint64_t> decoder::try_read_tag()
+{
+    type t;
+    uint64_t tag;
+    auto error = read_argument(majorType::tag, t, tag);
+    if (error != error_code::ok)
+        return error;
+    return tag;
 }
 
 bool decoder::read_bool()
 {
-    auto type = peekType();
-    if (type.major() != majorType::simpleValue or (type.directValue() != 20 and type.directValue() != 21) )
-        throw std::runtime_error("wrong type " + to_string(type.major()) + " " + __FILE__ + ":" + to_string(__LINE__));
+    return checked(*this, try_read_bool());
+}
+
+result<bool> decoder::try_read_bool()
+{
+    auto peeked = try_peek_type();
+    if (not peeked)
+        return peeked.error();
+
+    auto type = peeked.value();
+    if (type.major() != majorType::simpleValue or (type.directValue() != 20 and type.directValue() != 21))
+        return error_code::wrong_type;
     _in->advance(1);
+    CBOR_STATS_DECODED(7, 1);
 
     return type.directValue() == 21;
 }
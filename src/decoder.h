@@ -19,9 +19,16 @@
 
 #include "listener.h"
 #include "input.h"
-#include <stdexcept>
+#include "error.h"
+#include "utf8.h"
+#include "memory_resource.h"
+#include "key_table.h"
+#include <stdint.h>
+#include <vector>
 
 namespace cbor {
+    class tag_registry;
+
     typedef enum {
         STATE_TYPE,
         STATE_PINT,
@@ -30,6 +37,8 @@ namespace cbor {
         STATE_BYTES_DATA,
         STATE_STRING_SIZE,
         STATE_STRING_DATA,
+        STATE_BYTES_CHUNKS,
+        STATE_STRING_CHUNKS,
         STATE_ARRAY,
         STATE_MAP,
         STATE_TAG,
@@ -66,12 +75,38 @@ namespace cbor {
         size_t m_size;
         uint8_t m_value;
     public:
+        type():m_major(majorType::simpleValue), m_size(0), m_value(0) {}
         type(const majorType& mt, const size_t& size, uint8_t v = 0):m_major(mt), m_size(size), m_value(v) {}
         majorType major() const { return m_major; }
         size_t size() const { return m_size; }
         uint8_t directValue() const { return m_value; }
     };
 
+    /**
+     * Limits for decoding untrusted input. They are checked before anything
+     * is allocated, so memory and time stay proportional to the input size.
+     */
+    struct decoder_limits
+    {
+        /// nesting of arrays, maps and tags
+        size_t max_depth;
+        uint64_t max_string_length;
+        /// declared number of array elements or map entries
+        uint64_t max_container_size;
+        /// pull API: reject containers declaring more items than input bytes left
+        bool container_fits_input;
+        /// bytes the decoder itself may allocate, see decoder::allocated()
+        uint64_t allocation_budget;
+
+        decoder_limits()
+                : max_depth(512),
+                  max_string_length(UINT64_MAX),
+                  max_container_size(UINT64_MAX),
+                  container_fits_input(true),
+                  allocation_budget(UINT64_MAX)
+        {}
+    };
+
 /*
 0: uint8_t, uint16_t, uint32_t, uint64_t
 1: int8_t, int16_t, int32_t, int64_t
@@ -87,56 +122,177 @@ namespace cbor {
     private:
         listener *_listener;
         input *_in;
+        memory_resource *_resource;
         decoder_state _state;
-        int _currentLength;
+        uint64_t _currentLength;
+        uint64_t _chunkOffset;
+        uint64_t _chunkThreshold;
+        decoder_limits _limits;
+        uint64_t _allocated;
+        bool _validateUtf8;
+        utf8_validator _utf8; //< state of a chunked text string
+        const key_table *_keys;
+        const tag_registry *_tags;
+        pmr_vector<uint64_t> _stack; //< items left in each open container << 1 | is map
+        std::string _text; //< reused for strings passed to on_string()
 
         template<typename T>
-        T get_value(type t)
+        error_code get_value(type t, T &value)
         {
             if (t.size() > sizeof(T))
-            {
-                throw std::runtime_error("value does not fit into receiver ");
-            }
+                return error_code::value_too_large;
 
             switch (t.size())
             {
-                case 0: return t.directValue();
-                case 1: return _in->get_byte();
-                case 2: return _in->get_short();
-                case 4: return _in->get_int();
-                case 8: return _in->get_long();
+                case 0: value = t.directValue(); return error_code::ok;
+                case 1: value = _in->get_byte(); return error_code::ok;
+                case 2: value = _in->get_short(); return error_code::ok;
+                case 4: value = _in->get_int(); return error_code::ok;
+                case 8: value = _in->get_long(); return error_code::ok;
             }
-            throw std::runtime_error("invalid type-size");
+            return error_code::invalid_additional_info;
         }
 
+        void fail(const char *error);
+        bool begin_container(uint64_t size, bool map);
+        bool begin_tag();
+        void begin_array(uint64_t size);
+        void begin_map(uint64_t size);
+        void item_done();
+        bool at_map_key() const;
+        void begin_string(uint64_t length, decoder_state state);
+
+        error_code read_argument(majorType expected, type &t, uint64_t &value);
+        error_code read_container(majorType expected, size_t &size);
+        error_code skip_item(size_t depth);
+        error_code read_integer(int64_t min, int64_t max, int64_t &value);
+        bool run_registered_tag(size_t start, bool &incomplete);
+
     public:
-        decoder(input &in);
-        decoder(input &in, listener &listener);
+        /// the decoder allocates from resource, see also read_pmr_string()
+        decoder(input &in, memory_resource *resource = get_default_resource());
+        decoder(input &in, listener &listener, memory_resource *resource = get_default_resource());
         ~decoder();
         void run();
         void set_listener(listener &listener_instance);
 
+        /**
+         * Continues run() on another buffer. run() returns when the rest of
+         * the input does not make up the next step, and everything from
+         * input::offset() on (input::remaining() bytes) has to be copied to
+         * the start of the next buffer, before the new data. That is more
+         * than a partial header when a string is pending: a string at or
+         * below the chunk threshold waits until all of it is there, its
+         * header already consumed. With a tag registry, a registered tag
+         * waits until its whole item is there, the tag header included.
+         */
+        void set_input(input &in) { _in = &in; }
+
+        /**
+         * Strings longer than threshold bytes are passed to
+         * on_bytes_chunk()/on_string_chunk() as they arrive instead of being
+         * buffered whole. 0 turns chunking off.
+         */
+        void set_chunk_threshold(uint64_t threshold) { _chunkThreshold = threshold; }
+
+        /**
+         * Checks text strings for valid UTF-8 before they are passed on.
+         * run() reports invalid ones through on_error(), try_read_string()
+         * returns error_code::invalid_utf8. Off by default.
+         */
+        void set_validate_utf8(bool validate) { _validateUtf8 = validate; }
+
+        /**
+         * Text map keys found in table are passed to on_key() as symbols
+         * instead of being copied into a string. nullptr turns it off.
+         */
+        void set_key_table(const key_table *table) { _keys = table; }
+
+        /**
+         * Tags with a handler in registry are passed to it together with
+         * the tagged item, which has to be complete in the input. Other
+         * tags go to on_tag() as usual. nullptr turns it off.
+         */
+        void set_tag_registry(const tag_registry *registry) { _tags = registry; }
+
+        /// also resets the allocation count
+        void set_limits(const decoder_limits &limits);
+        const decoder_limits &limits() const { return _limits; }
+
+        /// bytes allocated for decoded values so far
+        uint64_t allocated() const { return _allocated; }
+
         size_t offset() const { return _in->offset(); }
 
+        /// moves back to an offset returned by offset()
+        void rewind(size_t offset) { _in->rewind(offset); }
+
+        /// the encoded bytes at offset(), for readers working on them in place
+        const unsigned char *current() const { return _in->current(); }
+        size_t remaining() const { return _in->remaining(); }
+
+        /// moves past bytes such a reader consumed
+        void advance(size_t bytes) { _in->advance(bytes); }
+
+        memory_resource *resource() const { return _resource; }
+
         type peekType() const;
 
+        /*
+         * Pull API. The read_* methods throw decode_error on mismatch, the
+         * try_read_* ones return the error code instead and leave the input
+         * where it was, so they are cheap to use for probing.
+         */
+        result<type> try_peek_type() const;
+
         size_t read_map();
+        result<size_t> try_read_map();
+
         size_t read_array();
+        result<size_t> try_read_array();
 
         uint32_t read_uint();
+        result<uint32_t> try_read_uint();
+
         uint64_t read_ulong();
+        result<uint64_t> try_read_ulong();
 
         int32_t read_int();
+        result<int32_t> try_read_int();
+
         int64_t read_long();
+        result<int64_t> try_read_long();
 
         float read_float();
+        result<float> try_read_float();
+
+        /// also accepts single precision values
         double read_double();
+        result<double> try_read_double();
 
         std::string read_string();
+        result<std::string> try_read_string();
+
+        /// read_string() allocating from resource()
+        pmr_string read_pmr_string();
+        result<pmr_string> try_read_pmr_string();
+
+        /// zero copy read_string(): returns a pointer into the input
+        const char *read_string(size_t &size);
+        result<const char *> try_read_string(size_t &size);
+
+        /// reads a text string and returns its symbol in table or key_table::npos
+        int read_key(const key_table &table);
+        result<int> try_read_key(const key_table &table);
+
+        uint64_t read_tag();
+        result<uint64_t> try_read_tag();
 
         bool read_bool();
+        result<bool> try_read_bool();
 
         void skip();
+        error_code try_skip();
     };
 }
 
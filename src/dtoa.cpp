@@ -0,0 +1,395 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "dtoa.h"
+
+#include <string.h>
+
+namespace cbor {
+
+static const char digit_pairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+size_t format_uint(uint64_t value, char *buffer)
+{
+    char digits[20];
+    char *p = digits + sizeof(digits);
+
+    while (value >= 100)
+    {
+        const unsigned pair = (unsigned) (value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10)
+    {
+        const unsigned pair = (unsigned) value * 2;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    } else
+    {
+        *--p = (char) ('0' + value);
+    }
+
+    const size_t length = digits + sizeof(digits) - p;
+    memcpy(buffer, p, length);
+    return length;
+}
+
+size_t format_int(int64_t value, char *buffer)
+{
+    if (value >= 0)
+        return format_uint((uint64_t) value, buffer);
+
+    buffer[0] = '-';
+    return 1 + format_uint(0 - (uint64_t) value, buffer + 1);
+}
+
+namespace {
+
+/// unnormalized floating point number f * 2^e
+struct diy_fp
+{
+    uint64_t f;
+    int e;
+
+    diy_fp(uint64_t f, int e) : f(f), e(e) {}
+
+    diy_fp operator-(const diy_fp &rhs) const { return diy_fp(f - rhs.f, e); }
+
+    /// upper 64 bits of the product, rounded
+    diy_fp operator*(const diy_fp &rhs) const
+    {
+#ifdef __SIZEOF_INT128__
+        const unsigned __int128 p = (unsigned __int128) f * rhs.f;
+        uint64_t h = (uint64_t) (p >> 64);
+        if ((uint64_t) p & (1ULL << 63))
+            h++;
+#else
+        const uint64_t m32 = 0xFFFFFFFFu;
+        const uint64_t a = f >> 32, b = f & m32, c = rhs.f >> 32, d = rhs.f & m32;
+        const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+        tmp += 1U << 31;
+        const uint64_t h = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+#endif
+        return diy_fp(h, e + rhs.e + 64);
+    }
+
+    diy_fp normalize() const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        const int shift = __builtin_clzll(f);
+#else
+        int shift = 0;
+        while ((f << shift & (1ULL << 63)) == 0)
+            shift++;
+#endif
+        return diy_fp(f << shift, e - shift);
+    }
+};
+
+}
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+static const uint32_t pow10_32[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const uint64_t pow10_64[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+        1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+        1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/// cached power c with c * 2^e in a range digit generation can handle, k its decimal exponent negated
+static diy_fp cached_power(int e, int &k)
+{
+    const double dk = (-61 - e) * 0.30102999566398114 + 347; // log10(2)
+    int ik = (int) dk;
+    if (dk - ik > 0.0)
+        ik++;
+
+    const unsigned index = (unsigned) ((ik >> 3) + 1);
+    k = -(-348 + (int) (index << 3));
+    return diy_fp(cached_powers_f[index], cached_powers_e[index]);
+}
+
+static int count_digits(uint32_t n)
+{
+    int digits = 1;
+    while (digits < 10 and n >= pow10_32[digits])
+        digits++;
+    return digits;
+}
+
+static void round_weed(char *buffer, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w and delta - rest >= ten_kappa and
+           (rest + ten_kappa < wp_w or wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void digit_gen(const diy_fp &w, const diy_fp &mp, uint64_t delta, char *buffer, int &length, int &k)
+{
+    const diy_fp one(1ULL << -mp.e, mp.e);
+    const diy_fp wp_w = mp - w;
+    uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits(p1);
+    length = 0;
+
+    while (kappa > 0)
+    {
+        const uint32_t d = p1 / pow10_32[kappa - 1];
+        p1 %= pow10_32[kappa - 1];
+        if (d != 0 or length != 0)
+            buffer[length++] = (char) ('0' + d);
+        kappa--;
+
+        const uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest <= delta)
+        {
+            k += kappa;
+            round_weed(buffer, length, delta, rest, (uint64_t) pow10_32[kappa] << -one.e, wp_w.f);
+            return;
+        }
+    }
+
+    for (;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+        const char d = (char) (p2 >> -one.e);
+        if (d != 0 or length != 0)
+            buffer[length++] = (char) ('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta)
+        {
+            k += kappa;
+            round_weed(buffer, length, delta, p2, one.f, -kappa < 20 ? wp_w.f * pow10_64[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/// digits and decimal exponent of significand * 2^exponent; hidden is the implicit bit
+static void grisu2(uint64_t significand, int exponent, uint64_t hidden, char *buffer, int &length, int &k)
+{
+    const diy_fp v(significand, exponent);
+
+    // the neighbours halfway to the next smaller and bigger value
+    const diy_fp plus = diy_fp((v.f << 1) + 1, v.e - 1).normalize();
+    diy_fp minus = v.f == hidden ? diy_fp((v.f << 2) - 1, v.e - 2) : diy_fp((v.f << 1) - 1, v.e - 1);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    const diy_fp c = cached_power(plus.e, k);
+    const diy_fp w = v.normalize() * c;
+    diy_fp wp = plus * c;
+    diy_fp wm = minus * c;
+    wm.f++;
+    wp.f--;
+
+    digit_gen(w, wp, wp.f - wm.f, buffer, length, k);
+}
+
+static char *write_exponent(int k, char *buffer)
+{
+    if (k < 0)
+    {
+        *buffer++ = '-';
+        k = -k;
+    } else
+    {
+        *buffer++ = '+';
+    }
+
+    if (k >= 100)
+    {
+        *buffer++ = (char) ('0' + k / 100);
+        k %= 100;
+        *buffer++ = digit_pairs[k * 2];
+        *buffer++ = digit_pairs[k * 2 + 1];
+    } else if (k >= 10)
+    {
+        *buffer++ = digit_pairs[k * 2];
+        *buffer++ = digit_pairs[k * 2 + 1];
+    } else
+    {
+        *buffer++ = (char) ('0' + k);
+    }
+    return buffer;
+}
+
+/// turns digits * 10^k into plain or exponent notation, returns the end
+static char *prettify(char *buffer, int length, int k)
+{
+    const int kk = length + k; // 10^(kk - 1) <= v < 10^kk
+
+    if (k >= 0 and kk <= 21)
+    {
+        // 1234e7 -> 12340000000.0
+        for (int i = length; i < kk; i++)
+            buffer[i] = '0';
+        buffer[kk] = '.';
+        buffer[kk + 1] = '0';
+        return buffer + kk + 2;
+    }
+
+    if (kk > 0 and kk <= 21)
+    {
+        // 1234e-2 -> 12.34
+        memmove(buffer + kk + 1, buffer + kk, length - kk);
+        buffer[kk] = '.';
+        return buffer + length + 1;
+    }
+
+    if (kk > -6 and kk <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        const int offset = 2 - kk;
+        memmove(buffer + offset, buffer, length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (int i = 2; i < offset; i++)
+            buffer[i] = '0';
+        return buffer + length + offset;
+    }
+
+    if (length == 1)
+    {
+        // 1e30
+        buffer[1] = 'e';
+        return write_exponent(kk - 1, buffer + 2);
+    }
+
+    // 1234e30 -> 1.234e+33
+    memmove(buffer + 2, buffer + 1, length - 1);
+    buffer[1] = '.';
+    buffer[length + 1] = 'e';
+    return write_exponent(kk - 1, buffer + length + 2);
+}
+
+size_t format_double(double value, char *buffer)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    char *p = buffer;
+    if (bits >> 63)
+        *p++ = '-';
+
+    const int biased = (int) (bits >> 52 & 0x7FF);
+    uint64_t significand = bits & ((1ULL << 52) - 1);
+    if (biased == 0 and significand == 0)
+    {
+        memcpy(p, "0.0", 3);
+        return p + 3 - buffer;
+    }
+
+    int exponent = -1074;
+    if (biased != 0)
+    {
+        significand |= 1ULL << 52;
+        exponent = biased - 1075;
+    }
+
+    int length, k;
+    grisu2(significand, exponent, 1ULL << 52, p, length, k);
+    return prettify(p, length, k) - buffer;
+}
+
+size_t format_float(float value, char *buffer)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    char *p = buffer;
+    if (bits >> 31)
+        *p++ = '-';
+
+    const int biased = (int) (bits >> 23 & 0xFF);
+    uint64_t significand = bits & ((1u << 23) - 1);
+    if (biased == 0 and significand == 0)
+    {
+        memcpy(p, "0.0", 3);
+        return p + 3 - buffer;
+    }
+
+    int exponent = -149;
+    if (biased != 0)
+    {
+        significand |= 1u << 23;
+        exponent = biased - 150;
+    }
+
+    int length, k;
+    grisu2(significand, exponent, 1u << 23, p, length, k);
+    return prettify(p, length, k) - buffer;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Number formatting without printf. Floating point values use Grisu2: the
+ * result always reads back as the same value and is the shortest such
+ * string for all but a tiny fraction of inputs. Output looks like "1.5",
+ * "100.0", "1e+30" or "1.25e-7", which is valid JSON and CBOR diagnostic
+ * notation. Infinities and NaN are not handled, callers decide.
+ */
+
+namespace cbor {
+
+    /// buffer needs 20 bytes, returns the length
+    size_t format_uint(uint64_t value, char *buffer);
+
+    /// buffer needs 21 bytes
+    size_t format_int(int64_t value, char *buffer);
+
+    /// buffer needs 32 bytes, value must be finite
+    size_t format_double(double value, char *buffer);
+
+    /// shortest form that reads back as the same float
+    size_t format_float(float value, char *buffer);
+}
@@ -0,0 +1,112 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <exception>
+#include <vector>
+
+#include "cbor.h"
+
+/*
+ * cbor-dump [file ...]
+ *
+ * Prints CBOR files, or a CBOR sequence, as diagnostic notation, one top
+ * level item per line. Files are memory mapped; without arguments or with
+ * "-" it reads standard input.
+ */
+
+static std::vector<unsigned char> read_all(int fd)
+{
+    std::vector<unsigned char> data;
+    size_t size = 0;
+    for (;;)
+    {
+        data.resize(size + 65536);
+        const ssize_t n = read(fd, data.data() + size, 65536);
+        if (n <= 0)
+            break;
+        size += (size_t) n;
+    }
+    data.resize(size);
+    return data;
+}
+
+static bool dump(const unsigned char *data, size_t size, const char *name, cbor::output_file &out)
+{
+    cbor::input in(data, size);
+    cbor::listener_diag diag(out);
+    cbor::decoder dec(in, diag);
+
+    // big strings are printed as they are decoded instead of being copied
+    dec.set_chunk_threshold(65536);
+    dec.run();
+
+    diag.flush();
+    out.flush();
+
+    if (diag.failed())
+    {
+        fprintf(stderr, "cbor-dump: %s: %s at offset %zu\n", name, diag.error().c_str(), in.offset());
+        return false;
+    }
+    if (not diag.complete() or in.remaining() != 0)
+    {
+        fprintf(stderr, "cbor-dump: %s: truncated at offset %zu\n", name, in.offset());
+        return false;
+    }
+    return true;
+}
+
+static bool dump_file(const char *path, cbor::output_file &out)
+{
+    if (strcmp(path, "-") == 0)
+    {
+        const std::vector<unsigned char> data = read_all(STDIN_FILENO);
+        return dump(data.data(), data.size(), "stdin", out);
+    }
+
+#ifndef CBOR_NO_EXCEPTIONS
+    try
+    {
+#endif
+        cbor::mapped_file file(path);
+        return dump(file.data(), file.size(), path, out);
+#ifndef CBOR_NO_EXCEPTIONS
+    } catch (const std::exception &e)
+    {
+        fprintf(stderr, "cbor-dump: %s\n", e.what());
+        return false;
+    }
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    cbor::output_file out(STDOUT_FILENO);
+    int status = 0;
+
+    if (argc < 2 and not dump_file("-", out))
+        status = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (not dump_file(argv[i], out))
+            status = 1;
+    }
+
+    return status;
+}
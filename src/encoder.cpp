@@ -15,13 +15,10 @@
 */
 
 #include "encoder.h"
+#include "byte_order.h"
+#include "stats.h"
 
-#define ENDIAN_OPT 0
-
-#if ENDIAN_OPT == 0
-#else
-#include "endian.h"
-#endif
+#include <string.h>
 
 namespace cbor {
 
@@ -36,70 +33,33 @@ encoder::~encoder() {
 
 inline
 void encoder::write_type_value(int major_type, unsigned int value) {
+    CBOR_STATS_ENCODED(major_type, value < 24 ? 1 : value < 256 ? 2 : value < 65536 ? 3 : 5);
     major_type <<= 5;
     if (value < 24) {
         _out->put_byte((unsigned char) (major_type | value));
     } else if (value < 256) {
-        _out->put_byte((unsigned char) (major_type | 24));
-        _out->put_byte((unsigned char) value);
+        unsigned char head[2] = {(unsigned char) (major_type | 24), (unsigned char) value};
+        _out->put_bytes(head, sizeof(head));
     } else if (value < 65536) {
-        _out->put_byte((unsigned char) (major_type | 25));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        unsigned char head[3] = {(unsigned char) (major_type | 25)};
+        store_be16(head + 1, (uint16_t) value);
+        _out->put_bytes(head, sizeof(head));
     } else {
-        _out->put_byte((unsigned char) (major_type | 26));
-#if ENDIAN_OPT == 0
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
-#else
-        uint32_t t = htobe32(value);
-        _out->put_bytes((unsigned char*)&t, sizeof(t));
-#endif
-
-
+        unsigned char head[5] = {(unsigned char) (major_type | 26)};
+        store_be32(head + 1, value);
+        _out->put_bytes(head, sizeof(head));
     }
 }
 
 inline
 void encoder::write_type_value(int major_type, unsigned long long value) {
-    major_type <<= 5;
-    if (value < 24ULL) {
-        _out->put_byte((unsigned char) (major_type | value));
-    } else if (value < 256ULL) {
-        _out->put_byte((unsigned char) (major_type | 24));
-        _out->put_byte((unsigned char) value);
-    } else if (value < 65536ULL) {
-        _out->put_byte((unsigned char) (major_type | 25));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
-    } else if (value < 4294967296ULL) {
-        _out->put_byte((unsigned char) (major_type | 26));
-#if ENDIAN_OPT == 0
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
-#else
-        uint32_t t = htobe32(value);
-        _out->put_bytes((unsigned char*)&t, sizeof(t));
-#endif
+    if (value < 4294967296ULL) {
+        write_type_value(major_type, (unsigned int) value);
     } else {
-#if ENDIAN_OPT == 0
-        _out->put_byte((unsigned char) (major_type | 27));
-        _out->put_byte((unsigned char) (value >> 56));
-        _out->put_byte((unsigned char) (value >> 48));
-        _out->put_byte((unsigned char) (value >> 40));
-        _out->put_byte((unsigned char) (value >> 32));
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
-#else
-        uint64_t t = htobe64(value);
-        _out->put_bytes((unsigned char*)&t, sizeof(t));
-#endif
+        CBOR_STATS_ENCODED(major_type, 9);
+        unsigned char head[9] = {(unsigned char) ((major_type << 5) | 27)};
+        store_be64(head + 1, value);
+        _out->put_bytes(head, sizeof(head));
     }
 }
 
@@ -119,6 +79,10 @@ void encoder::write_int(long long value) {
     }
 }
 
+void encoder::write_negative(unsigned long long value) {
+    write_type_value(1, value);
+}
+
 void encoder::write_int(int value) {
     if (value < 0) {
         write_type_value(1, (unsigned int) -(value+1));
@@ -129,26 +93,29 @@ void encoder::write_int(int value) {
 
 void encoder::write_bytes(const unsigned char *data, unsigned int size) {
     write_type_value(2, size);
+    CBOR_STATS_PAYLOAD(2, size);
     _out->put_bytes(data, size);
 }
 
 void encoder::write_string(const char *data, unsigned int size) {
     write_type_value(3, size);
+    CBOR_STATS_PAYLOAD(3, size);
     _out->put_bytes((const unsigned char *) data, size);
 }
 
 void encoder::write_string(const std::string str) {
     write_type_value(3, (unsigned int) str.size());
+    CBOR_STATS_PAYLOAD(3, str.size());
     _out->put_bytes((const unsigned char *) str.c_str(), (int) str.size());
 }
 
 
-void encoder::write_array(int size) {
-    write_type_value(4, (unsigned int) size);
+void encoder::write_array(unsigned long long size) {
+    write_type_value(4, size);
 }
 
-void encoder::write_map(int size) {
-    write_type_value(5, (unsigned int) size);
+void encoder::write_map(unsigned long long size) {
+    write_type_value(5, size);
 }
 
 void encoder::write_tag(const unsigned int tag) {
@@ -160,6 +127,7 @@ void encoder::write_special(int special) {
 }
 
 void encoder::write_bool(bool value) {
+    CBOR_STATS_ENCODED(7, 1);
     if (value == true) {
         _out->put_byte((unsigned char) 0xf5);
     } else {
@@ -168,64 +136,92 @@ void encoder::write_bool(bool value) {
 }
 
 void encoder::write_null() {
+    CBOR_STATS_ENCODED(7, 1);
     _out->put_byte((unsigned char) 0xf6);
 }
 
 void encoder::write_undefined() {
+    CBOR_STATS_ENCODED(7, 1);
     _out->put_byte((unsigned char) 0xf7);
 }
 
 void encoder::write_float(float value) {
     static_assert(sizeof(uint32_t) == sizeof(float), "float is not 32 bit");
 
-    union {
-        float float_val;
-        uint32_t uint32_val;
-    } u;
-
-    uint8_t major_type = (7 << 5);
-    _out->put_byte(major_type | 26);
-
-#if ENDIAN_OPT == 0
-    uint32_t *t = (uint32_t*)&value;
-    _out->put_byte((unsigned char) (*t >> 24));
-    _out->put_byte((unsigned char) (*t >> 16));
-    _out->put_byte((unsigned char) (*t >> 8));
-    _out->put_byte((unsigned char) *t);
-#else
-    u.float_val = value;
-    uint32_t t = htobe32(u.uint32_val);
-    _out->put_bytes((unsigned char*)&t, sizeof(t));
-#endif
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned char head[5] = {(unsigned char) ((7 << 5) | 26)};
+    store_be32(head + 1, bits);
+    _out->put_bytes(head, sizeof(head));
+    CBOR_STATS_ENCODED(7, sizeof(head));
 }
 
 void encoder::write_double(double value) {
     static_assert(sizeof(uint64_t) == sizeof(double), "double is not 64 bit");
-    uint8_t major_type = (7 << 5);
-    _out->put_byte(major_type | 27);
-
-
-#if ENDIAN_OPT == 0
-    uint64_t *t = (uint64_t*)&value;
-    _out->put_byte( major_type | 27);
-    _out->put_byte((unsigned char) (*t >> 56));
-    _out->put_byte((unsigned char) (*t >> 48));
-    _out->put_byte((unsigned char) (*t >> 40));
-    _out->put_byte((unsigned char) (*t >> 32));
-    _out->put_byte((unsigned char) (*t >> 24));
-    _out->put_byte((unsigned char) (*t >> 16));
-    _out->put_byte((unsigned char) (*t >> 8));
-    _out->put_byte((unsigned char) *t);
-#else
-    union {
-        double double_val;
-        uint64_t uin64_val;
-    } u;
-    u.double_val = value;
-    uint64_t t = htobe64(u.uin64_val);
-
-    _out->put_bytes((unsigned char*)&t, sizeof(t));
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned char head[9] = {(unsigned char) ((7 << 5) | 27)};
+    store_be64(head + 1, bits);
+    _out->put_bytes(head, sizeof(head));
+    CBOR_STATS_ENCODED(7, sizeof(head));
+}
+
+void encoder::write_datetime(const std::string &text) {
+    write_tag(0);
+    write_string(text);
+}
+
+void encoder::write_epoch(long long seconds) {
+    write_tag(1);
+    write_int(seconds);
+}
+
+void encoder::write_epoch(double seconds) {
+    write_tag(1);
+    write_double(seconds);
+}
+
+void encoder::write_bignum(const unsigned char *magnitude, unsigned int size, bool negative) {
+    write_tag(negative ? 3 : 2);
+    write_bytes(magnitude, size);
+}
+
+#ifdef __SIZEOF_INT128__
+void encoder::write_int128(__int128 value) {
+    const bool negative = value < 0;
+    const unsigned __int128 magnitude = negative ? (unsigned __int128) (-1 - value) : (unsigned __int128) value;
+
+    if (magnitude <= UINT64_MAX) {
+        write_type_value(negative ? 1 : 0, (unsigned long long) magnitude);
+        return;
+    }
+
+    unsigned char bytes[16];
+    store_be64(bytes, (uint64_t) (magnitude >> 64));
+    store_be64(bytes + 8, (uint64_t) magnitude);
+
+    unsigned int skip = 0;
+    while (bytes[skip] == 0)
+        skip++;
+    write_bignum(bytes + skip, 16 - skip, negative);
+}
 #endif
+
+void encoder::write_decimal(long long exponent, long long mantissa) {
+    write_tag(4);
+    write_array(2);
+    write_int(exponent);
+    write_int(mantissa);
+}
+
+void encoder::write_bigfloat(long long exponent, long long mantissa) {
+    write_tag(5);
+    write_array(2);
+    write_int(exponent);
+    write_int(mantissa);
 }
 
 }
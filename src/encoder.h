@@ -37,15 +37,18 @@ namespace cbor {
 
         void write_int(unsigned long long value);
 
+        /// -1 - value, reaches the negative integers below LLONG_MIN down to -2^64
+        void write_negative(unsigned long long value);
+
         void write_bytes(const unsigned char *data, unsigned int size);
 
         void write_string(const char *data, unsigned int size);
 
         void write_string(const std::string str);
 
-        void write_array(int size);
+        void write_array(unsigned long long size);
 
-        void write_map(int size);
+        void write_map(unsigned long long size);
 
         void write_tag(const unsigned int tag);
 
@@ -59,6 +62,26 @@ namespace cbor {
         
         void write_undefined();
 
+        /// tag 0 with an RFC 3339 date/time, see format_rfc3339()
+        void write_datetime(const std::string &text);
+
+        /// tag 1, seconds since 1970
+        void write_epoch(long long seconds);
+        void write_epoch(double seconds);
+
+        /// tag 2, or tag 3 for -1 - magnitude; magnitude is big endian
+        void write_bignum(const unsigned char *magnitude, unsigned int size, bool negative);
+
+#ifdef __SIZEOF_INT128__
+        /// plain integer if it fits, a bignum otherwise
+        void write_int128(__int128 value);
+#endif
+
+        /// tag 4, mantissa * 10^exponent
+        void write_decimal(long long exponent, long long mantissa);
+
+        /// tag 5, mantissa * 2^exponent
+        void write_bigfloat(long long exponent, long long mantissa);
 
     private:
         void write_type_value(int major_type, unsigned int value);
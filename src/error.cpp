@@ -0,0 +1,65 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace cbor {
+
+const char *to_string(error_code code)
+{
+    switch (code)
+    {
+        case error_code::ok: return "ok";
+        case error_code::wrong_type: return "wrong type";
+        case error_code::value_too_large: return "value does not fit into receiver";
+        case error_code::invalid_additional_info: return "invalid additional info";
+        case error_code::truncated: return "truncated input";
+        case error_code::depth_limit: return "nesting too deep";
+        case error_code::size_limit: return "declared size over limit";
+        case error_code::allocation_limit: return "allocation budget exceeded";
+        case error_code::invalid_utf8: return "invalid UTF-8 in text string";
+        case error_code::invalid_tag_content: return "tagged item does not match its tag";
+        case error_code::invalid_json: return "invalid JSON";
+    }
+    return "unknown error";
+}
+
+void raise(error_code code, const std::string &detail)
+{
+    std::string message = to_string(code);
+    if (not detail.empty())
+        message += " " + detail;
+
+#ifdef CBOR_NO_EXCEPTIONS
+    fprintf(stderr, "cbor: %s\n", message.c_str());
+    abort();
+#else
+    throw decode_error(code, message);
+#endif
+}
+
+void raise(const std::string &message)
+{
+#ifdef CBOR_NO_EXCEPTIONS
+    fprintf(stderr, "cbor: %s\n", message.c_str());
+    abort();
+#else
+    throw std::runtime_error(message);
+#endif
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace cbor {
+
+    enum class error_code
+    {
+        ok,
+        wrong_type,
+        value_too_large,        //< value does not fit into the receiver
+        invalid_additional_info,
+        truncated,              //< item extends past the end of the input
+        depth_limit,            //< nesting deeper than decoder_limits::max_depth
+        size_limit,             //< declared string or container size over the limits
+        allocation_limit,       //< decoder_limits::allocation_budget used up
+        invalid_utf8,           //< text string is not valid UTF-8, see decoder::set_validate_utf8()
+        invalid_tag_content,    //< item does not match its tag, e.g. a malformed date
+        invalid_json            //< malformed JSON text, see json_reader
+    };
+
+    const char *to_string(error_code code);
+
+    /// thrown by the throwing read_* methods, carries the error code
+    class decode_error : public std::runtime_error {
+    private:
+        error_code _code;
+    public:
+        decode_error(error_code code, const std::string &what) : std::runtime_error(what), _code(code) {}
+
+        error_code code() const { return _code; }
+    };
+
+    /**
+     * Value or error code returned by the try_read_* methods.
+     * Building an error result does not allocate.
+     */
+    template<typename T>
+    class result {
+    private:
+        T _value;
+        error_code _error;
+    public:
+        result(const T &value) : _value(value), _error(error_code::ok) {}
+        result(T &&value) : _value(std::move(value)), _error(error_code::ok) {}
+        result(error_code error) : _value(), _error(error) {}
+
+        bool ok() const { return _error == error_code::ok; }
+        explicit operator bool() const { return ok(); }
+
+        error_code error() const { return _error; }
+
+        const T &value() const { return _value; }
+        T &value() { return _value; }
+
+        T value_or(const T &fallback) const { return ok() ? _value : fallback; }
+    };
+
+    /**
+     * Error reporting for the throwing API. Throws decode_error (or
+     * std::runtime_error), or with CBOR_NO_EXCEPTIONS prints the message
+     * and aborts.
+     */
+    [[noreturn]] void raise(error_code code, const std::string &detail = std::string());
+
+    [[noreturn]] void raise(const std::string &message);
+}
@@ -0,0 +1,50 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace cbor {
+
+    /**
+     * Multiplicative hash of a byte range, eight bytes per step, for the
+     * lookup tables of map_index and key_table. The high bits are the well
+     * mixed ones, take slots from them.
+     */
+    inline uint64_t hash_bytes(const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *) data;
+        const uint64_t m = 0x9E3779B97F4A7C15ULL;
+        uint64_t h = size * m;
+
+        while (size >= 8)
+        {
+            uint64_t chunk;
+            memcpy(&chunk, bytes, 8);
+            h = (h ^ chunk) * m;
+            h ^= h >> 29;
+            bytes += 8;
+            size -= 8;
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, bytes, size);
+        h = (h ^ tail) * m;
+        h ^= h >> 32;
+
+        return h;
+    }
+}
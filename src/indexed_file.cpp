@@ -0,0 +1,305 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "indexed_file.h"
+#include "byte_order.h"
+#include "crc32c.h"
+#include "decoder.h"
+#include "error.h"
+#include "input.h"
+
+#include <limits.h>
+#include <string.h>
+
+namespace cbor {
+
+const unsigned indexed_writer::default_fence_interval;
+
+static const char trailer_magic[8] = {'C', 'B', 'O', 'R', 'I', 'D', 'X', '1'};
+static const uint32_t format_version = 1;
+
+/// encoded value of a top level field of a map, nullptr if the item is not a map or lacks it
+static const unsigned char *field_value(const unsigned char *data, size_t size, const map_index::key &field,
+                                        size_t &value_size)
+{
+    input in(data, size);
+    decoder dec(in);
+    auto entries = dec.try_read_map();
+    if (not entries)
+        return nullptr;
+
+    // keys compared by their encoded bytes, as map_index does
+    for (size_t i = 0; i < entries.value(); ++i)
+    {
+        const size_t key = dec.offset();
+        if (dec.try_skip() != error_code::ok)
+            return nullptr;
+        const bool match = dec.offset() - key == field.size() and memcmp(data + key, field.data(), field.size()) == 0;
+
+        const size_t value = dec.offset();
+        if (dec.try_skip() != error_code::ok)
+            return nullptr;
+        if (match)
+        {
+            value_size = dec.offset() - value;
+            return data + value;
+        }
+    }
+    return nullptr;
+}
+
+static int compare_keys(const unsigned char *a, size_t a_size, const unsigned char *b, size_t b_size)
+{
+    const int order = memcmp(a, b, a_size < b_size ? a_size : b_size);
+    if (order != 0)
+        return order;
+    return a_size < b_size ? -1 : a_size > b_size ? 1 : 0;
+}
+
+indexed_writer::indexed_writer(output &out, uint64_t base)
+        : _out(&out), _fieldKey(std::string()), _interval(default_fence_interval), _written(base), _finished(false)
+{
+}
+
+indexed_writer::indexed_writer(output &out, const std::string &key_field, unsigned fence_interval, uint64_t base)
+        : _out(&out), _field(key_field), _fieldKey(key_field), _interval(fence_interval), _written(base),
+          _finished(false)
+{
+    if (key_field.empty())
+        raise("empty key field");
+    if (fence_interval == 0)
+        raise("fence interval must not be 0");
+}
+
+void indexed_writer::put(const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    while (size != 0)
+    {
+        const size_t part = size < INT_MAX ? size : INT_MAX;
+        _out->put_bytes(bytes, (int) part);
+        bytes += part;
+        size -= part;
+        _written += part;
+    }
+}
+
+void indexed_writer::put_u64(uint64_t value)
+{
+    unsigned char bytes[8];
+    store_be64(bytes, value);
+    put(bytes, sizeof(bytes));
+}
+
+void indexed_writer::append(const void *data, size_t size)
+{
+    if (_finished)
+        raise("append after finish");
+
+    const unsigned char *bytes = (const unsigned char *) data;
+    const std::string where = "in record " + std::to_string(_offsets.size());
+
+    input in(bytes, size);
+    decoder dec(in);
+    const error_code error = dec.try_skip();
+    if (error != error_code::ok)
+        raise(error, where);
+    if (dec.offset() != size)
+        raise("more than one item " + where);
+
+    if (not _field.empty())
+    {
+        size_t key_size;
+        const unsigned char *key = field_value(bytes, size, _fieldKey, key_size);
+        if (key == nullptr)
+            raise("no key field " + _field + " " + where);
+        if (compare_keys(key, key_size, (const unsigned char *) _lastKey.data(), _lastKey.size()) < 0)
+            raise("key out of order " + where);
+        _lastKey.assign((const char *) key, key_size);
+
+        if (_offsets.size() % _interval == 0)
+        {
+            _fences.push_back(_fenceKeys.size());
+            _fenceKeys.append((const char *) key, key_size);
+        }
+    }
+
+    _offsets.push_back(_written);
+    put(bytes, size);
+}
+
+void indexed_writer::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+
+    const uint64_t offsets = _written;
+    for (uint64_t offset : _offsets)
+        put_u64(offset);
+
+    const uint64_t fences = _written;
+    const uint64_t keys = fences + (_fences.empty() ? 0 : (_fences.size() + 1) * 8);
+    if (not _fences.empty())
+    {
+        for (uint64_t start : _fences)
+            put_u64(keys + start);
+        put_u64(keys + _fenceKeys.size());
+    }
+    put(_fenceKeys.data(), _fenceKeys.size());
+
+    const uint64_t field = _written;
+    put(_field.data(), _field.size());
+
+    unsigned char trailer[indexed_trailer_size];
+    memcpy(trailer, trailer_magic, sizeof(trailer_magic));
+    store_be32(trailer + 8, format_version);
+    store_be32(trailer + 12, _interval);
+    store_be64(trailer + 16, _offsets.size());
+    store_be64(trailer + 24, offsets);
+    store_be64(trailer + 32, fences);
+    store_be64(trailer + 40, keys);
+    store_be64(trailer + 48, field);
+    store_be32(trailer + 56, (uint32_t) _field.size());
+    store_be32(trailer + 60, crc32c(trailer, 60));
+    put(trailer, sizeof(trailer));
+}
+
+indexed_reader::indexed_reader(const unsigned char *data, size_t size)
+        : _data(data), _size(size)
+{
+    if (size < indexed_trailer_size)
+        raise("no index trailer");
+
+    const unsigned char *trailer = data + size - indexed_trailer_size;
+    if (memcmp(trailer, trailer_magic, sizeof(trailer_magic)) != 0)
+        raise("no index trailer");
+    if (load_be32(trailer + 60) != crc32c(trailer, 60))
+        raise("index trailer checksum mismatch");
+    if (load_be32(trailer + 8) != format_version)
+        raise("unsupported index version " + std::to_string(load_be32(trailer + 8)));
+
+    _interval = load_be32(trailer + 12);
+    _count = load_be64(trailer + 16);
+    _recordsEnd = load_be64(trailer + 24);
+    _fences = load_be64(trailer + 32);
+    _keys = load_be64(trailer + 40);
+    _field = load_be64(trailer + 48);
+    const uint32_t field_size = load_be32(trailer + 56);
+
+    // each region ends where the next begins
+    const uint64_t end = size - indexed_trailer_size;
+    const bool keyed = field_size != 0;
+    _fenceCount = keyed and _interval != 0 ? (_count + _interval - 1) / _interval : 0;
+    if (_recordsEnd > end or _count > (end - _recordsEnd) / 8 or _recordsEnd + _count * 8 != _fences or
+        _fences > _keys or _keys > _field or _field > end or end - _field != field_size or
+        (keyed and (_interval == 0 or _fences + (_fenceCount == 0 ? 0 : (_fenceCount + 1) * 8) != _keys)) or
+        (not keyed and _fences != _keys))
+        raise("inconsistent index trailer");
+
+    _fieldName.assign((const char *) data + _field, field_size);
+}
+
+indexed_reader::indexed_reader(const mapped_file &file)
+        : indexed_reader(file.data(), file.size())
+{
+}
+
+uint64_t indexed_reader::offset(uint64_t index) const
+{
+    return index < _count ? load_be64(_data + _recordsEnd + index * 8) : _recordsEnd;
+}
+
+const unsigned char *indexed_reader::record(size_t index, size_t &size) const
+{
+    if (index >= _count)
+        raise("record " + std::to_string(index) + " out of range");
+
+    const uint64_t start = offset(index), end = offset(index + 1);
+    if (start > end or end > _recordsEnd)
+        raise("corrupt offset of record " + std::to_string(index));
+
+    size = (size_t) (end - start);
+    return _data + start;
+}
+
+const unsigned char *indexed_reader::record_key(size_t index, const map_index::key &field, size_t &size) const
+{
+    size_t record_size;
+    const unsigned char *data = record(index, record_size);
+    const unsigned char *key = field_value(data, record_size, field, size);
+    if (key == nullptr)
+        raise("no key field in record " + std::to_string(index));
+    return key;
+}
+
+const unsigned char *indexed_reader::fence_key(uint64_t fence, size_t &size) const
+{
+    const uint64_t start = load_be64(_data + _fences + fence * 8);
+    const uint64_t end = load_be64(_data + _fences + fence * 8 + 8);
+    if (start < _keys or start > end or end > _field)
+        raise("corrupt fence key " + std::to_string(fence));
+
+    size = (size_t) (end - start);
+    return _data + start;
+}
+
+size_t indexed_reader::lower_bound(const map_index::key &key) const
+{
+    if (not keyed())
+        raise("records have no key");
+
+    // the last fence below the key, the answer is at most one fence interval after it
+    uint64_t low = 0, high = _fenceCount;
+    while (low < high)
+    {
+        const uint64_t middle = low + (high - low) / 2;
+        size_t size;
+        const unsigned char *fence = fence_key(middle, size);
+        if (compare_keys(fence, size, key.data(), key.size()) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    const map_index::key field(_fieldName);
+    uint64_t first = low == 0 ? 0 : (low - 1) * _interval;
+    uint64_t last = first + _interval < _count ? first + _interval : _count;
+
+    // records are sorted too, so only their keys on the way are decoded
+    while (first < last)
+    {
+        const uint64_t middle = first + (last - first) / 2;
+        size_t size;
+        const unsigned char *record = record_key((size_t) middle, field, size);
+        if (compare_keys(record, size, key.data(), key.size()) < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return (size_t) first;
+}
+
+size_t indexed_reader::find(const map_index::key &key) const
+{
+    const size_t index = lower_bound(key);
+    if (index == size())
+        return index;
+
+    size_t size;
+    const unsigned char *record = record_key(index, map_index::key(_fieldName), size);
+    return compare_keys(record, size, key.data(), key.size()) == 0 ? index : this->size();
+}
+
+}
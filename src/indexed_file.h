@@ -0,0 +1,142 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "output.h"
+#include "map_index.h"
+#include "mapped_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    /*
+     * Indexed record container: the records, one CBOR item each, then
+     *
+     *   offsets   u64 per record, where it starts in the file
+     *   fences    u64 per fence plus one, where its key starts in the file
+     *   keys      the encoded key of every fence_interval-th record
+     *   field     name of the key field, UTF-8
+     *   trailer   64 bytes: "CBORIDX1", version u32, fence_interval u32,
+     *             records u64, offsets u64, fences u64, keys u64, field u64,
+     *             field length u32, CRC-32C of the trailer so far u32
+     *
+     * all integers big endian. Without a key field there are no fences.
+     */
+    static const size_t indexed_trailer_size = 64;
+
+    /**
+     * Writes an indexed container in one pass: records go to the output as
+     * they are appended, the index is kept in memory (8 bytes per record)
+     * and written by finish().
+     *
+     * With a key field every record must be a map holding that field, and
+     * records must come in the order of their encoded keys compared as
+     * bytes, which is the deterministic order of RFC 8949 section 4.2.1:
+     * unsigned integers ascending, shorter strings before longer ones.
+     */
+    class indexed_writer {
+    private:
+        output *_out;
+        std::string _field;
+        map_index::key _fieldKey;
+        unsigned _interval;
+        uint64_t _written;      //< file offset of the next byte, from base on
+        std::vector<uint64_t> _offsets;
+        std::vector<uint64_t> _fences;  //< start of each fence key in _fenceKeys
+        std::string _fenceKeys;
+        std::string _lastKey;
+        bool _finished;
+
+        void put(const void *data, size_t size);
+
+        void put_u64(uint64_t value);
+
+    public:
+        static const unsigned default_fence_interval = 64;
+
+        /**
+         * Records without key, found by index only. Offsets count from the
+         * start of the file, so base is where out starts in it, e.g. the
+         * size of a file opened for appending.
+         */
+        explicit indexed_writer(output &out, uint64_t base = 0);
+
+        /// records keyed by a top level field, one fence key per fence_interval records
+        indexed_writer(output &out, const std::string &key_field, unsigned fence_interval = default_fence_interval,
+                       uint64_t base = 0);
+
+        indexed_writer(const indexed_writer &) = delete;
+
+        /// one complete CBOR item; raises if it is not, or on a missing or out of order key
+        void append(const void *data, size_t size);
+
+        /// writes the index and trailer, nothing can be appended afterwards
+        void finish();
+
+        size_t size() const { return _offsets.size(); }
+    };
+
+    /**
+     * Random access to an indexed container in memory, usually a
+     * mapped_file. Opening reads only the trailer; record() looks up one
+     * offset, find() binary searches the fence keys and then the records
+     * between two fences, decoding the key field of log2(fence_interval)
+     * records. Records are returned in
+     * place, ready for an input and a decoder.
+     */
+    class indexed_reader {
+    private:
+        const unsigned char *_data;
+        size_t _size;
+        uint64_t _count;
+        uint64_t _recordsEnd;
+        uint64_t _fences;
+        uint64_t _fenceCount;
+        uint64_t _keys;
+        uint64_t _field;
+        unsigned _interval;
+        std::string _fieldName;
+
+        uint64_t offset(uint64_t index) const;
+
+        /// encoded key of a record, raises if it has none
+        const unsigned char *record_key(size_t index, const map_index::key &field, size_t &size) const;
+
+        const unsigned char *fence_key(uint64_t fence, size_t &size) const;
+
+    public:
+        /// raises if the trailer is missing or inconsistent
+        indexed_reader(const unsigned char *data, size_t size);
+
+        explicit indexed_reader(const mapped_file &file);
+
+        size_t size() const { return (size_t) _count; }
+
+        bool keyed() const { return not _fieldName.empty(); }
+
+        const std::string &key_field() const { return _fieldName; }
+
+        const unsigned char *record(size_t index, size_t &size) const;
+
+        /// first record whose key is not less than key, size() if there is none
+        size_t lower_bound(const map_index::key &key) const;
+
+        /// a record with this key, size() if there is none
+        size_t find(const map_index::key &key) const;
+    };
+}
@@ -15,7 +15,9 @@
 */
 
 #include "input.h"
+#include "byte_order.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -24,14 +26,14 @@ using std::cout;
 
 namespace cbor {
 
-input::input(void *data, int size)
+input::input(void *data, size_t size)
 {
     _data = (unsigned char *) data;
     _size = size;
     _offset = 0;
 }
 
-input::input(const void *data, int size) {
+input::input(const void *data, size_t size) {
     _data = (unsigned char *) data;
     _size = size;
     _offset = 0;
@@ -41,11 +43,11 @@ input::~input() {
 
 }
 
-bool input::has_bytes(int count) {
+bool input::has_bytes(size_t count) {
     return _size - _offset >= count;
 }
 
-void input::advance(int bytes)
+void input::advance(size_t bytes)
 {
     //cout << "advance: " << bytes << "\n";
     _offset += bytes;
@@ -56,58 +58,59 @@ unsigned char input::get_byte() {
 }
 
 unsigned short input::get_short() {
-    unsigned short value = ((unsigned short) _data[_offset] << 8) | ((unsigned short) _data[_offset + 1]);
+    unsigned short value = load_be16(_data + _offset);
     _offset += 2;
     return value;
 }
 
 unsigned int input::get_int() {
-    unsigned int value = \
-            ((unsigned int) _data[_offset] << 24) |
-            ((unsigned int) _data[_offset + 1] << 16) |
-            ((unsigned int) _data[_offset + 2] << 8) |
-            ((unsigned int) _data[_offset + 3]);
+    unsigned int value = load_be32(_data + _offset);
     _offset += 4;
     return value;
 }
 
 
 unsigned long long input::get_long() {
-    unsigned long long value = ((unsigned long long) _data[_offset] << 56) |
-                               ((unsigned long long) _data[_offset + 1] << 48) |
-                               ((unsigned long long) _data[_offset + 2] << 40) |
-                               ((unsigned long long) _data[_offset + 3] << 32) |
-                               ((unsigned long long) _data[_offset + 4] << 24) |
-                               ((unsigned long long) _data[_offset + 5] << 16) |
-                               ((unsigned long long) _data[_offset + 6] << 8) |
-                               ((unsigned long long) _data[_offset + 7]);
+    unsigned long long value = load_be64(_data + _offset);
     _offset += 8;
     return value;
 }
 
-float input::get_float() {
-    union {
-        uint32_t uint32_val;
-        float float_val;
-    } u;
+double half_to_double(uint16_t half)
+{
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+
+    double value;
+    if (exponent == 0)
+        value = ldexp(mantissa, -24);
+    else if (exponent != 31)
+        value = ldexp(mantissa + 1024, exponent - 25);
+    else
+        value = mantissa == 0 ? INFINITY : NAN;
+
+    return half & 0x8000 ? -value : value;
+}
 
-    u.uint32_val = get_int();
-    //return *(float*)&t;
-    return u.float_val;
+float input::get_half() {
+    return (float) half_to_double(get_short());
 }
 
-double input::get_double() {
-    union {
-        uint64_t uint64_val;
-        double double_val;
-    } u;
+float input::get_float() {
+    uint32_t bits = get_int();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
 
-    u.uint64_val = get_long();
-    //return *(double*)&t;
-    return u.double_val;
+double input::get_double() {
+    uint64_t bits = get_long();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
 }
 
-void input::get_bytes(void *to, int count) {
+void input::get_bytes(void *to, size_t count) {
     memcpy(to, _data + _offset, count);
     _offset += count;
 }
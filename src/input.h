@@ -17,25 +17,37 @@
 
 #include "buffer.h"
 
+#include <stdint.h>
+
 namespace cbor {
+    /// widens an IEEE 754 half precision value
+    double half_to_double(uint16_t half);
+
     class input: public buffer {
     private:
         unsigned char *_data;
-        int _size;
-        int _offset;
+        size_t _size;
+        size_t _offset;
     public:
-        input(const void *data, int size);
-        input(void *data, int size);
+        input(const void *data, size_t size);
+        input(void *data, size_t size);
 
         ~input();
 
-        int offset() const { return _offset; }
+        size_t offset() const { return _offset; }
+
+        const unsigned char *current() const { return _data + _offset; }
 
-        void advance(int bytes);
+        void advance(size_t bytes);
+
+        /// moves back to an offset returned by offset()
+        void rewind(size_t offset) { _offset = offset; }
 
         uint8_t peek_byte() const;
 
-        bool has_bytes(int count);
+        bool has_bytes(size_t count);
+
+        size_t remaining() const { return _size - _offset; }
 
         std::string toString() const;
 
@@ -44,10 +56,13 @@ namespace cbor {
         unsigned int get_int();
         unsigned long long get_long();
 
+        /// IEEE 754 binary16, exact in a float
+        float get_half();
+
         float get_float();
 
         double get_double();
 
-        void get_bytes(void *to, int count);
+        void get_bytes(void *to, size_t count);
     };
 }
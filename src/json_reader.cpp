@@ -0,0 +1,557 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "json_reader.h"
+#include "listener_json.h"
+
+#include <float.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#include <string>
+
+namespace cbor {
+
+// powers of ten that are exact in a double
+static const double exact_powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// strtod() in the C locale, JSON always has a decimal point whatever the process locale says
+static double parse_double(const char *text)
+{
+#ifdef _WIN32
+    static const _locale_t c_locale = _create_locale(LC_NUMERIC, "C");
+    return _strtod_l(text, nullptr, c_locale);
+#else
+    static const locale_t c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+    return strtod_l(text, nullptr, c_locale);
+#endif
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' and c <= '9';
+}
+
+/// numbers and literals must not run into the next token
+static bool at_token_end(const char *p, const char *end)
+{
+    return p == end or *p == ',' or *p == ']' or *p == '}' or *p == ' ' or *p == '\n' or *p == '\r' or *p == '\t';
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' and c <= '9')
+        return c - '0';
+    if (c >= 'a' and c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' and c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/// the four hex digits of a \u escape, -1 if invalid
+static int32_t read_hex4(const char *p)
+{
+    int32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const int digit = hex_value(p[i]);
+        if (digit < 0)
+            return -1;
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+static void append_utf8(pmr_string &text, uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        text.push_back((char) code_point);
+    } else if (code_point < 0x800)
+    {
+        text.push_back((char) (0xc0 | code_point >> 6));
+        text.push_back((char) (0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000)
+    {
+        text.push_back((char) (0xe0 | code_point >> 12));
+        text.push_back((char) (0x80 | (code_point >> 6 & 0x3f)));
+        text.push_back((char) (0x80 | (code_point & 0x3f)));
+    } else
+    {
+        text.push_back((char) (0xf0 | code_point >> 18));
+        text.push_back((char) (0x80 | (code_point >> 12 & 0x3f)));
+        text.push_back((char) (0x80 | (code_point >> 6 & 0x3f)));
+        text.push_back((char) (0x80 | (code_point & 0x3f)));
+    }
+}
+
+/// float when that holds the value exactly
+static void write_shortest(encoder &enc, double value)
+{
+    if (fabs(value) <= FLT_MAX and (double) (float) value == value)
+        enc.write_float((float) value);
+    else
+        enc.write_double(value);
+}
+
+json_reader::json_reader(memory_resource *resource)
+        : _sizes(resource), _open(resource), _frames(resource), _scratch(resource), _errorOffset(0),
+          _begin(nullptr), _end(nullptr), _p(nullptr)
+{
+}
+
+error_code json_reader::count_members()
+{
+    _sizes.clear();
+    _open.clear();
+
+    // a container was just opened, the next value is its first member
+    bool first = false;
+
+    for (const char *p = _begin; p < _end; ++p)
+    {
+        const char c = *p;
+        if (c == ' ' or c == '\n' or c == '\r' or c == '\t' or c == ':')
+            continue;
+
+        if (c == ']' or c == '}')
+        {
+            if (_open.empty())
+                return fail(error_code::invalid_json, p);
+            _open.pop_back();
+            first = false;
+            continue;
+        }
+
+        if (c == ',')
+        {
+            if (not _open.empty())
+                _sizes[_open.back()]++;
+            continue;
+        }
+
+        if (first)
+        {
+            _sizes[_open.back()]++;
+            first = false;
+        }
+
+        if (c == '[' or c == '{')
+        {
+            _open.push_back(_sizes.size());
+            _sizes.push_back(0);
+            first = true;
+        } else if (c == '"')
+        {
+            for (++p;; ++p)
+            {
+                p += json_plain_prefix(p, _end - p);
+                if (p == _end)
+                    return fail(error_code::truncated, p);
+                if (*p == '"')
+                    break;
+                if (*p == '\\' and ++p == _end)
+                    return fail(error_code::truncated, p);
+            }
+        }
+    }
+
+    if (not _open.empty())
+        return fail(error_code::truncated, _end);
+    return error_code::ok;
+}
+
+error_code json_reader::read_string(encoder &enc)
+{
+    const char *start = ++_p;
+    const char *p = start + json_plain_prefix(start, _end - start);
+
+    // the common case: no escapes, copy straight from the text
+    if (p < _end and *p == '"')
+    {
+        // the encoder takes unsigned int lengths
+        if ((size_t) (p - start) > UINT_MAX)
+            return fail(error_code::size_limit, start - 1);
+        enc.write_string(start, (unsigned int) (p - start));
+        _p = p + 1;
+        return error_code::ok;
+    }
+
+    _scratch.assign(start, p - start);
+    for (;;)
+    {
+        if (p == _end)
+            return fail(error_code::truncated, p);
+
+        const unsigned char c = (unsigned char) *p;
+        if (c == '"')
+            break;
+        if (c < 0x20)
+            return fail(error_code::invalid_json, p);
+
+        const char *escape = p++;
+        if (p == _end)
+            return fail(error_code::truncated, p);
+
+        switch (*p++)
+        {
+            case '"': _scratch.push_back('"'); break;
+            case '\\': _scratch.push_back('\\'); break;
+            case '/': _scratch.push_back('/'); break;
+            case 'b': _scratch.push_back('\b'); break;
+            case 'f': _scratch.push_back('\f'); break;
+            case 'n': _scratch.push_back('\n'); break;
+            case 'r': _scratch.push_back('\r'); break;
+            case 't': _scratch.push_back('\t'); break;
+            case 'u': {
+                if (_end - p < 4)
+                    return fail(error_code::truncated, _end);
+                int32_t code_point = read_hex4(p);
+                if (code_point < 0)
+                    return fail(error_code::invalid_json, escape);
+                p += 4;
+
+                if (code_point >= 0xd800 and code_point < 0xdc00)
+                {
+                    // high surrogate, the low one must follow
+                    if (p < _end and *p != '\\')
+                        return fail(error_code::invalid_json, escape);
+                    if (_end - p < 6)
+                        return fail(error_code::truncated, _end);
+                    const int32_t low = p[0] == '\\' and p[1] == 'u' ? read_hex4(p + 2) : -1;
+                    if (low < 0xdc00 or low >= 0xe000)
+                        return fail(error_code::invalid_json, escape);
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                } else if (code_point >= 0xdc00 and code_point < 0xe000)
+                {
+                    return fail(error_code::invalid_json, escape);
+                }
+
+                append_utf8(_scratch, (uint32_t) code_point);
+                break;
+            }
+            default:
+                return fail(error_code::invalid_json, escape);
+        }
+
+        const size_t plain = json_plain_prefix(p, _end - p);
+        _scratch.append(p, plain);
+        p += plain;
+    }
+
+    if (_scratch.size() > UINT_MAX)
+        return fail(error_code::size_limit, start - 1);
+    enc.write_string(_scratch.data(), (unsigned int) _scratch.size());
+    _p = p + 1;
+    return error_code::ok;
+}
+
+error_code json_reader::read_number(encoder &enc)
+{
+    const char *start = _p;
+    const char *p = _p;
+
+    const bool negative = *p == '-';
+    if (negative and ++p == _end)
+        return fail(error_code::truncated, p);
+    if (not is_digit(*p))
+        return fail(error_code::invalid_json, p);
+
+    // value = mantissa * 10^exponent, unless digits did not fit into the mantissa
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool exact = true;
+    bool integer = true;
+
+    const char *digits = p;
+    if (*p == '0')
+    {
+        ++p;
+    } else
+    {
+        for (; p < _end and is_digit(*p); ++p)
+        {
+            const unsigned digit = *p - '0';
+            if (mantissa < UINT64_MAX / 10 or (mantissa == UINT64_MAX / 10 and digit <= UINT64_MAX % 10))
+            {
+                mantissa = mantissa * 10 + digit;
+            } else
+            {
+                exact = false;
+                exponent++;
+            }
+        }
+    }
+
+    // the one integer whose magnitude does not fit, CBOR still has it as a plain negative integer
+    const bool negative_limit = negative and p - digits == 20 and memcmp(digits, "18446744073709551616", 20) == 0;
+
+    if (p < _end and *p == '.')
+    {
+        integer = false;
+        if (++p == _end)
+            return fail(error_code::truncated, p);
+        if (not is_digit(*p))
+            return fail(error_code::invalid_json, p);
+
+        for (; p < _end and is_digit(*p); ++p)
+        {
+            const unsigned digit = *p - '0';
+            if (mantissa < UINT64_MAX / 10)
+            {
+                mantissa = mantissa * 10 + digit;
+                exponent--;
+            } else if (digit != 0)
+            {
+                exact = false;
+            }
+        }
+    }
+
+    if (p < _end and (*p == 'e' or *p == 'E'))
+    {
+        integer = false;
+        if (++p == _end)
+            return fail(error_code::truncated, p);
+
+        const bool negative_exponent = *p == '-';
+        if ((*p == '-' or *p == '+') and ++p == _end)
+            return fail(error_code::truncated, p);
+        if (not is_digit(*p))
+            return fail(error_code::invalid_json, p);
+
+        int value = 0;
+        for (; p < _end and is_digit(*p); ++p)
+        {
+            if (value < 100000)
+                value = value * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -value : value;
+    }
+
+    if (not at_token_end(p, _end))
+        return fail(error_code::invalid_json, p);
+    _p = p;
+
+    if (integer and (exact or negative_limit))
+    {
+        if (not negative)
+            enc.write_int((unsigned long long) mantissa);
+        else if (negative_limit)
+            enc.write_negative(UINT64_MAX);
+        else if (mantissa <= (uint64_t) LLONG_MAX)
+            enc.write_int(-(long long) mantissa);
+        else
+            enc.write_negative(mantissa - 1);
+        return error_code::ok;
+    }
+
+    double value;
+    if (exact and mantissa <= (1ULL << 53) and exponent >= -22 and exponent <= 22)
+    {
+        // both operands exact, so the one rounding is correct
+        value = exponent < 0 ? (double) mantissa / exact_powers[-exponent] : (double) mantissa * exact_powers[exponent];
+        if (negative)
+            value = -value;
+    } else
+    {
+        const size_t length = p - start;
+        char text[64];
+        if (length < sizeof(text))
+        {
+            memcpy(text, start, length);
+            text[length] = 0;
+            value = parse_double(text);
+        } else
+        {
+            _scratch.assign(start, length);
+            value = parse_double(_scratch.c_str());
+        }
+    }
+
+    write_shortest(enc, value);
+    return error_code::ok;
+}
+
+error_code json_reader::read_literal(const char *literal, size_t size)
+{
+    const size_t available = _end - _p;
+    if (available < size)
+    {
+        const bool prefix = memcmp(_p, literal, available) == 0;
+        return fail(prefix ? error_code::truncated : error_code::invalid_json, _p);
+    }
+    if (memcmp(_p, literal, size) != 0)
+        return fail(error_code::invalid_json, _p);
+
+    _p += size;
+    if (not at_token_end(_p, _end))
+        return fail(error_code::invalid_json, _p);
+    return error_code::ok;
+}
+
+error_code json_reader::try_convert(const char *text, size_t size, encoder &enc)
+{
+    _begin = text;
+    _end = text + size;
+    _p = text;
+    _errorOffset = 0;
+    _frames.clear();
+
+    error_code error = count_members();
+    if (error != error_code::ok)
+        return error;
+
+    skip_space();
+    if (_p == _end)
+        return fail(error_code::truncated, _p);
+
+    enum { want_value, want_key, after_value } state = want_value;
+    size_t next = 0; // next entry of _sizes
+
+    for (;;)
+    {
+        skip_space();
+
+        if (state == after_value)
+        {
+            if (_frames.empty())
+            {
+                // top level: end of text or the next value of a sequence
+                if (_p == _end)
+                    return error_code::ok;
+                state = want_value;
+                continue;
+            }
+
+            if (_p == _end)
+                return fail(error_code::truncated, _p);
+
+            frame &top = _frames.back();
+            const char c = *_p++;
+            if (c == ',')
+            {
+                state = top.object ? want_key : want_value;
+            } else if (c == (top.object ? '}' : ']'))
+            {
+                if (top.done != top.size)
+                    return fail(error_code::invalid_json, _p - 1);
+                _frames.pop_back();
+            } else
+            {
+                return fail(error_code::invalid_json, _p - 1);
+            }
+            continue;
+        }
+
+        if (_p == _end)
+            return fail(error_code::truncated, _p);
+
+        if (state == want_key)
+        {
+            _frames.back().done++;
+            if (*_p != '"')
+                return fail(error_code::invalid_json, _p);
+            error = read_string(enc);
+            if (error != error_code::ok)
+                return error;
+
+            skip_space();
+            if (_p == _end)
+                return fail(error_code::truncated, _p);
+            if (*_p++ != ':')
+                return fail(error_code::invalid_json, _p - 1);
+            state = want_value;
+            continue;
+        }
+
+        if (not _frames.empty() and not _frames.back().object)
+            _frames.back().done++;
+
+        state = after_value;
+        switch (*_p)
+        {
+            case '[':
+            case '{': {
+                frame f;
+                f.size = _sizes[next++];
+                f.done = 0;
+                f.object = *_p == '{';
+                if (f.object)
+                    enc.write_map(f.size);
+                else
+                    enc.write_array(f.size);
+
+                ++_p;
+                if (f.size != 0)
+                {
+                    _frames.push_back(f);
+                    state = f.object ? want_key : want_value;
+                    break;
+                }
+
+                skip_space();
+                if (_p == _end)
+                    return fail(error_code::truncated, _p);
+                if (*_p++ != (f.object ? '}' : ']'))
+                    return fail(error_code::invalid_json, _p - 1);
+                break;
+            }
+            case '"':
+                error = read_string(enc);
+                break;
+            case 't':
+                error = read_literal("true", 4);
+                if (error == error_code::ok)
+                    enc.write_bool(true);
+                break;
+            case 'f':
+                error = read_literal("false", 5);
+                if (error == error_code::ok)
+                    enc.write_bool(false);
+                break;
+            case 'n':
+                error = read_literal("null", 4);
+                if (error == error_code::ok)
+                    enc.write_null();
+                break;
+            default:
+                error = read_number(enc);
+                break;
+        }
+
+        if (error != error_code::ok)
+            return error;
+    }
+}
+
+void json_reader::convert(const char *text, size_t size, encoder &enc)
+{
+    const error_code error = try_convert(text, size, enc);
+    if (error != error_code::ok)
+        raise(error, "at offset " + std::to_string(_errorOffset));
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "encoder.h"
+#include "error.h"
+#include "memory_resource.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cbor {
+
+    /**
+     * Streaming JSON to CBOR transcoder writing into an encoder, the
+     * counterpart of listener_json. Whitespace separated values become a
+     * CBOR sequence.
+     *
+     * The readers in this library need definite lengths, so a first pass
+     * over the structure counts the members of every array and object and
+     * a second pass parses and encodes. Strings without escapes are copied
+     * straight from the text, integers from -2^64 to 2^64-1 become CBOR
+     * integers and other numbers the smallest float that holds them
+     * exactly; the process locale does not matter. After the first call
+     * nothing is allocated unless the text nests deeper or has more
+     * containers or longer escaped strings than before.
+     */
+    class json_reader {
+    private:
+        struct frame
+        {
+            uint64_t size;      //< members counted by the first pass
+            uint64_t done;
+            bool object;
+        };
+
+        pmr_vector<uint64_t> _sizes;    //< member count of each container, in order of opening
+        pmr_vector<size_t> _open;       //< first pass: indexes into _sizes of the open containers
+        pmr_vector<frame> _frames;
+        pmr_string _scratch;            //< unescaped string
+        size_t _errorOffset;
+
+        const char *_begin;
+        const char *_end;
+        const char *_p;
+
+        error_code count_members();
+
+        void skip_space()
+        {
+            while (_p < _end and (*_p == ' ' or *_p == '\n' or *_p == '\r' or *_p == '\t'))
+                ++_p;
+        }
+
+        error_code fail(error_code code, const char *at)
+        {
+            _errorOffset = at - _begin;
+            return code;
+        }
+
+        error_code read_string(encoder &enc);
+
+        error_code read_number(encoder &enc);
+
+        error_code read_literal(const char *literal, size_t size);
+
+    public:
+        explicit json_reader(memory_resource *resource = get_default_resource());
+
+        /// invalid_json or truncated on malformed text, size_limit on strings of 4 GiB or more, see error_offset()
+        error_code try_convert(const char *text, size_t size, encoder &enc);
+
+        /// throwing version of try_convert()
+        void convert(const char *text, size_t size, encoder &enc);
+
+        /// where the last conversion failed
+        size_t error_offset() const { return _errorOffset; }
+    };
+}
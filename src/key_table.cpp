@@ -0,0 +1,132 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "key_table.h"
+#include "error.h"
+#include "hash.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace cbor {
+
+const int key_table::npos;
+
+uint64_t key_table::hash(const char *text, size_t size)
+{
+    return hash_bytes(text, size);
+}
+
+size_t key_table::slot_of(uint64_t hash, uint16_t seed, size_t slots)
+{
+    uint64_t x = hash ^ ((seed + 1) * 0xff51afd7ed558ccdULL);
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (size_t) (((x >> 32) * slots) >> 32);
+}
+
+key_table::key_table(const std::vector<std::string> &keys) : _keys(keys)
+{
+    std::unordered_set<std::string> unique(keys.begin(), keys.end());
+    if (unique.size() != keys.size())
+        raise("duplicate key in key_table");
+
+    const size_t count = keys.size();
+    std::vector<uint64_t> hashes(count);
+    for (size_t i = 0; i < count; ++i)
+        hashes[i] = hash(keys[i].data(), keys[i].size());
+
+    // about two keys per bucket; the slot count only grows if no seed
+    // works for some bucket, which takes equal hashes or bad luck
+    _seeds.assign(count / 2 + 1, 0);
+    size_t slots = 1;
+    while (slots < count)
+        slots *= 2;
+
+    std::vector<std::vector<int32_t>> buckets(_seeds.size());
+    for (size_t i = 0; i < count; ++i)
+        buckets[bucket_of(hashes[i])].push_back((int32_t) i);
+
+    std::vector<size_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    for (;; slots *= 2)
+    {
+        if (slots > 16 * count + 16)
+            raise("can not build a perfect hash for key_table");
+
+        _slots.assign(slots, npos);
+        bool placed = true;
+
+        // big buckets first, while most slots are free
+        for (size_t b : order)
+        {
+            const std::vector<int32_t> &bucket = buckets[b];
+            if (bucket.empty())
+                break;
+
+            placed = false;
+            for (uint32_t seed = 0; seed <= 0xffff and not placed; ++seed)
+            {
+                size_t taken = 0;
+                for (; taken < bucket.size(); ++taken)
+                {
+                    size_t slot = slot_of(hashes[bucket[taken]], (uint16_t) seed, slots);
+                    if (_slots[slot] != npos)
+                        break;
+                    _slots[slot] = bucket[taken];
+                }
+
+                placed = taken == bucket.size();
+                if (not placed)
+                {
+                    // undo the partial placement
+                    while (taken-- > 0)
+                        _slots[slot_of(hashes[bucket[taken]], (uint16_t) seed, slots)] = npos;
+                } else
+                {
+                    _seeds[b] = (uint16_t) seed;
+                }
+            }
+
+            if (not placed)
+                break;
+        }
+
+        if (placed)
+            break;
+    }
+}
+
+int key_table::find(const char *text, size_t size) const
+{
+    const uint64_t h = hash(text, size);
+    const int32_t symbol = _slots[slot_of(h, _seeds[bucket_of(h)], _slots.size())];
+    if (symbol == npos)
+        return npos;
+
+    const std::string &key = _keys[symbol];
+    if (key.size() != size or memcmp(key.data(), text, size) != 0)
+        return npos;
+    return symbol;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    /**
+     * Symbol table for a known vocabulary of text map keys.
+     *
+     * The constructor builds a perfect hash (hash and displace: keys are
+     * grouped into buckets and each bucket gets a seed that places its keys
+     * in free slots), so find() is one hash, one slot and one compare.
+     * Symbols are the positions of the keys in the list passed in.
+     */
+    class key_table {
+    public:
+        static const int npos = -1;
+
+        /// keys must be distinct
+        explicit key_table(const std::vector<std::string> &keys);
+
+        /// symbol of the key or npos
+        int find(const char *text, size_t size) const;
+        int find(const std::string &text) const { return find(text.data(), text.size()); }
+
+        size_t size() const { return _keys.size(); }
+
+        /// key of a symbol, stays valid as long as the table
+        const std::string &name(int symbol) const { return _keys[symbol]; }
+
+        /// bytes used by the hash table
+        size_t memory_usage() const { return _seeds.capacity() * sizeof(uint16_t) + _slots.capacity() * sizeof(int32_t); }
+
+    private:
+        std::vector<std::string> _keys;
+        std::vector<uint16_t> _seeds;   //< per bucket
+        std::vector<int32_t> _slots;    //< symbol or npos
+
+        static uint64_t hash(const char *text, size_t size);
+
+        size_t bucket_of(uint64_t hash) const { return (size_t) (((hash & 0xffffffffULL) * _seeds.size()) >> 32); }
+        static size_t slot_of(uint64_t hash, uint16_t seed, size_t slots);
+    };
+}
@@ -37,9 +37,26 @@ public:
 
     virtual void on_error(const char *error) = 0;
 
+    /// integers outside the int range: value for sign 1, -1 - value for sign -1
     virtual void on_extra_integer(unsigned long long value, int sign) { }
     virtual void on_extra_tag(unsigned long long tag) { }
     virtual void on_extra_special(unsigned long long tag) { }
+
+    /// sizes above INT_MAX
+    virtual void on_extra_array(unsigned long long size) { on_error("extra long array"); }
+    virtual void on_extra_map(unsigned long long size) { on_error("extra long map"); }
+    virtual void on_extra_bytes(unsigned char *data, unsigned long long size) { on_error("extra long bytes"); }
+
+    /**
+     * Pieces of strings over decoder::set_chunk_threshold(), in order. offset
+     * is the position of data within the string, total its full length.
+     * Text chunks may split UTF-8 sequences.
+     */
+    virtual void on_bytes_chunk(const unsigned char *data, size_t size, unsigned long long offset, unsigned long long total) { on_error("unhandled bytes chunk"); }
+    virtual void on_string_chunk(const char *data, size_t size, unsigned long long offset, unsigned long long total) { on_error("unhandled string chunk"); }
+
+    /// map keys found in the decoder's key_table, see decoder::set_key_table()
+    virtual void on_key(int symbol) { on_error("unhandled key symbol"); }
 };
 
 }
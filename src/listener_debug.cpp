@@ -16,6 +16,8 @@
 
 #include "listener_debug.h"
 
+#include <limits.h>
+
 namespace cbor {
 
 void listener_debug::on_integer(int value) {
@@ -23,7 +25,7 @@ void listener_debug::on_integer(int value) {
 }
 
 void listener_debug::on_bytes(unsigned char *data, int size) {
-    printf("bytes with size: %d", size);
+    printf("bytes with size: %d\n", size);
 }
 
 void listener_debug::on_string(std::string &str) {
@@ -80,8 +82,10 @@ void listener_debug::on_error(const char *error) {
 void listener_debug::on_extra_integer(unsigned long long value, int sign) {
     if (sign >= 0) {
         printf("extra integer: %llu\n", value);
+    } else if (value == ULLONG_MAX) {
+        printf("extra integer: -18446744073709551616\n");
     } else {
-        printf("extra integer: -%llu\n", value);
+        printf("extra integer: -%llu\n", value + 1);
     }
 }
 
@@ -93,4 +97,20 @@ void listener_debug::on_extra_special(unsigned long long tag) {
     printf("extra special: %llu\n", tag);
 }
 
+void listener_debug::on_extra_array(unsigned long long size) {
+    printf("array: %llu\n", size);
+}
+
+void listener_debug::on_extra_map(unsigned long long size) {
+    printf("map: %llu\n", size);
+}
+
+void listener_debug::on_extra_bytes(unsigned char *data, unsigned long long size) {
+    printf("bytes with size: %llu\n", size);
+}
+
+void listener_debug::on_key(int symbol) {
+    printf("key symbol: %d\n", symbol);
+}
+
 }
\ No newline at end of file
@@ -55,5 +55,13 @@ namespace cbor {
         virtual void on_extra_tag(unsigned long long tag);
 
         virtual void on_extra_special(unsigned long long tag);
+
+        virtual void on_extra_array(unsigned long long size);
+
+        virtual void on_extra_map(unsigned long long size);
+
+        virtual void on_extra_bytes(unsigned char *data, unsigned long long size);
+
+        virtual void on_key(int symbol);
     };
 }
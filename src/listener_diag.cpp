@@ -0,0 +1,142 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener_diag.h"
+#include "dtoa.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace cbor {
+
+listener_diag::listener_diag(output &out)
+        : listener_text(out, ", ", ": ", "]})")
+{
+}
+
+void listener_diag::begin_container(unsigned long long size, frame_kind kind)
+{
+    if (not begin_item())
+        return;
+
+    if (kind == frame_tag)
+    {
+        char digits[20];
+        put(digits, format_uint(size, digits));
+        put('(');
+        size = 1;
+    } else
+    {
+        put(kind == frame_array ? '[' : '{');
+    }
+    push_frame(size, kind);
+}
+
+void listener_diag::put_hex(const unsigned char *data, size_t size)
+{
+    while (size != 0)
+    {
+        if (_used == buffer_size)
+            flush();
+
+        const size_t count = std::min(size, (buffer_size - _used) / 2);
+        if (count == 0)
+        {
+            flush();
+            continue;
+        }
+        hexlify(data, count, _buffer + _used);
+        _used += count * 2;
+        data += count;
+        size -= count;
+    }
+}
+
+void listener_diag::put_float(double value, int indicator)
+{
+    // the number, then _1, _2 or _3 for the width it was encoded in
+    char text[36];
+    size_t size;
+    if (isnan(value))
+    {
+        memcpy(text, "NaN", 3);
+        size = 3;
+    } else if (isinf(value))
+    {
+        size = value > 0 ? 8 : 9;
+        memcpy(text, value > 0 ? "Infinity" : "-Infinity", size);
+    } else
+    {
+        size = indicator == 3 ? format_double(value, text) : format_float((float) value, text);
+    }
+    text[size++] = '_';
+    text[size++] = (char) ('0' + indicator);
+    scalar(text, size);
+}
+
+void listener_diag::put_bytes(const unsigned char *data, size_t size, bool first, bool last)
+{
+    if (first)
+        put("h'", 2);
+    put_hex(data, size);
+    if (last)
+        put('\'');
+}
+
+void listener_diag::on_tag(unsigned int tag)
+{
+    begin_container(tag, frame_tag);
+}
+
+void listener_diag::on_extra_tag(unsigned long long tag)
+{
+    begin_container(tag, frame_tag);
+}
+
+void listener_diag::on_special(unsigned int code)
+{
+    on_extra_special(code);
+}
+
+void listener_diag::on_extra_special(unsigned long long code)
+{
+    char text[29] = "simple(";
+    size_t size = 7 + format_uint(code, text + 7);
+    text[size++] = ')';
+    scalar(text, size);
+}
+
+void listener_diag::on_undefined()
+{
+    scalar("undefined", 9);
+}
+
+void listener_diag::on_half(float value)
+{
+    put_float(value, 1);
+}
+
+void listener_diag::on_float(float value)
+{
+    put_float(value, 2);
+}
+
+void listener_diag::on_double(double value)
+{
+    put_float(value, 3);
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener_text.h"
+
+namespace cbor {
+
+    /**
+     * Writes decoder events as RFC 8949 diagnostic notation, one line per
+     * top level item: [1, "a", h'00ff'], {"k": 1(1500000000)}, simple(16).
+     * Floats carry the encoding indicator of their width, 1.5_1 for a half,
+     * _2 and _3 for single and double. Text is buffered like in
+     * listener_json: call flush() before reading the output. After an error
+     * nothing more is written.
+     */
+    class listener_diag : public listener_text {
+    private:
+        void begin_container(unsigned long long size, frame_kind kind) override;
+
+        void put_bytes(const unsigned char *data, size_t size, bool first, bool last) override;
+
+        void put_hex(const unsigned char *data, size_t size);
+
+        /// indicator 1, 2 or 3 for half, single or double
+        void put_float(double value, int indicator);
+
+    public:
+        explicit listener_diag(output &out);
+
+        void on_tag(unsigned int tag) override;
+
+        void on_special(unsigned int code) override;
+
+        void on_undefined() override;
+
+        void on_half(float value) override;
+
+        void on_float(float value) override;
+
+        void on_double(double value) override;
+
+        void on_extra_tag(unsigned long long tag) override;
+
+        void on_extra_special(unsigned long long tag) override;
+    };
+}
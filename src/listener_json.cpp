@@ -0,0 +1,198 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener_json.h"
+#include "dtoa.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace cbor {
+
+static const char base64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+listener_json::listener_json(output &out, const json_options &options)
+        : listener_text(out, ",", ":", "]}}"), _options(options), _carried(0)
+{
+}
+
+void listener_json::scalar(const char *text, size_t size)
+{
+    if (not begin_item())
+        return;
+
+    if (_key)
+    {
+        if (not _options.stringify_keys)
+        {
+            fail("map key is not a string");
+            return;
+        }
+        put('"');
+        put(text, size);
+        put('"');
+    } else
+    {
+        put(text, size);
+    }
+    end_item();
+}
+
+void listener_json::begin_container(unsigned long long size, frame_kind kind)
+{
+    if (not begin_item())
+        return;
+
+    if (_key)
+    {
+        fail(kind == frame_tag ? "tagged map key" : "map key is a container");
+        return;
+    }
+
+    if (kind == frame_array)
+    {
+        put('[');
+    } else if (kind == frame_map)
+    {
+        put('{');
+    } else
+    {
+        char digits[20];
+        put("{\"tag\":", 7);
+        put(digits, format_uint(size, digits));
+        put(",\"value\":", 9);
+        size = 1;
+    }
+    push_frame(size, kind);
+}
+
+static void encode_group(const unsigned char *group, char *text)
+{
+    text[0] = base64url[group[0] >> 2];
+    text[1] = base64url[(group[0] & 0x03) << 4 | group[1] >> 4];
+    text[2] = base64url[(group[1] & 0x0f) << 2 | group[2] >> 6];
+    text[3] = base64url[group[2] & 0x3f];
+}
+
+void listener_json::put_base64(const unsigned char *data, size_t size, bool last)
+{
+    char text[4];
+
+    // complete the group left over from the previous chunk
+    if (_carried != 0)
+    {
+        unsigned char group[3] = {0, 0, 0};
+        memcpy(group, _carry, _carried);
+        while (_carried < 3 and size != 0)
+        {
+            group[_carried++] = *data++;
+            size--;
+        }
+
+        if (_carried == 3)
+        {
+            encode_group(group, text);
+            put(text, 4);
+            _carried = 0;
+        } else
+        {
+            _carry[0] = group[0];
+            _carry[1] = group[1];
+        }
+    }
+
+    for (; size >= 3; data += 3, size -= 3)
+    {
+        encode_group(data, text);
+        put(text, 4);
+    }
+
+    while (size != 0)
+    {
+        _carry[_carried++] = *data++;
+        size--;
+    }
+
+    if (not last or _carried == 0)
+        return;
+
+    // unpadded tail
+    const unsigned char group[3] = {_carry[0], (unsigned char) (_carried == 2 ? _carry[1] : 0), 0};
+    encode_group(group, text);
+    put(text, _carried + 1);
+    _carried = 0;
+}
+
+void listener_json::put_bytes(const unsigned char *data, size_t size, bool first, bool last)
+{
+    if (first)
+    {
+        put('"');
+        _carried = 0;
+    }
+    put_base64(data, size, last);
+    if (last)
+        put('"');
+}
+
+void listener_json::on_tag(unsigned int tag)
+{
+    on_extra_tag(tag);
+}
+
+void listener_json::on_extra_tag(unsigned long long tag)
+{
+    if (_options.wrap_tags)
+        begin_container(tag, frame_tag);
+}
+
+void listener_json::on_special(unsigned int code)
+{
+    scalar("null", 4);
+}
+
+void listener_json::on_extra_special(unsigned long long tag)
+{
+    scalar("null", 4);
+}
+
+void listener_json::on_undefined()
+{
+    scalar("null", 4);
+}
+
+void listener_json::on_half(float value)
+{
+    on_float(value);
+}
+
+void listener_json::on_float(float value)
+{
+    char text[32];
+    if (isfinite(value))
+        scalar(text, format_float(value, text));
+    else
+        scalar("null", 4);
+}
+
+void listener_json::on_double(double value)
+{
+    char text[32];
+    if (isfinite(value))
+        scalar(text, format_double(value, text));
+    else
+        scalar("null", 4);
+}
+
+}
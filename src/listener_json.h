@@ -0,0 +1,68 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener_text.h"
+
+namespace cbor {
+
+    struct json_options
+    {
+        bool stringify_keys;    //< write number, bool and null keys as strings, otherwise fail
+        bool wrap_tags;         //< {"tag":N,"value":item}, otherwise tags are dropped
+
+        json_options() : stringify_keys(true), wrap_tags(false) {}
+    };
+
+    /**
+     * Transcodes decoder events to JSON, one line per top level item. Byte
+     * strings become unpadded base64url, floats the shortest text that
+     * reads back the same, and NaN, infinities, undefined and simple values
+     * become null. Text is buffered: call flush() before reading the output,
+     * the destructor flushes too. After an error nothing more is written.
+     */
+    class listener_json : public listener_text {
+    private:
+        json_options _options;
+        unsigned char _carry[2]; //< bytes chunk tail not yet base64 encoded
+        int _carried;
+
+        void scalar(const char *text, size_t size) override;
+
+        void begin_container(unsigned long long size, frame_kind kind) override;
+
+        void put_bytes(const unsigned char *data, size_t size, bool first, bool last) override;
+
+        void put_base64(const unsigned char *data, size_t size, bool last);
+
+    public:
+        explicit listener_json(output &out, const json_options &options = json_options());
+
+        void on_tag(unsigned int tag) override;
+
+        void on_special(unsigned int code) override;
+
+        void on_undefined() override;
+
+        void on_half(float value) override;
+
+        void on_float(float value) override;
+
+        void on_double(double value) override;
+
+        void on_extra_tag(unsigned long long tag) override;
+
+        void on_extra_special(unsigned long long tag) override;
+    };
+}
@@ -0,0 +1,367 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener_text.h"
+#include "dtoa.h"
+
+#include <limits.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CBOR_JSON_SSE2
+#endif
+
+namespace cbor {
+
+const size_t listener_text::buffer_size;
+
+// second character of the short escapes, 0 for \u00XX
+static const char short_escapes[32] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 'b', 't', 'n', 0, 'f', 'r', 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+size_t json_plain_prefix(const char *data, size_t size)
+{
+    size_t i = 0;
+
+#ifdef CBOR_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        const __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#else
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        const uint64_t q = v ^ (ones * '"');
+        const uint64_t b = v ^ (ones * '\\');
+        const uint64_t special = ((v - ones * 0x20) & ~v) |
+                                 ((q - ones) & ~q) |
+                                 ((b - ones) & ~b);
+        if (special & highs)
+            break;
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+        const unsigned char c = (unsigned char) data[i];
+        if (c < 0x20 or c == '"' or c == '\\')
+            break;
+    }
+    return i;
+}
+
+listener_text::listener_text(output &out, const char *comma, const char *colon, const char *closers)
+        : _out(&out), _keys(nullptr), _failed(false), _key(false), _chunked(false), _comma(comma), _colon(colon),
+          _commaSize(strlen(comma)), _colonSize(strlen(colon)), _closers(closers), _used(0)
+{
+}
+
+listener_text::~listener_text()
+{
+    flush();
+}
+
+void listener_text::flush()
+{
+    if (_used != 0)
+        _out->put_bytes((const unsigned char *) _buffer, (int) _used);
+    _used = 0;
+}
+
+void listener_text::put(const char *data, size_t size)
+{
+    if (size > buffer_size - _used)
+    {
+        flush();
+        if (size >= buffer_size)
+        {
+            _out->put_bytes((const unsigned char *) data, (int) size);
+            return;
+        }
+    }
+    memcpy(_buffer + _used, data, size);
+    _used += size;
+}
+
+void listener_text::put_escaped(const char *data, size_t size)
+{
+    while (size != 0)
+    {
+        const size_t plain = json_plain_prefix(data, size);
+        put(data, plain);
+        if (plain == size)
+            return;
+
+        const unsigned char c = (unsigned char) data[plain];
+        if (c >= 0x20)
+        {
+            const char escaped[2] = {'\\', (char) c};
+            put(escaped, 2);
+        } else if (short_escapes[c] != 0)
+        {
+            const char escaped[2] = {'\\', short_escapes[c]};
+            put(escaped, 2);
+        } else
+        {
+            const char escaped[6] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xf]};
+            put(escaped, 6);
+        }
+
+        data += plain + 1;
+        size -= plain + 1;
+    }
+}
+
+void listener_text::fail(const char *error)
+{
+    if (_failed)
+        return;
+    _failed = true;
+    _error = error;
+}
+
+bool listener_text::begin_item()
+{
+    if (_failed)
+        return false;
+
+    if (_frames.empty())
+    {
+        _key = false;
+        return true;
+    }
+
+    // a tagged item is a key if its tag is
+    const frame &top = _frames.back();
+    if (top.kind == frame_tag)
+        return true;
+
+    _key = false;
+    if (top.kind == frame_map and top.done % 2 == 1)
+    {
+        put(_colon, _colonSize);
+    } else
+    {
+        if (top.done != 0)
+            put(_comma, _commaSize);
+        _key = top.kind == frame_map;
+    }
+    return true;
+}
+
+void listener_text::end_item()
+{
+    while (not _frames.empty())
+    {
+        frame &top = _frames.back();
+        if (++top.done != top.total)
+            return;
+
+        put(_closers[top.kind]);
+        _frames.pop_back();
+    }
+
+    put('\n');
+}
+
+void listener_text::push_frame(unsigned long long size, frame_kind kind)
+{
+    if (size == 0)
+    {
+        put(_closers[kind]);
+        end_item();
+        return;
+    }
+
+    frame f;
+    f.total = kind == frame_map ? size * 2 : size;
+    f.done = 0;
+    f.kind = kind;
+    _frames.push_back(f);
+}
+
+void listener_text::scalar(const char *text, size_t size)
+{
+    if (not begin_item())
+        return;
+    put(text, size);
+    end_item();
+}
+
+void listener_text::on_integer(int value)
+{
+    char text[21];
+    scalar(text, format_int(value, text));
+}
+
+void listener_text::on_extra_integer(unsigned long long value, int sign)
+{
+    char text[21];
+    if (sign >= 0)
+    {
+        scalar(text, format_uint(value, text));
+    } else if (value == ULLONG_MAX)
+    {
+        // -1 - value does not fit the unsigned arithmetic below
+        scalar("-18446744073709551616", 21);
+    } else
+    {
+        text[0] = '-';
+        scalar(text, 1 + format_uint(value + 1, text + 1));
+    }
+}
+
+void listener_text::on_bytes(unsigned char *data, int size)
+{
+    on_extra_bytes(data, (unsigned long long) size);
+}
+
+void listener_text::on_extra_bytes(unsigned char *data, unsigned long long size)
+{
+    if (not begin_item())
+        return;
+
+    put_bytes(data, (size_t) size, true, true);
+    end_item();
+}
+
+void listener_text::on_bytes_chunk(const unsigned char *data, size_t size, unsigned long long offset, unsigned long long total)
+{
+    if (offset == 0)
+    {
+        if (not begin_item())
+            return;
+        _chunked = true;
+    }
+    if (_failed)
+        return;
+
+    const bool last = offset + size == total;
+    put_bytes(data, size, offset == 0, last);
+    if (last)
+    {
+        _chunked = false;
+        end_item();
+    }
+}
+
+void listener_text::on_string(std::string &str)
+{
+    if (not begin_item())
+        return;
+
+    put('"');
+    put_escaped(str.data(), str.size());
+    put('"');
+    end_item();
+}
+
+void listener_text::on_string_chunk(const char *data, size_t size, unsigned long long offset, unsigned long long total)
+{
+    if (offset == 0)
+    {
+        if (not begin_item())
+            return;
+        put('"');
+        _chunked = true;
+    }
+    if (_failed)
+        return;
+
+    // escapes are single bytes, so chunks split inside UTF-8 sequences are fine
+    put_escaped(data, size);
+    if (offset + size == total)
+    {
+        put('"');
+        _chunked = false;
+        end_item();
+    }
+}
+
+void listener_text::on_key(int symbol)
+{
+    if (_keys == nullptr or symbol < 0 or (size_t) symbol >= _keys->size())
+    {
+        fail("unhandled key symbol");
+        return;
+    }
+    if (not begin_item())
+        return;
+
+    const std::string &name = _keys->name(symbol);
+    put('"');
+    put_escaped(name.data(), name.size());
+    put('"');
+    end_item();
+}
+
+void listener_text::on_array(int size)
+{
+    begin_container((unsigned long long) size, frame_array);
+}
+
+void listener_text::on_extra_array(unsigned long long size)
+{
+    begin_container(size, frame_array);
+}
+
+void listener_text::on_map(int size)
+{
+    begin_container((unsigned long long) size, frame_map);
+}
+
+void listener_text::on_extra_map(unsigned long long size)
+{
+    begin_container(size, frame_map);
+}
+
+void listener_text::on_bool(bool value)
+{
+    if (value)
+        scalar("true", 4);
+    else
+        scalar("false", 5);
+}
+
+void listener_text::on_null()
+{
+    scalar("null", 4);
+}
+
+void listener_text::on_error(const char *error)
+{
+    fail(error);
+}
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener.h"
+#include "output.h"
+#include "key_table.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    /// length of the prefix without control characters, quotes and backslashes,
+    /// i.e. what a JSON string holds unescaped
+    size_t json_plain_prefix(const char *data, size_t size);
+
+    /**
+     * Common part of listener_json and listener_diag: buffered output, the
+     * stack of open containers with their separators, JSON string escapes,
+     * integers, strings, keys and the framing of chunked strings. Each
+     * format writes its own scalars, container openings and byte strings.
+     */
+    class listener_text : public listener {
+    protected:
+        enum frame_kind : uint8_t { frame_array, frame_map, frame_tag };
+
+        struct frame
+        {
+            unsigned long long total; //< items, keys and values counted separately in maps
+            unsigned long long done;
+            frame_kind kind;
+        };
+
+        static const size_t buffer_size = 4096;
+
+        output *_out;
+        const key_table *_keys;
+        std::vector<frame> _frames;
+        std::string _error;
+        bool _failed;
+        bool _key;              //< the item being written is a map key
+        bool _chunked;          //< inside a chunked string
+        const char *_comma;     //< between items
+        const char *_colon;     //< between a key and its value
+        size_t _commaSize;
+        size_t _colonSize;
+        const char *_closers;   //< closing character of each frame_kind
+        size_t _used;
+        char _buffer[buffer_size];
+
+        /// separators as written between items and after keys, closers indexed by frame_kind
+        listener_text(output &out, const char *comma, const char *colon, const char *closers);
+
+        void put(char c)
+        {
+            if (_used == buffer_size)
+                flush();
+            _buffer[_used++] = c;
+        }
+
+        void put(const char *data, size_t size);
+
+        void put_escaped(const char *data, size_t size);
+
+        void fail(const char *error);
+
+        /// separators before an item, false if it must not be written
+        bool begin_item();
+
+        /// counts the item and closes the containers it completes
+        void end_item();
+
+        /// a container of size items is open, or closed at once when empty
+        void push_frame(unsigned long long size, frame_kind kind);
+
+        /// a complete item such as a number or literal
+        virtual void scalar(const char *text, size_t size);
+
+        virtual void begin_container(unsigned long long size, frame_kind kind) = 0;
+
+        /// a byte string or a piece of one, opening and closing it at first and last
+        virtual void put_bytes(const unsigned char *data, size_t size, bool first, bool last) = 0;
+
+    public:
+        /// flushes
+        ~listener_text();
+
+        /// names for on_key() symbols, see decoder::set_key_table()
+        void set_key_table(const key_table *keys) { _keys = keys; }
+
+        /// writes the buffered text to the output
+        void flush();
+
+        bool failed() const { return _failed; }
+
+        const std::string &error() const { return _error; }
+
+        /// false while a container or chunked string is still open
+        bool complete() const { return _frames.empty() and not _chunked; }
+
+        void on_integer(int value) override;
+
+        void on_bytes(unsigned char *data, int size) override;
+
+        void on_string(std::string &str) override;
+
+        void on_array(int size) override;
+
+        void on_map(int size) override;
+
+        void on_bool(bool value) override;
+
+        void on_null() override;
+
+        void on_error(const char *error) override;
+
+        void on_extra_integer(unsigned long long value, int sign) override;
+
+        void on_extra_array(unsigned long long size) override;
+
+        void on_extra_map(unsigned long long size) override;
+
+        void on_extra_bytes(unsigned char *data, unsigned long long size) override;
+
+        void on_bytes_chunk(const unsigned char *data, size_t size, unsigned long long offset, unsigned long long total) override;
+
+        void on_string_chunk(const char *data, size_t size, unsigned long long offset, unsigned long long total) override;
+
+        void on_key(int symbol) override;
+    };
+}
@@ -0,0 +1,148 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "map_index.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "hash.h"
+#include "output_dynamic.h"
+
+#include <string.h>
+
+namespace cbor {
+
+uint32_t map_index::hash(const unsigned char *data, size_t size)
+{
+    return (uint32_t) hash_bytes(data, size);
+}
+
+void map_index::key::init(const unsigned char *data, size_t size)
+{
+    _encoded.assign((const char *) data, size);
+    _hash = map_index::hash(data, size);
+}
+
+map_index::key::key(const char *str) : key(std::string(str))
+{
+}
+
+map_index::key::key(const std::string &str)
+{
+    output_dynamic out((unsigned int) str.size() + 9);
+    encoder(out).write_string(str);
+    init(out.data(), out.size());
+}
+
+map_index::key::key(long long value)
+{
+    output_dynamic out(9);
+    encoder(out).write_int(value);
+    init(out.data(), out.size());
+}
+
+map_index::key::key(const unsigned char *encoded, size_t size)
+{
+    init(encoded, size);
+}
+
+map_index::map_index(const unsigned char *data, size_t size, size_t threshold, memory_resource *resource)
+        : _slots(resource)
+{
+    _data = data;
+    _size = size;
+    _threshold = threshold;
+
+    input in(data, size);
+    decoder dec(in);
+    _count = dec.read_map();
+    _first = dec.offset();
+}
+
+bool map_index::matches(uint32_t offset, const unsigned char *data, size_t size) const
+{
+    // a complete CBOR item is never a prefix of another one, so comparing the
+    // probe's encoded bytes is enough to find the end of the stored key
+    return offset + size <= _size and memcmp(_data + offset, data, size) == 0;
+}
+
+void map_index::build()
+{
+    if (indexed() or _count == 0)
+        return;
+
+    if (_size > UINT32_MAX)
+        raise("map is too large to index");
+
+    _slots.assign(_count + _count / 2, 0);
+
+    input in(_data, _size);
+    in.advance(_first);
+    decoder dec(in);
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        uint32_t keyOffset = (uint32_t) dec.offset();
+        dec.skip();
+        uint32_t keySize = (uint32_t) dec.offset() - keyOffset;
+        dec.skip();
+
+        size_t slot = slot_of(hash(_data + keyOffset, keySize));
+        while (_slots[slot] != 0)
+        {
+            // duplicate keys: the first occurrence wins, as with a linear scan
+            if (matches(_slots[slot] - 1, _data + keyOffset, keySize))
+                break;
+            if (++slot == _slots.size())
+                slot = 0;
+        }
+        if (_slots[slot] == 0)
+            _slots[slot] = keyOffset + 1;
+    }
+}
+
+const unsigned char *map_index::find(const key &k)
+{
+    if (not indexed() and _count >= _threshold)
+        build();
+
+    if (indexed())
+    {
+        size_t slot = slot_of(k.hash());
+        while (_slots[slot] != 0)
+        {
+            uint32_t offset = _slots[slot] - 1;
+            if (matches(offset, k.data(), k.size()))
+                return _data + offset + k.size();
+            if (++slot == _slots.size())
+                slot = 0;
+        }
+        return nullptr;
+    }
+
+    input in(_data, _size);
+    in.advance(_first);
+    decoder dec(in);
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        uint32_t offset = (uint32_t) dec.offset();
+        if (matches(offset, k.data(), k.size()))
+            return _data + offset + k.size();
+        dec.skip(); // key
+        dec.skip(); // value
+    }
+    return nullptr;
+}
+
+}
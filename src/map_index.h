@@ -0,0 +1,90 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "memory_resource.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    /**
+     * Key lookup over an encoded map, in place.
+     *
+     * Small maps are searched linearly. Once a map has at least `threshold`
+     * entries, the first find() builds an open addressing table of key
+     * offsets (4 bytes per slot, 1.5 slots per entry). Keys are hashed and
+     * compared by their encoded bytes, so keys of any type work.
+     */
+    class map_index {
+    public:
+        class key {
+        private:
+            std::string _encoded;
+            uint32_t _hash;
+
+            void init(const unsigned char *data, size_t size);
+        public:
+            explicit key(const char *str);
+            explicit key(const std::string &str);
+            explicit key(long long value);
+
+            /// key given as an already encoded CBOR item
+            key(const unsigned char *encoded, size_t size);
+
+            const unsigned char *data() const { return (const unsigned char *) _encoded.data(); }
+            size_t size() const { return _encoded.size(); }
+            uint32_t hash() const { return _hash; }
+        };
+
+        static const size_t default_threshold = 16;
+
+        /// data points at an encoded map, size is the number of bytes available,
+        /// the hash table is allocated from resource
+        map_index(const unsigned char *data, size_t size, size_t threshold = default_threshold,
+                  memory_resource *resource = get_default_resource());
+
+        /// number of entries declared by the map header
+        size_t size() const { return _count; }
+
+        /// end of the input buffer, for sizing the value returned by find()
+        const unsigned char *end() const { return _data + _size; }
+
+        /// returns a pointer to the encoded value or nullptr
+        const unsigned char *find(const key &k);
+
+        void build();
+
+        bool indexed() const { return !_slots.empty(); }
+
+        /// bytes used by the hash table
+        size_t memory_usage() const { return _slots.capacity() * sizeof(uint32_t); }
+
+        static uint32_t hash(const unsigned char *data, size_t size);
+
+    private:
+        const unsigned char *_data;
+        size_t _size;
+        size_t _count;
+        size_t _first;
+        size_t _threshold;
+        pmr_vector<uint32_t> _slots;
+
+        bool matches(uint32_t offset, const unsigned char *data, size_t size) const;
+        size_t slot_of(uint32_t hash) const { return (size_t) (((uint64_t) hash * _slots.size()) >> 32); }
+    };
+}
@@ -0,0 +1,62 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "mapped_file.h"
+#include "error.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cbor {
+
+mapped_file::mapped_file(const std::string &path)
+{
+    _data = nullptr;
+    _size = 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        raise("cannot open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        raise("cannot stat " + path);
+    }
+
+    _size = (size_t) st.st_size;
+    if (_size > 0)
+    {
+        void *mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            raise("cannot map " + path);
+        }
+        _data = (unsigned char *) mapping;
+    }
+
+    close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+    if (_data != nullptr)
+        munmap(_data, _size);
+}
+
+}
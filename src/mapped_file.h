@@ -0,0 +1,37 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <string>
+
+namespace cbor {
+
+    /// read-only memory mapping of a whole file (POSIX mmap)
+    class mapped_file {
+    private:
+        unsigned char *_data;
+        size_t _size;
+    public:
+        explicit mapped_file(const std::string &path);
+
+        mapped_file(const mapped_file &) = delete;
+
+        ~mapped_file();
+
+        const unsigned char *data() const { return _data; }
+
+        size_t size() const { return _size; }
+    };
+}
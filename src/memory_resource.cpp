@@ -0,0 +1,156 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "memory_resource.h"
+
+#ifndef CBOR_STD_PMR
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace cbor {
+
+namespace {
+
+class new_delete : public memory_resource {
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        if (alignment <= alignof(std::max_align_t))
+            return ::operator new(bytes);
+
+        void *p = nullptr;
+        if (posix_memalign(&p, alignment, bytes) != 0)
+        {
+#ifdef CBOR_NO_EXCEPTIONS
+            abort();
+#else
+            throw std::bad_alloc();
+#endif
+        }
+        return p;
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        if (alignment <= alignof(std::max_align_t))
+            ::operator delete(p);
+        else
+            free(p);
+    }
+
+    bool do_is_equal(const memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+std::atomic<memory_resource *> default_resource(nullptr);
+
+}
+
+memory_resource *new_delete_resource() noexcept
+{
+    static new_delete resource;
+    return &resource;
+}
+
+memory_resource *get_default_resource() noexcept
+{
+    memory_resource *resource = default_resource.load(std::memory_order_acquire);
+    return resource ? resource : new_delete_resource();
+}
+
+memory_resource *set_default_resource(memory_resource *resource) noexcept
+{
+    memory_resource *previous = default_resource.exchange(resource, std::memory_order_acq_rel);
+    return previous ? previous : new_delete_resource();
+}
+
+static const size_t first_block_size = 1024;
+
+monotonic_buffer_resource::monotonic_buffer_resource(memory_resource *upstream)
+        : monotonic_buffer_resource(nullptr, 0, upstream)
+{
+}
+
+monotonic_buffer_resource::monotonic_buffer_resource(size_t initial_size, memory_resource *upstream)
+        : monotonic_buffer_resource(nullptr, 0, upstream)
+{
+    if (initial_size > 0)
+        _nextSize = initial_size;
+}
+
+monotonic_buffer_resource::monotonic_buffer_resource(void *buffer, size_t size, memory_resource *upstream)
+{
+    _upstream = upstream;
+    _blocks = nullptr;
+    _initial = (unsigned char *) buffer;
+    _initialSize = size;
+    _current = _initial;
+    _left = size;
+    _nextSize = size > first_block_size ? size * 2 : first_block_size;
+}
+
+monotonic_buffer_resource::~monotonic_buffer_resource()
+{
+    release();
+}
+
+void monotonic_buffer_resource::release()
+{
+    while (_blocks != nullptr)
+    {
+        block *next = _blocks->next;
+        _upstream->deallocate(_blocks, _blocks->size, alignof(std::max_align_t));
+        _blocks = next;
+    }
+
+    _current = _initial;
+    _left = _initialSize;
+}
+
+void *monotonic_buffer_resource::do_allocate(size_t bytes, size_t alignment)
+{
+    size_t padding = (alignment - (uintptr_t) _current % alignment) % alignment;
+    if (_current == nullptr or padding + bytes > _left)
+    {
+        // blocks grow geometrically, one oversized request gets its own
+        size_t size = sizeof(block) + alignment + bytes;
+        if (size < _nextSize)
+            size = _nextSize;
+        _nextSize = size * 2;
+
+        auto *fresh = (block *) _upstream->allocate(size, alignof(std::max_align_t));
+        fresh->next = _blocks;
+        fresh->size = size;
+        _blocks = fresh;
+
+        _current = (unsigned char *) (fresh + 1);
+        _left = size - sizeof(block);
+        padding = (alignment - (uintptr_t) _current % alignment) % alignment;
+    }
+
+    void *p = _current + padding;
+    _current += padding + bytes;
+    _left -= padding + bytes;
+    return p;
+}
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef CBOR_STD_PMR
+#include <memory_resource>
+#endif
+
+/*
+ * Allocation hooks for the decoder side. With CBOR_STD_PMR (C++17, CMake
+ * option CBORCPP_STD_PMR) these are the std::pmr types, otherwise a C++14
+ * subset with the same interface, so code written against either compiles
+ * with both.
+ */
+
+namespace cbor {
+
+#ifdef CBOR_STD_PMR
+
+    using std::pmr::memory_resource;
+    using std::pmr::polymorphic_allocator;
+    using std::pmr::monotonic_buffer_resource;
+    using std::pmr::new_delete_resource;
+    using std::pmr::get_default_resource;
+    using std::pmr::set_default_resource;
+
+#else
+
+    class memory_resource {
+    public:
+        virtual ~memory_resource() {}
+
+        void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+        {
+            return do_allocate(bytes, alignment);
+        }
+
+        void deallocate(void *p, size_t bytes, size_t alignment = alignof(std::max_align_t))
+        {
+            do_deallocate(p, bytes, alignment);
+        }
+
+        bool is_equal(const memory_resource &other) const noexcept { return do_is_equal(other); }
+
+    protected:
+        virtual void *do_allocate(size_t bytes, size_t alignment) = 0;
+        virtual void do_deallocate(void *p, size_t bytes, size_t alignment) = 0;
+        virtual bool do_is_equal(const memory_resource &other) const noexcept = 0;
+    };
+
+    inline bool operator==(const memory_resource &a, const memory_resource &b) noexcept
+    {
+        return &a == &b or a.is_equal(b);
+    }
+
+    inline bool operator!=(const memory_resource &a, const memory_resource &b) noexcept
+    {
+        return not (a == b);
+    }
+
+    /// operator new and delete, the default default resource
+    memory_resource *new_delete_resource() noexcept;
+
+    memory_resource *get_default_resource() noexcept;
+
+    /// returns the previous default, nullptr restores new_delete_resource()
+    memory_resource *set_default_resource(memory_resource *resource) noexcept;
+
+    /**
+     * Arena: allocations are carved out of growing blocks taken from the
+     * upstream resource, deallocate() does nothing and everything is
+     * returned at once by release() or the destructor. Not thread safe.
+     */
+    class monotonic_buffer_resource : public memory_resource {
+    private:
+        struct block {
+            block *next;
+            size_t size;
+        };
+
+        memory_resource *_upstream;
+        block *_blocks;
+        unsigned char *_initial;
+        size_t _initialSize;
+        unsigned char *_current;
+        size_t _left;
+        size_t _nextSize;
+
+    public:
+        explicit monotonic_buffer_resource(memory_resource *upstream = get_default_resource());
+        explicit monotonic_buffer_resource(size_t initial_size, memory_resource *upstream = get_default_resource());
+
+        /// starts with buffer, which has to outlive the resource
+        monotonic_buffer_resource(void *buffer, size_t size, memory_resource *upstream = get_default_resource());
+
+        ~monotonic_buffer_resource();
+
+        monotonic_buffer_resource(const monotonic_buffer_resource &) = delete;
+        monotonic_buffer_resource &operator=(const monotonic_buffer_resource &) = delete;
+
+        /// frees every block, the initial buffer is used again
+        void release();
+
+        memory_resource *upstream_resource() const { return _upstream; }
+
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override {}
+        bool do_is_equal(const memory_resource &other) const noexcept override { return this == &other; }
+    };
+
+    /// allocator handing out memory from a memory_resource, usable with std containers
+    template<typename T>
+    class polymorphic_allocator {
+    private:
+        memory_resource *_resource;
+
+        template<typename U> friend class polymorphic_allocator;
+
+    public:
+        typedef T value_type;
+
+        polymorphic_allocator() noexcept : _resource(get_default_resource()) {}
+        polymorphic_allocator(memory_resource *resource) noexcept : _resource(resource) {}
+
+        template<typename U>
+        polymorphic_allocator(const polymorphic_allocator<U> &other) noexcept : _resource(other._resource) {}
+
+        polymorphic_allocator &operator=(const polymorphic_allocator &) = delete;
+        polymorphic_allocator(const polymorphic_allocator &) = default;
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *p, size_t n)
+        {
+            _resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        /// like std::pmr, copies of a container use the default resource
+        polymorphic_allocator select_on_container_copy_construction() const { return polymorphic_allocator(); }
+
+        memory_resource *resource() const { return _resource; }
+    };
+
+    template<typename T, typename U>
+    bool operator==(const polymorphic_allocator<T> &a, const polymorphic_allocator<U> &b) noexcept
+    {
+        return *a.resource() == *b.resource();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const polymorphic_allocator<T> &a, const polymorphic_allocator<U> &b) noexcept
+    {
+        return not (a == b);
+    }
+
+#endif
+
+    template<typename T>
+    using pmr_vector = std::vector<T, polymorphic_allocator<T>>;
+
+    typedef std::basic_string<char, std::char_traits<char>, polymorphic_allocator<char>> pmr_string;
+}
@@ -0,0 +1,121 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "output_file.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace cbor {
+
+output_file::output_file(int fd, unsigned int buffer_size)
+        : _fd(fd), _owned(false), _buffer(buffer_size != 0 ? buffer_size : 1), _offset(0), _written(0)
+{
+}
+
+output_file::output_file(const std::string &path, unsigned int buffer_size, bool append)
+        : _fd(-1), _owned(true), _buffer(buffer_size != 0 ? buffer_size : 1), _offset(0), _written(0)
+{
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+    if (_fd < 0)
+        raise("cannot open " + path);
+}
+
+output_file::~output_file()
+{
+    write_all(_buffer.data(), _offset);
+    if (_owned)
+        close(_fd);
+}
+
+bool output_file::write_all(const unsigned char *data, size_t size)
+{
+    while (size != 0)
+    {
+        const ssize_t n = write(_fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        size -= (size_t) n;
+        _written += (size_t) n;
+    }
+    return true;
+}
+
+void output_file::flush()
+{
+    const unsigned int size = _offset;
+    _offset = 0;
+    if (not write_all(_buffer.data(), size))
+        raise(std::string("cannot write: ") + strerror(errno));
+}
+
+void output_file::sync()
+{
+    flush();
+#ifdef __APPLE__
+    const int result = fsync(_fd);
+#else
+    const int result = fdatasync(_fd);
+#endif
+    if (result != 0)
+        raise(std::string("cannot sync: ") + strerror(errno));
+}
+
+const unsigned char *output_file::data() const
+{
+    return _buffer.data();
+}
+
+unsigned int output_file::size() const
+{
+    return _offset;
+}
+
+void output_file::put_byte(unsigned char value)
+{
+    if (_offset == _buffer.size())
+        flush();
+    _buffer[_offset++] = value;
+}
+
+void output_file::put_bytes(const unsigned char *data, int size)
+{
+    if ((size_t) size > _buffer.size() - _offset)
+    {
+        flush();
+        if ((size_t) size >= _buffer.size())
+        {
+            if (not write_all(data, (size_t) size))
+                raise(std::string("cannot write: ") + strerror(errno));
+            return;
+        }
+    }
+    memcpy(&_buffer[_offset], data, (size_t) size);
+    _offset += (unsigned int) size;
+}
+
+std::string output_file::toString() const
+{
+    return hexlify(_buffer.data(), (int) _offset);
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "output.h"
+
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    /**
+     * Buffered output to a file descriptor (POSIX write), for dumps and
+     * exports too large to keep in memory. data() and size() cover only
+     * the bytes not written yet.
+     */
+    class output_file : public output {
+    private:
+        int _fd;
+        bool _owned;
+        std::vector<unsigned char> _buffer;
+        unsigned int _offset;
+        unsigned long long _written;
+
+        bool write_all(const unsigned char *data, size_t size);
+
+    public:
+        /// does not take ownership of fd
+        explicit output_file(int fd, unsigned int buffer_size = 65536);
+
+        /// creates path, truncating it unless append is set
+        explicit output_file(const std::string &path, unsigned int buffer_size = 65536, bool append = false);
+
+        output_file(const output_file &) = delete;
+
+        /// flushes, ignoring errors, and closes a file it opened
+        ~output_file();
+
+        virtual const unsigned char *data() const;
+
+        virtual unsigned int size() const;
+
+        virtual void put_byte(unsigned char value);
+
+        virtual void put_bytes(const unsigned char *data, int size);
+
+        /// writes the buffered bytes, raises on errors
+        void flush();
+
+        /// flush() and fdatasync(), so what was put survives a crash
+        void sync();
+
+        /// bytes put so far, buffered or not
+        unsigned long long written() const { return _written + _offset; }
+
+        std::string toString() const;
+    };
+}
@@ -0,0 +1,149 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "perf_counters.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cbor {
+
+#ifdef __linux__
+
+static int open_counter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+perf_counters::perf_counters() : _opened(0)
+{
+    static const uint64_t cache_miss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    static const struct { uint32_t type; uint64_t config; } events[counter_count] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_miss},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_miss},
+    };
+
+    for (int c = 0; c < counter_count; ++c)
+    {
+        _values[c] = 0;
+        _fds[c] = open_counter(events[c].type, events[c].config);
+        if (_fds[c] >= 0)
+            _opened++;
+        else if (_error.empty())
+            _error = std::string("perf_event_open: ") + strerror(errno);
+    }
+}
+
+perf_counters::~perf_counters()
+{
+    for (int c = 0; c < counter_count; ++c)
+    {
+        if (_fds[c] >= 0)
+            close(_fds[c]);
+    }
+}
+
+void perf_counters::start()
+{
+    for (int c = 0; c < counter_count; ++c)
+    {
+        if (_fds[c] >= 0)
+        {
+            ioctl(_fds[c], PERF_EVENT_IOC_RESET, 0);
+            ioctl(_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void perf_counters::stop()
+{
+    for (int c = 0; c < counter_count; ++c)
+    {
+        if (_fds[c] >= 0)
+            ioctl(_fds[c], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int c = 0; c < counter_count; ++c)
+    {
+        _values[c] = 0;
+        uint64_t data[3]; // value, time enabled, time running
+        if (_fds[c] < 0 or read(_fds[c], data, sizeof(data)) != (ssize_t) sizeof(data))
+            continue;
+
+        if (data[2] != 0 and data[2] < data[1])
+            _values[c] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+        else
+            _values[c] = data[0];
+    }
+}
+
+#else
+
+perf_counters::perf_counters() : _opened(0), _error("performance counters need Linux")
+{
+    for (int c = 0; c < counter_count; ++c)
+    {
+        _fds[c] = -1;
+        _values[c] = 0;
+    }
+}
+
+perf_counters::~perf_counters()
+{
+}
+
+void perf_counters::start()
+{
+}
+
+void perf_counters::stop()
+{
+}
+
+#endif
+
+const char *perf_counters::name(counter c)
+{
+    switch (c)
+    {
+        case cycles: return "cycles";
+        case instructions: return "instructions";
+        case branch_misses: return "branch_misses";
+        case l1d_misses: return "l1d_misses";
+        case llc_misses: return "llc_misses";
+        default: return "unknown";
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <string>
+
+namespace cbor {
+
+    /**
+     * Hardware counters of the calling thread through perf_event_open(2),
+     * user space only. Counters the CPU, the kernel or perf_event_paranoid
+     * do not allow are left out; on other systems none are available.
+     * Values are scaled up when the kernel had to multiplex counters.
+     */
+    class perf_counters {
+    public:
+        enum counter
+        {
+            cycles,
+            instructions,
+            branch_misses,
+            l1d_misses,
+            llc_misses,
+            counter_count
+        };
+
+        perf_counters();
+
+        perf_counters(const perf_counters &) = delete;
+
+        ~perf_counters();
+
+        bool available() const { return _opened != 0; }
+
+        bool has(counter c) const { return _fds[c] >= 0; }
+
+        /// why nothing could be opened
+        const std::string &error() const { return _error; }
+
+        /// resets and enables all counters
+        void start();
+
+        void stop();
+
+        /// count between start() and stop(), 0 when not available
+        uint64_t value(counter c) const { return _values[c]; }
+
+        static const char *name(counter c);
+
+    private:
+        int _fds[counter_count];
+        uint64_t _values[counter_count];
+        int _opened;
+        std::string _error;
+    };
+}
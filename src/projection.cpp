@@ -0,0 +1,245 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "projection.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+namespace cbor {
+
+projection::projection()
+{
+    _nodes.resize(1);
+    _paths = 0;
+}
+
+int projection::child(int from, const std::string &key)
+{
+    for (auto &e : _nodes[from].keys)
+    {
+        if (e.key == key) return e.target;
+    }
+    int target = (int) _nodes.size();
+    _nodes[from].keys.push_back(edge{key, 0, target});
+    _nodes.emplace_back();
+    return target;
+}
+
+int projection::child(int from, size_t index)
+{
+    for (auto &e : _nodes[from].indices)
+    {
+        if (e.index == index) return e.target;
+    }
+    int target = (int) _nodes.size();
+    _nodes[from].indices.push_back(edge{std::string(), index, target});
+    _nodes.emplace_back();
+    return target;
+}
+
+int projection::any_child(int from)
+{
+    if (_nodes[from].any_index < 0)
+    {
+        int target = (int) _nodes.size();
+        _nodes[from].any_index = target;
+        _nodes.emplace_back();
+    }
+    return _nodes[from].any_index;
+}
+
+size_t projection::add(const std::string &path)
+{
+    int current = 0;
+    size_t pos = 0;
+
+    while (pos < path.size())
+    {
+        if (path[pos] == '.')
+        {
+            ++pos;
+        } else if (path[pos] == '[')
+        {
+            size_t close = path.find(']', pos);
+            if (close == std::string::npos)
+                raise("unterminated index in path: " + path);
+
+            std::string step = path.substr(pos + 1, close - pos - 1);
+            if (step == "*")
+            {
+                current = any_child(current);
+            } else
+            {
+                char *end;
+                unsigned long long index = strtoull(step.c_str(), &end, 10);
+                if (step.empty() or *end != '\0')
+                    raise("invalid index in path: " + path);
+                current = child(current, (size_t) index);
+            }
+            pos = close + 1;
+        } else
+        {
+            size_t end = path.find_first_of(".[", pos);
+            if (end == std::string::npos) end = path.size();
+            current = child(current, path.substr(pos, end - pos));
+            pos = end;
+        }
+    }
+
+    _nodes[current].paths.push_back(_paths);
+    return _paths++;
+}
+
+int projection::find_key(const node &n, const char *key, size_t size) const
+{
+    for (auto &e : n.keys)
+    {
+        if (e.key.size() == size and memcmp(e.key.data(), key, size) == 0) return e.target;
+    }
+    return -1;
+}
+
+int projection::find_index(const node &n, size_t index) const
+{
+    for (auto &e : n.indices)
+    {
+        if (e.index == index) return e.target;
+    }
+    return -1;
+}
+
+void projection::run(const unsigned char *data, size_t size, projection_listener &listener) const
+{
+    const error_code error = try_run(data, size, listener);
+    if (error != error_code::ok)
+        raise(error);
+}
+
+error_code projection::try_run(const unsigned char *data, size_t size, projection_listener &listener) const
+{
+    input in(data, size);
+    decoder dec(in);
+    return walk(dec, data, 0, listener);
+}
+
+error_code projection::walk(decoder &dec, const unsigned char *base, int current, projection_listener &listener) const
+{
+    const node &n = _nodes[current];
+
+    if (n.paths.empty())
+        return descend(dec, base, n, listener);
+
+    size_t start = dec.offset();
+    error_code error = dec.try_skip();
+    if (error != error_code::ok)
+        return error;
+    for (size_t path : n.paths)
+    {
+        listener.on_value(path, base + start, dec.offset() - start);
+    }
+
+    if (not n.keys.empty() or not n.indices.empty() or n.any_index >= 0)
+    {
+        // a shorter path took the whole item, walk it again for the longer ones
+        input in(base + start, dec.offset() - start);
+        decoder sub(in);
+        error = descend(sub, base + start, n, listener);
+    }
+    return error;
+}
+
+error_code projection::descend(decoder &dec, const unsigned char *base, const node &n,
+                               projection_listener &listener) const
+{
+    auto type = dec.try_peek_type();
+    while (type and type.value().major() == majorType::tag)
+    {
+        auto tag = dec.try_read_tag();
+        if (not tag)
+            return tag.error();
+        type = dec.try_peek_type();
+    }
+    if (not type)
+        return type.error();
+
+    const majorType major = type.value().major();
+    if (major == majorType::map and not n.keys.empty())
+    {
+        auto count = dec.try_read_map();
+        if (not count)
+            return count.error();
+        for (size_t entry = 0; entry < count.value(); ++entry)
+        {
+            auto key_type = dec.try_peek_type();
+            if (not key_type)
+                return key_type.error();
+
+            error_code error;
+            if (key_type.value().major() != majorType::utf8String)
+            {
+                error = dec.try_skip(); // key
+                if (error == error_code::ok)
+                    error = dec.try_skip(); // value
+            } else
+            {
+                size_t size;
+                auto key = dec.try_read_string(size);
+                if (not key)
+                    return key.error();
+                const int target = find_key(n, key.value(), size);
+                error = target >= 0 ? walk(dec, base, target, listener) : dec.try_skip();
+            }
+            if (error != error_code::ok)
+                return error;
+        }
+    } else if (major == majorType::array and (not n.indices.empty() or n.any_index >= 0))
+    {
+        auto count = dec.try_read_array();
+        if (not count)
+            return count.error();
+        for (size_t i = 0; i < count.value(); ++i)
+        {
+            int target = find_index(n, i);
+            error_code error;
+            if (target < 0)
+            {
+                target = n.any_index;
+            } else if (n.any_index >= 0)
+            {
+                // both "[i]" and "[*]" go through this element
+                size_t start = dec.offset();
+                error = walk(dec, base, n.any_index, listener);
+                if (error != error_code::ok)
+                    return error;
+                input in(base + start, dec.offset() - start);
+                decoder sub(in);
+                error = walk(sub, base + start, target, listener);
+                if (error != error_code::ok)
+                    return error;
+                continue;
+            }
+
+            error = target >= 0 ? walk(dec, base, target, listener) : dec.try_skip();
+            if (error != error_code::ok)
+                return error;
+        }
+    } else
+    {
+        return dec.try_skip();
+    }
+    return error_code::ok;
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "decoder.h"
+
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+    class projection_listener {
+    public:
+        /// data/size is the encoded value found at the path with the given id
+        virtual void on_value(size_t path, const unsigned char *data, size_t size) = 0;
+    };
+
+    /**
+     * A set of paths compiled into a trie that is run over an encoded item.
+     *
+     * Paths are dot separated map keys with array steps in brackets:
+     * "meta.trace.id", "events[*].ts", "items[0]", "[*].name".
+     * Subtrees that no path goes through are skipped without decoding.
+     */
+    class projection {
+    private:
+        struct edge {
+            std::string key;
+            size_t index;
+            int target;
+        };
+
+        struct node {
+            std::vector<edge> keys;
+            std::vector<edge> indices;
+            int any_index;
+            std::vector<size_t> paths;
+
+            node() : any_index(-1) {}
+        };
+
+        std::vector<node> _nodes;
+        size_t _paths;
+
+        int child(int from, const std::string &key);
+        int child(int from, size_t index);
+        int any_child(int from);
+
+        error_code walk(decoder &dec, const unsigned char *base, int current, projection_listener &listener) const;
+        error_code descend(decoder &dec, const unsigned char *base, const node &n,
+                           projection_listener &listener) const;
+        int find_key(const node &n, const char *key, size_t size) const;
+        int find_index(const node &n, size_t index) const;
+
+    public:
+        projection();
+
+        /// compiles a path into the trie and returns its id
+        size_t add(const std::string &path);
+
+        size_t size() const { return _paths; }
+
+        /// passes the values found to listener; on malformed input those before the error have been passed
+        error_code try_run(const unsigned char *data, size_t size, projection_listener &listener) const;
+
+        /// throwing version of try_run()
+        void run(const unsigned char *data, size_t size, projection_listener &listener) const;
+    };
+}
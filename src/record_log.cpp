@@ -0,0 +1,154 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "record_log.h"
+#include "byte_order.h"
+#include "crc32c.h"
+#include "error.h"
+
+#include <string.h>
+
+namespace cbor {
+
+static uint32_t frame_crc(const unsigned char *length, const unsigned char *payload, size_t size)
+{
+    return crc32c(payload, size, crc32c(length, 4));
+}
+
+log_writer::log_writer(output &out, const log_options &options)
+        : _out(&out), _file(nullptr), _options(options), _pending(0), _pendingBytes(0), _records(0)
+{
+}
+
+log_writer::log_writer(output_file &out, const log_options &options)
+        : _out(&out), _file(&out), _options(options), _pending(0), _pendingBytes(0), _records(0)
+{
+}
+
+void log_writer::append(const void *data, size_t size)
+{
+    if (size > log_max_record)
+        raise(error_code::size_limit, "log record");
+
+    unsigned char header[log_header_size];
+    store_be32(header, log_magic);
+    store_be32(header + 4, (uint32_t) size);
+    store_be32(header + 8, frame_crc(header + 4, (const unsigned char *) data, size));
+
+    _out->put_bytes(header, (int) log_header_size);
+    _out->put_bytes((const unsigned char *) data, (int) size);
+
+    _records++;
+    _pending++;
+    _pendingBytes += log_header_size + size;
+    if ((_options.group_records != 0 and _pending >= _options.group_records) or
+        (_options.group_bytes != 0 and _pendingBytes >= _options.group_bytes))
+        commit();
+}
+
+void log_writer::commit()
+{
+    if (_file != nullptr)
+    {
+        if (_options.sync)
+            _file->sync();
+        else
+            _file->flush();
+    }
+    _pending = 0;
+    _pendingBytes = 0;
+}
+
+log_reader::log_reader(input &in, size_t max_record)
+        : _in(&in), _maxRecord(max_record), _validEnd(in.offset()), _corrupt(0), _skipped(0), _truncated(false)
+{
+}
+
+bool log_reader::frame_ok(const unsigned char *frame, size_t available) const
+{
+    if (available < log_header_size or load_be32(frame) != log_magic)
+        return false;
+
+    const uint32_t size = load_be32(frame + 4);
+    if (size > _maxRecord or size > available - log_header_size)
+        return false;
+
+    return frame_crc(frame + 4, frame + log_header_size, size) == load_be32(frame + 8);
+}
+
+/// a frame cut short by the end of the input, as a crash during a write leaves it
+static bool incomplete_frame(const unsigned char *frame, size_t available, size_t max_record)
+{
+    unsigned char magic[4];
+    store_be32(magic, log_magic);
+
+    if (available < log_header_size)
+        return memcmp(frame, magic, available < 4 ? available : 4) == 0;
+
+    const uint32_t size = load_be32(frame + 4);
+    return memcmp(frame, magic, 4) == 0 and size <= max_record and size > available - log_header_size;
+}
+
+bool log_reader::next(const unsigned char *&data, size_t &size)
+{
+    while (_in->remaining() != 0)
+    {
+        const unsigned char *frame = _in->current();
+        const size_t available = _in->remaining();
+
+        if (frame_ok(frame, available))
+        {
+            size = load_be32(frame + 4);
+            data = frame + log_header_size;
+            _in->advance(log_header_size + size);
+            _validEnd = _in->offset();
+            return true;
+        }
+
+        // resynchronize at the next magic that starts an intact frame
+        const unsigned char first = (unsigned char) (log_magic >> 24);
+        size_t skip = 1;
+        bool torn = false;  //< a magic on the way starts a frame cut short by the end
+        while (skip < available)
+        {
+            const void *candidate = memchr(frame + skip, first, available - skip);
+            if (candidate == nullptr)
+            {
+                skip = available;
+                break;
+            }
+            skip = (const unsigned char *) candidate - frame;
+            if (frame_ok(frame + skip, available - skip))
+                break;
+            torn = torn or incomplete_frame(frame + skip, available - skip, _maxRecord);
+            skip++;
+        }
+
+        if (skip == available and incomplete_frame(frame, available, _maxRecord))
+        {
+            _truncated = true;
+        } else
+        {
+            _corrupt++;
+            // a damaged stretch and then a torn last frame
+            if (skip == available and torn)
+                _truncated = true;
+        }
+        _skipped += skip;
+        _in->advance(skip);
+    }
+    return false;
+}
+
+}
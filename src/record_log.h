@@ -0,0 +1,118 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "input.h"
+#include "output.h"
+#include "output_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cbor {
+
+    /**
+     * Record frames: the magic ff 4c 4f 47 ("\xffLOG"), the payload length
+     * and the CRC-32C of length and payload, all big endian 32 bit, then the
+     * payload. 0xff is a break code, so the magic hardly ever shows up in
+     * definite length CBOR, and a false match still has to pass the CRC.
+     */
+    static const uint32_t log_magic = 0xff4c4f47;
+    static const size_t log_header_size = 12;
+    static const size_t log_max_record = 0x7fffffff;
+
+    struct log_options
+    {
+        unsigned group_records; //< commit after this many records, 0 for no limit
+        size_t group_bytes;     //< commit once this many bytes are pending, 0 for no limit
+        bool sync;              //< commit() waits for fdatasync on an output_file
+
+        log_options() : group_records(0), group_bytes(0), sync(true) {}
+    };
+
+    /**
+     * Appends framed records to an output. Records are durable once commit()
+     * returns: on an output_file that is one write() and one fdatasync() for
+     * every record appended since the last commit, so committing a group of
+     * small records costs about as much as committing one. Other outputs
+     * have nothing to commit.
+     */
+    class log_writer {
+    private:
+        output *_out;
+        output_file *_file;
+        log_options _options;
+        unsigned _pending;
+        size_t _pendingBytes;
+        unsigned long long _records;
+
+    public:
+        explicit log_writer(output &out, const log_options &options = log_options());
+
+        explicit log_writer(output_file &out, const log_options &options = log_options());
+
+        log_writer(const log_writer &) = delete;
+
+        /// raises size_limit above log_max_record bytes, commits when a group is full
+        void append(const void *data, size_t size);
+
+        /// flushes and, with log_options::sync, syncs an output_file; raises on errors
+        void commit();
+
+        /// records appended, committed or not
+        unsigned long long records() const { return _records; }
+
+        /// records appended since the last commit
+        unsigned pending() const { return _pending; }
+    };
+
+    /**
+     * Reads the records of a log in place. A frame with a wrong magic, a
+     * length past max_record or a CRC mismatch is skipped by searching for
+     * the next magic whose frame checks out, so one torn or corrupted write
+     * costs only the records it touched. An incomplete frame at the end,
+     * as left by a crash during a write, ends the log; truncate the file to
+     * valid_end() before appending to it again.
+     */
+    class log_reader {
+    private:
+        input *_in;
+        size_t _maxRecord;
+        size_t _validEnd;
+        unsigned long long _corrupt;
+        unsigned long long _skipped;
+        bool _truncated;
+
+        /// whole frame at the current offset that passes all checks
+        bool frame_ok(const unsigned char *frame, size_t available) const;
+
+    public:
+        explicit log_reader(input &in, size_t max_record = log_max_record);
+
+        /// next intact record, valid as long as the input; false at the end
+        bool next(const unsigned char *&data, size_t &size);
+
+        /// input offset after the last intact record
+        size_t valid_end() const { return _validEnd; }
+
+        /// damaged stretches skipped by resynchronizing
+        unsigned long long corrupt_records() const { return _corrupt; }
+
+        /// bytes skipped, including an incomplete last frame
+        unsigned long long skipped_bytes() const { return _skipped; }
+
+        /// the log ended inside a frame
+        bool truncated() const { return _truncated; }
+    };
+}
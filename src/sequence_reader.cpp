@@ -0,0 +1,121 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "sequence_reader.h"
+#include "decoder.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace cbor {
+
+sequence_reader::sequence_reader(const unsigned char *data, size_t size, thread_pool &pool, memory_resource *resource)
+        : _offsets(resource)
+{
+    _data = data;
+    _size = size;
+    _pool = &pool;
+    _chunk = 0;
+}
+
+size_t sequence_reader::scan(size_t limit)
+{
+    _offsets.clear();
+    if (limit != (size_t) -1)
+        _offsets.reserve(std::min(limit, _size) + 1); // every item takes at least one byte
+
+    input in(_data, _size);
+    decoder dec(in);
+
+    _offsets.push_back(0);
+    while (dec.offset() < _size and _offsets.size() <= limit)
+    {
+        auto error = dec.try_skip();
+        if (error != error_code::ok)
+            raise(error, "in record at offset " + std::to_string(_offsets.back()));
+        _offsets.push_back(dec.offset());
+    }
+
+    return size();
+}
+
+const unsigned char *sequence_reader::record(size_t index, size_t &size) const
+{
+    size = _offsets[index + 1] - _offsets[index];
+    return _data + _offsets[index];
+}
+
+void sequence_reader::run(record_handler &handler, bool ordered)
+{
+    if (_offsets.empty())
+        scan();
+
+    const size_t records = size();
+    size_t chunk = _chunk;
+    if (chunk == 0)
+    {
+        // enough tasks per worker for stealing to even out uneven records
+        chunk = records / (_pool->size() * 16);
+        if (chunk == 0) chunk = 1;
+    }
+    const size_t chunks = (records + chunk - 1) / chunk;
+
+    std::mutex orderLock;
+    std::vector<char> done(ordered ? chunks : 0, 0);
+    size_t nextOrdered = 0;
+
+    _pool->run(chunks, [&](unsigned worker, size_t task) {
+        const size_t first = task * chunk;
+        const size_t last = std::min(records, first + chunk);
+
+        for (size_t i = first; i < last; ++i)
+        {
+            handler.on_record(worker, i, _data + _offsets[i], _offsets[i + 1] - _offsets[i]);
+        }
+
+        if (ordered)
+        {
+            std::lock_guard<std::mutex> guard(orderLock);
+            done[task] = 1;
+            while (nextOrdered < chunks and done[nextOrdered])
+            {
+                handler.on_ordered(nextOrdered * chunk, std::min(records, (nextOrdered + 1) * chunk));
+                ++nextOrdered;
+            }
+        }
+    });
+}
+
+void sequence_reader::run(const std::vector<listener *> &listeners)
+{
+    if (listeners.size() < _pool->size())
+        raise("one listener per worker is required");
+
+    class listener_handler : public record_handler {
+        const std::vector<listener *> &_listeners;
+    public:
+        listener_handler(const std::vector<listener *> &listeners) : _listeners(listeners) {}
+
+        virtual void on_record(unsigned worker, size_t index, const unsigned char *data, size_t size)
+        {
+            input in(data, size);
+            decoder dec(in, *_listeners[worker]);
+            dec.run();
+        }
+    } handler(listeners);
+
+    run(handler, false);
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "listener.h"
+#include "thread_pool.h"
+#include "memory_resource.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace cbor {
+
+    class record_handler {
+    public:
+        /// called from worker threads, records of one chunk come in order
+        virtual void on_record(unsigned worker, size_t index, const unsigned char *data, size_t size) = 0;
+
+        /// ordered runs only: called serially and in order once every record
+        /// in [first, last) has been handled
+        virtual void on_ordered(size_t first, size_t last) { }
+    };
+
+    /**
+     * Parallel reader for CBOR sequences (RFC 8742), i.e. concatenated items.
+     *
+     * scan() finds the record boundaries with skip(), run() hands chunks of
+     * records to the workers of a thread_pool.
+     */
+    class sequence_reader {
+    private:
+        const unsigned char *_data;
+        size_t _size;
+        thread_pool *_pool;
+        pmr_vector<size_t> _offsets;
+        size_t _chunk;
+
+    public:
+        /// record offsets are allocated from resource
+        sequence_reader(const unsigned char *data, size_t size, thread_pool &pool,
+                        memory_resource *resource = get_default_resource());
+
+        /// finds record boundaries and returns the number of records,
+        /// stopping after limit records
+        size_t scan(size_t limit = (size_t) -1);
+
+        size_t size() const { return _offsets.empty() ? 0 : _offsets.size() - 1; }
+
+        const unsigned char *record(size_t index, size_t &size) const;
+
+        /// records per task handed to a worker, 0 picks one from the pool size
+        void set_chunk_size(size_t records) { _chunk = records; }
+
+        void run(record_handler &handler, bool ordered = false);
+
+        /// decodes every record with decoder::run(), worker i uses listeners[i]
+        void run(const std::vector<listener *> &listeners);
+    };
+}
@@ -0,0 +1,133 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "sharded_array.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace cbor {
+
+sharded_array::sharded_array(unsigned shards) : _header(9)
+{
+    for (unsigned i = 0; i < shards; ++i)
+    {
+        _shards.emplace_back(new slice());
+    }
+}
+
+size_t sharded_array::size() const
+{
+    size_t count = 0;
+    for (auto &s : _shards)
+    {
+        count += s->count;
+    }
+    return count;
+}
+
+size_t sharded_array::encoded_size()
+{
+    size_t size = segments()[0].iov_len;
+    for (auto &s : _shards)
+    {
+        size += s->out.size();
+    }
+    return size;
+}
+
+std::vector<struct iovec> sharded_array::segments()
+{
+    _header.clear();
+    encoder(_header).write_array(size());
+
+    std::vector<struct iovec> result;
+    result.reserve(_shards.size() + 1);
+    result.push_back(iovec{(void *) _header.data(), _header.size()});
+
+    for (auto &s : _shards)
+    {
+        if (s->out.size() > 0)
+            result.push_back(iovec{(void *) s->out.data(), s->out.size()});
+    }
+    return result;
+}
+
+ssize_t sharded_array::write_to(int fd)
+{
+    std::vector<struct iovec> iov = segments();
+    size_t first = 0;
+    ssize_t total = 0;
+
+    while (first < iov.size())
+    {
+        int count = (int) std::min(iov.size() - first, (size_t) IOV_MAX);
+        ssize_t written = writev(fd, &iov[first], count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += written;
+
+        // drop fully written segments and trim a partially written one
+        while (first < iov.size() and (size_t) written >= iov[first].iov_len)
+        {
+            written -= iov[first].iov_len;
+            ++first;
+        }
+        if (written > 0)
+        {
+            iov[first].iov_base = (char *) iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+        }
+    }
+    return total;
+}
+
+void sharded_array::copy_to(output &out)
+{
+    for (auto &segment : segments())
+    {
+        // put_bytes() takes an int, shards of 2 GiB and more go in parts
+        const unsigned char *data = (const unsigned char *) segment.iov_base;
+        size_t size = segment.iov_len;
+        while (size != 0)
+        {
+            const size_t part = size < INT_MAX ? size : INT_MAX;
+            out.put_bytes(data, (int) part);
+            data += part;
+            size -= part;
+        }
+    }
+}
+
+void sharded_array::clear()
+{
+    for (auto &s : _shards)
+    {
+        s->out.clear();
+        s->count = 0;
+    }
+}
+
+}
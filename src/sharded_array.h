@@ -0,0 +1,74 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "encoder.h"
+#include "output_dynamic.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <memory>
+#include <vector>
+
+namespace cbor {
+
+    /**
+     * One array encoded by several threads at once.
+     *
+     * Every shard has its own encoder and output buffer, so shards can be
+     * filled concurrently as long as each one is used by one thread. Each
+     * thread reports the number of elements it wrote with add_items(). The
+     * array header is written last with the combined count, and the shards
+     * are stitched together with writev() or as iovecs, without copying them.
+     */
+    class sharded_array {
+    private:
+        struct slice {
+            output_dynamic out;
+            encoder enc;
+            size_t count;
+
+            slice() : out(4096), enc(out), count(0) {}
+        };
+
+        std::vector<std::unique_ptr<slice>> _shards;
+        output_dynamic _header;
+
+    public:
+        explicit sharded_array(unsigned shards);
+
+        unsigned shards() const { return (unsigned) _shards.size(); }
+
+        encoder &shard(unsigned index) { return _shards[index]->enc; }
+
+        /// records that count more elements were written to the shard
+        void add_items(unsigned index, size_t count = 1) { _shards[index]->count += count; }
+
+        /// total number of elements over all shards
+        size_t size() const;
+
+        size_t encoded_size();
+
+        /// header and shard buffers in order, pointing into the shards
+        std::vector<struct iovec> segments();
+
+        /// writes the whole array to fd with writev(), returns bytes written or -1
+        ssize_t write_to(int fd);
+
+        void copy_to(output &out);
+
+        /// empties the shards for reuse, keeping their buffers
+        void clear();
+    };
+}
@@ -0,0 +1,262 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "stats.h"
+
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+
+namespace cbor {
+
+const unsigned latency_histogram::sub_buckets;
+const unsigned latency_histogram::buckets;
+
+uint64_t latency_snapshot::count() const
+{
+    uint64_t n = 0;
+    for (uint64_t c : counts)
+        n += c;
+    return n;
+}
+
+uint64_t latency_snapshot::min() const
+{
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        if (counts[i] != 0)
+            return latency_histogram::bucket_low((unsigned) i);
+    }
+    return 0;
+}
+
+uint64_t latency_snapshot::max() const
+{
+    for (size_t i = counts.size(); i-- > 0;)
+    {
+        if (counts[i] != 0)
+            return latency_histogram::bucket_high((unsigned) i);
+    }
+    return 0;
+}
+
+double latency_snapshot::mean() const
+{
+    const uint64_t n = count();
+    return n == 0 ? 0 : (double) total / n;
+}
+
+uint64_t latency_snapshot::percentile(double q) const
+{
+    const uint64_t n = count();
+    if (n == 0)
+        return 0;
+
+    // rank of the value, 1 based
+    uint64_t rank = (uint64_t) (q * n + 0.5);
+    rank = std::min(std::max(rank, (uint64_t) 1), n);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return latency_histogram::bucket_high((unsigned) i);
+    }
+    return max();
+}
+
+void latency_snapshot::merge(const latency_snapshot &other)
+{
+    if (counts.size() < other.counts.size())
+        counts.resize(other.counts.size());
+    for (size_t i = 0; i < other.counts.size(); ++i)
+        counts[i] += other.counts[i];
+    total += other.total;
+}
+
+latency_histogram::latency_histogram()
+{
+    reset();
+}
+
+uint64_t latency_histogram::bucket_low(unsigned index)
+{
+    if (index < sub_buckets)
+        return index;
+    const unsigned top = index / sub_buckets + 3;
+    return (uint64_t) (sub_buckets + index % sub_buckets) << (top - 4);
+}
+
+uint64_t latency_histogram::bucket_high(unsigned index)
+{
+    if (index + 1 >= buckets)
+        return UINT64_MAX;
+    return bucket_low(index + 1) - 1;
+}
+
+latency_snapshot latency_histogram::snapshot() const
+{
+    latency_snapshot snap;
+    snap.counts.resize(buckets);
+    for (unsigned i = 0; i < buckets; ++i)
+        snap.counts[i] = _counts[i].load(std::memory_order_relaxed);
+    snap.total = _total.load(std::memory_order_relaxed);
+    return snap;
+}
+
+void latency_histogram::reset()
+{
+    for (auto &count : _counts)
+        count.store(0, std::memory_order_relaxed);
+    _total.store(0, std::memory_order_relaxed);
+}
+
+stats_snapshot::stats_snapshot()
+        : max_depth(0), allocations(0), allocated_bytes(0)
+{
+    memset(decoded_items, 0, sizeof(decoded_items));
+    memset(decoded_bytes, 0, sizeof(decoded_bytes));
+    memset(encoded_items, 0, sizeof(encoded_items));
+    memset(encoded_bytes, 0, sizeof(encoded_bytes));
+    memset(string_sizes, 0, sizeof(string_sizes));
+    decode_latency.counts.resize(latency_histogram::buckets);
+}
+
+#ifdef CBOR_STATS
+
+namespace detail {
+
+thread_local thread_stats *current_stats = nullptr;
+
+void thread_stats::reset()
+{
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        decoded_items[i].store(0, std::memory_order_relaxed);
+        decoded_bytes[i].store(0, std::memory_order_relaxed);
+        encoded_items[i].store(0, std::memory_order_relaxed);
+        encoded_bytes[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto &count : string_sizes)
+        count.store(0, std::memory_order_relaxed);
+    max_depth.store(0, std::memory_order_relaxed);
+    allocations.store(0, std::memory_order_relaxed);
+    allocated_bytes.store(0, std::memory_order_relaxed);
+    decode_latency.reset();
+}
+
+}
+
+static void load(const std::atomic<uint64_t> *counters, uint64_t *sums, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        sums[i] += counters[i].load(std::memory_order_relaxed);
+}
+
+static void add_to(stats_snapshot &snap, const detail::thread_stats &stats)
+{
+    load(stats.decoded_items, snap.decoded_items, 8);
+    load(stats.decoded_bytes, snap.decoded_bytes, 8);
+    load(stats.encoded_items, snap.encoded_items, 8);
+    load(stats.encoded_bytes, snap.encoded_bytes, 8);
+    load(stats.string_sizes, snap.string_sizes, string_size_buckets);
+    snap.max_depth = std::max(snap.max_depth, stats.max_depth.load(std::memory_order_relaxed));
+    snap.allocations += stats.allocations.load(std::memory_order_relaxed);
+    snap.allocated_bytes += stats.allocated_bytes.load(std::memory_order_relaxed);
+    snap.decode_latency.merge(stats.decode_latency.snapshot());
+}
+
+/**
+ * The counters of live threads, and the sums of the threads that have
+ * exited. Only thread start, thread exit and get_stats() take the lock.
+ */
+struct stats_registry
+{
+    std::mutex lock;
+    std::vector<detail::thread_stats *> threads;
+    stats_snapshot retired;
+};
+
+static stats_registry &registry()
+{
+    // never destroyed, threads may exit after static destruction
+    static stats_registry *instance = new stats_registry();
+    return *instance;
+}
+
+/// owns the counters of one thread and folds them into the registry on exit
+struct thread_registration
+{
+    detail::thread_stats stats;
+
+    thread_registration()
+    {
+        stats_registry &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        reg.threads.push_back(&stats);
+    }
+
+    ~thread_registration()
+    {
+        stats_registry &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        add_to(reg.retired, stats);
+        reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), &stats));
+        detail::current_stats = nullptr;
+    }
+};
+
+detail::thread_stats *detail::register_thread()
+{
+    static thread_local thread_registration registration;
+    current_stats = &registration.stats;
+    return current_stats;
+}
+
+stats_snapshot get_stats()
+{
+    stats_registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    stats_snapshot snap = reg.retired;
+    for (const detail::thread_stats *stats : reg.threads)
+        add_to(snap, *stats);
+    return snap;
+}
+
+void reset_stats()
+{
+    stats_registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    reg.retired = stats_snapshot();
+    for (detail::thread_stats *stats : reg.threads)
+        stats->reset();
+}
+
+#else
+
+stats_snapshot get_stats()
+{
+    return stats_snapshot();
+}
+
+void reset_stats()
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,239 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace cbor {
+
+    struct latency_snapshot
+    {
+        std::vector<uint64_t> counts;   //< per latency_histogram bucket
+        uint64_t total;                 //< sum of all recorded values
+
+        latency_snapshot() : total(0) {}
+
+        uint64_t count() const;
+
+        /// bounds of the recorded range, to the bucket precision
+        uint64_t min() const;
+        uint64_t max() const;
+
+        double mean() const;
+
+        /// upper bound of the bucket holding the q-th quantile, 0 <= q <= 1
+        uint64_t percentile(double q) const;
+
+        void merge(const latency_snapshot &other);
+    };
+
+    /**
+     * Log-linear histogram in the style of HdrHistogram: every power of two
+     * is split into 16 linear buckets, so any value up to 2^64 is kept with
+     * a relative error below 1/16. One thread records, with plain relaxed
+     * loads and stores and no locked instruction; any thread may take a
+     * snapshot at any time and sees each counter whole.
+     */
+    class latency_histogram {
+    public:
+        static const unsigned sub_buckets = 16;
+        static const unsigned buckets = (64 - 3) * sub_buckets;
+
+        latency_histogram();
+
+        latency_histogram(const latency_histogram &) = delete;
+        latency_histogram &operator=(const latency_histogram &) = delete;
+
+        static unsigned bucket(uint64_t value)
+        {
+            if (value < sub_buckets)
+                return (unsigned) value;
+            const unsigned top = 63 - __builtin_clzll(value);
+            return (top - 3) * sub_buckets + (unsigned) ((value >> (top - 4)) & (sub_buckets - 1));
+        }
+
+        /// smallest and largest value of a bucket
+        static uint64_t bucket_low(unsigned index);
+        static uint64_t bucket_high(unsigned index);
+
+        /// only from the owning thread
+        void record(uint64_t value)
+        {
+            std::atomic<uint64_t> &count = _counts[bucket(value)];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            _total.store(_total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        latency_snapshot snapshot() const;
+
+        /// not atomic with respect to concurrent record() calls
+        void reset();
+
+    private:
+        std::atomic<uint64_t> _counts[buckets];
+        std::atomic<uint64_t> _total;
+    };
+
+    /// string length buckets: 0 for empty, n for lengths in [2^(n-1), 2^n)
+    static const unsigned string_size_buckets = 65;
+
+    /**
+     * Counters of the decoders and encoders of all threads. Items and bytes
+     * are by major type; bytes count heads and string payloads. The pull
+     * API counts what it reads except skipped items, run() counts every
+     * item and times each call as one message.
+     */
+    struct stats_snapshot
+    {
+        uint64_t decoded_items[8];
+        uint64_t decoded_bytes[8];
+        uint64_t encoded_items[8];
+        uint64_t encoded_bytes[8];
+        uint64_t string_sizes[string_size_buckets];     //< decoded byte and text strings
+        uint64_t max_depth;                             //< deepest container nesting run() saw
+        uint64_t allocations;                           //< strings the decoders copied
+        uint64_t allocated_bytes;
+        latency_snapshot decode_latency;                //< nanoseconds per decoder::run() call
+
+        stats_snapshot();
+    };
+
+    /// false unless built with CBOR_STATS (cmake -DCBORCPP_STATS=ON)
+    constexpr bool stats_enabled()
+    {
+#ifdef CBOR_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Sums the counters of running and finished threads. Counters of threads
+     * still working may be a few updates behind. All zero without CBOR_STATS.
+     */
+    stats_snapshot get_stats();
+
+    /// zeroes the counters, updates racing with the reset may survive it
+    void reset_stats();
+
+#ifdef CBOR_STATS
+    namespace detail {
+
+        /// written by its own thread only, read by get_stats()
+        struct thread_stats
+        {
+            std::atomic<uint64_t> decoded_items[8];
+            std::atomic<uint64_t> decoded_bytes[8];
+            std::atomic<uint64_t> encoded_items[8];
+            std::atomic<uint64_t> encoded_bytes[8];
+            std::atomic<uint64_t> string_sizes[string_size_buckets];
+            std::atomic<uint64_t> max_depth;
+            std::atomic<uint64_t> allocations;
+            std::atomic<uint64_t> allocated_bytes;
+            latency_histogram decode_latency;
+
+            thread_stats() { reset(); }
+
+            void reset();
+        };
+
+        extern thread_local thread_stats *current_stats;
+
+        thread_stats *register_thread();
+
+        inline thread_stats &local_stats()
+        {
+            thread_stats *stats = current_stats;
+            return stats != nullptr ? *stats : *register_thread();
+        }
+
+        /// the owner is the only writer, so no locked instruction is needed
+        inline void add(std::atomic<uint64_t> &counter, uint64_t n)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        inline void count_decoded(unsigned major, uint64_t bytes)
+        {
+            thread_stats &stats = local_stats();
+            add(stats.decoded_items[major & 7], 1);
+            add(stats.decoded_bytes[major & 7], bytes);
+        }
+
+        inline void count_string(unsigned major, uint64_t size)
+        {
+            thread_stats &stats = local_stats();
+            add(stats.decoded_bytes[major & 7], size);
+            add(stats.string_sizes[size == 0 ? 0 : 64 - __builtin_clzll(size)], 1);
+        }
+
+        inline void count_encoded(unsigned major, uint64_t bytes, uint64_t items)
+        {
+            thread_stats &stats = local_stats();
+            add(stats.encoded_items[major & 7], items);
+            add(stats.encoded_bytes[major & 7], bytes);
+        }
+
+        inline void count_depth(uint64_t depth)
+        {
+            thread_stats &stats = local_stats();
+            if (depth > stats.max_depth.load(std::memory_order_relaxed))
+                stats.max_depth.store(depth, std::memory_order_relaxed);
+        }
+
+        inline void count_allocation(uint64_t bytes)
+        {
+            thread_stats &stats = local_stats();
+            add(stats.allocations, 1);
+            add(stats.allocated_bytes, bytes);
+        }
+
+        /// records its lifetime as one decoded message
+        class decode_timer {
+        private:
+            std::chrono::steady_clock::time_point _start;
+        public:
+            decode_timer() : _start(std::chrono::steady_clock::now()) {}
+
+            ~decode_timer()
+            {
+                const auto elapsed = std::chrono::steady_clock::now() - _start;
+                local_stats().decode_latency.record(
+                        (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+        };
+    }
+
+#define CBOR_STATS_DECODED(major, bytes) ::cbor::detail::count_decoded(major, bytes)
+#define CBOR_STATS_STRING(major, size) ::cbor::detail::count_string(major, size)
+#define CBOR_STATS_ENCODED(major, bytes) ::cbor::detail::count_encoded(major, bytes, 1)
+#define CBOR_STATS_PAYLOAD(major, size) ::cbor::detail::count_encoded(major, size, 0)
+#define CBOR_STATS_DEPTH(depth) ::cbor::detail::count_depth(depth)
+#define CBOR_STATS_ALLOCATION(bytes) ::cbor::detail::count_allocation(bytes)
+#define CBOR_STATS_DECODE_TIMER() ::cbor::detail::decode_timer cbor_decode_timer_
+#else
+#define CBOR_STATS_DECODED(major, bytes) ((void) 0)
+#define CBOR_STATS_STRING(major, size) ((void) 0)
+#define CBOR_STATS_ENCODED(major, bytes) ((void) 0)
+#define CBOR_STATS_PAYLOAD(major, size) ((void) 0)
+#define CBOR_STATS_DEPTH(depth) ((void) 0)
+#define CBOR_STATS_ALLOCATION(bytes) ((void) 0)
+#define CBOR_STATS_DECODE_TIMER() ((void) 0)
+#endif
+}
@@ -0,0 +1,427 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "tags.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace cbor {
+
+static bool digits(const char *text, int count, int &value)
+{
+    value = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const unsigned digit = (unsigned) (text[i] - '0');
+        if (digit > 9)
+            return false;
+        value = value * 10 + (int) digit;
+    }
+    return true;
+}
+
+static bool leap_year(int64_t year)
+{
+    return year % 4 == 0 and (year % 100 != 0 or year % 400 == 0);
+}
+
+static int days_in_month(int64_t year, int month)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 and leap_year(year) ? 29 : days[month - 1];
+}
+
+// days between 1970-01-01 and a date of the proleptic Gregorian calendar
+static int64_t days_from_civil(int64_t year, int month, int day)
+{
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+static void civil_from_days(int64_t days, int64_t &year, int &month, int &day)
+{
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t day_of_era = days - era * 146097;
+    const int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int64_t mp = (5 * day_of_year + 2) / 153;
+
+    day = (int) (day_of_year - (153 * mp + 2) / 5 + 1);
+    month = (int) (mp < 10 ? mp + 3 : mp - 9);
+    year = year_of_era + era * 400 + (month <= 2);
+}
+
+result<timestamp> parse_rfc3339(const char *text, size_t size)
+{
+    int year, month, day, hour, minute, second;
+    if (size < 20 or
+        not digits(text, 4, year) or text[4] != '-' or
+        not digits(text + 5, 2, month) or text[7] != '-' or
+        not digits(text + 8, 2, day) or
+        (text[10] != 'T' and text[10] != 't' and text[10] != ' ') or
+        not digits(text + 11, 2, hour) or text[13] != ':' or
+        not digits(text + 14, 2, minute) or text[16] != ':' or
+        not digits(text + 17, 2, second))
+        return error_code::invalid_tag_content;
+
+    timestamp value;
+    size_t pos = 19;
+
+    if (text[pos] == '.')
+    {
+        // digits past nanoseconds are dropped
+        const size_t first = ++pos;
+        uint32_t scale = 100000000;
+        while (pos < size and (unsigned) (text[pos] - '0') <= 9)
+        {
+            value.nanoseconds += (uint32_t) (text[pos] - '0') * scale;
+            scale /= 10;
+            pos++;
+        }
+        if (pos == first)
+            return error_code::invalid_tag_content;
+    }
+
+    int offset_hours, offset_minutes;
+    if (pos < size and (text[pos] == 'Z' or text[pos] == 'z'))
+    {
+        pos++;
+    } else if (size - pos >= 6 and (text[pos] == '+' or text[pos] == '-') and
+               digits(text + pos + 1, 2, offset_hours) and text[pos + 3] == ':' and
+               digits(text + pos + 4, 2, offset_minutes) and
+               offset_hours < 24 and offset_minutes < 60)
+    {
+        value.utc_offset = offset_hours * 60 + offset_minutes;
+        if (text[pos] == '-')
+            value.utc_offset = -value.utc_offset;
+        pos += 6;
+    } else
+    {
+        return error_code::invalid_tag_content;
+    }
+
+    // second 60 is a leap second
+    if (pos != size or month < 1 or month > 12 or day < 1 or day > days_in_month(year, month) or
+        hour > 23 or minute > 59 or second > 60)
+        return error_code::invalid_tag_content;
+
+    value.seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second
+                    - (int64_t) value.utc_offset * 60;
+    return value;
+}
+
+std::string format_rfc3339(const timestamp &value)
+{
+    const int64_t local = value.seconds + (int64_t) value.utc_offset * 60;
+    int64_t days = local / 86400;
+    int64_t time = local % 86400;
+    if (time < 0)
+    {
+        time += 86400;
+        days--;
+    }
+
+    int64_t year;
+    int month, day;
+    civil_from_days(days, year, month, day);
+
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), "%04lld-%02d-%02dT%02d:%02d:%02d",
+                          (long long) year, month, day,
+                          (int) (time / 3600), (int) (time / 60 % 60), (int) (time % 60));
+
+    if (value.nanoseconds != 0)
+    {
+        length += snprintf(buffer + length, sizeof(buffer) - length, ".%09u", value.nanoseconds);
+        while (buffer[length - 1] == '0')
+            length--;
+    }
+
+    if (value.utc_offset == 0)
+    {
+        buffer[length++] = 'Z';
+    } else
+    {
+        const int offset = value.utc_offset < 0 ? -value.utc_offset : value.utc_offset;
+        length += snprintf(buffer + length, sizeof(buffer) - length, "%c%02d:%02d",
+                           value.utc_offset < 0 ? '-' : '+', offset / 60, offset % 60);
+    }
+
+    return std::string(buffer, length);
+}
+
+double bignum::to_double() const
+{
+    double value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value = value * 256 + magnitude[i];
+    return negative ? -1 - value : value;
+}
+
+#ifdef __SIZEOF_INT128__
+bool bignum::to_int128(__int128 &value) const
+{
+    size_t first = 0;
+    while (first < size and magnitude[first] == 0)
+        first++;
+    if (size - first > 16)
+        return false;
+
+    unsigned __int128 u = 0;
+    for (size_t i = first; i < size; ++i)
+        u = u << 8 | magnitude[i];
+
+    // -1 - max is the smallest __int128
+    const unsigned __int128 max = ((unsigned __int128) 1 << 127) - 1;
+    if (u > max)
+        return false;
+
+    value = negative ? -1 - (__int128) u : (__int128) u;
+    return true;
+}
+#endif
+
+double decimal::to_double() const
+{
+    const double m = big ? big_mantissa.to_double() : (double) mantissa;
+
+    int e = exponent > 100000 ? 100000 : exponent < -100000 ? -100000 : (int) exponent;
+    return binary ? ldexp(m, e) : m * pow(10.0, e);
+}
+
+static error_code timestamp_item(uint64_t tag, decoder &dec, timestamp &value)
+{
+    auto peeked = dec.try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    const majorType major = peeked.value().major();
+
+    if (tag == tag_datetime)
+    {
+        if (major != majorType::utf8String)
+            return error_code::invalid_tag_content;
+
+        size_t size;
+        auto text = dec.try_read_string(size);
+        if (not text)
+            return text.error();
+
+        auto parsed = parse_rfc3339(text.value(), size);
+        if (not parsed)
+            return parsed.error();
+        value = parsed.value();
+        return error_code::ok;
+    }
+
+    if (major == majorType::unsignedInteger or major == majorType::signedInteger)
+    {
+        auto seconds = dec.try_read_long();
+        if (not seconds)
+            return seconds.error();
+        value.seconds = seconds.value();
+        return error_code::ok;
+    }
+
+    if (major == majorType::floatingPoint)
+    {
+        auto seconds = dec.try_read_double();
+        if (not seconds)
+            return seconds.error();
+
+        const double whole = floor(seconds.value());
+        if (not (whole >= -9.2e18 and whole <= 9.2e18))
+            return error_code::invalid_tag_content;
+
+        value.seconds = (int64_t) whole;
+        value.nanoseconds = (uint32_t) llround((seconds.value() - whole) * 1e9);
+        if (value.nanoseconds == 1000000000)
+        {
+            value.seconds++;
+            value.nanoseconds = 0;
+        }
+        return error_code::ok;
+    }
+
+    return error_code::invalid_tag_content;
+}
+
+static error_code bignum_item(uint64_t tag, decoder &dec, bignum &value)
+{
+    auto peeked = dec.try_peek_type();
+    if (not peeked)
+        return peeked.error();
+    if (peeked.value().major() != majorType::byteString)
+        return error_code::invalid_tag_content;
+
+    size_t size;
+    auto bytes = dec.try_read_string(size);
+    if (not bytes)
+        return bytes.error();
+
+    value.negative = tag == tag_negative_bignum;
+    value.magnitude = (const unsigned char *) bytes.value();
+    value.size = size;
+    return error_code::ok;
+}
+
+static error_code decimal_item(uint64_t tag, decoder &dec, decimal &value)
+{
+    auto length = dec.try_read_array();
+    if (not length)
+        return length.error() == error_code::wrong_type ? error_code::invalid_tag_content : length.error();
+    if (length.value() != 2)
+        return error_code::invalid_tag_content;
+
+    auto exponent = dec.try_read_long();
+    if (not exponent)
+        return exponent.error() == error_code::wrong_type ? error_code::invalid_tag_content : exponent.error();
+
+    value.binary = tag == tag_bigfloat;
+    value.exponent = exponent.value();
+
+    auto peeked = dec.try_peek_type();
+    if (not peeked)
+        return peeked.error();
+
+    switch (peeked.value().major())
+    {
+        case majorType::unsignedInteger:
+        case majorType::signedInteger: {
+            auto mantissa = dec.try_read_long();
+            if (not mantissa)
+                return mantissa.error();
+            value.mantissa = mantissa.value();
+            return error_code::ok;
+        }
+        case majorType::tag: {
+            auto mantissa = try_read_bignum(dec);
+            if (not mantissa)
+                return mantissa.error() == error_code::wrong_type ? error_code::invalid_tag_content : mantissa.error();
+            value.big = true;
+            value.big_mantissa = mantissa.value();
+            return error_code::ok;
+        }
+        default:
+            return error_code::invalid_tag_content;
+    }
+}
+
+/// reads a tag in [first, last] and its item with read_item
+template<typename T>
+static result<T> read_tagged(decoder &dec, uint64_t first, uint64_t last,
+                             error_code (*read_item)(uint64_t, decoder &, T &))
+{
+    const size_t start = dec.offset();
+    auto tag = dec.try_read_tag();
+    if (not tag)
+        return tag.error();
+
+    T value;
+    error_code error = tag.value() < first or tag.value() > last
+                       ? error_code::wrong_type
+                       : read_item(tag.value(), dec, value);
+    if (error != error_code::ok)
+    {
+        dec.rewind(start);
+        return error;
+    }
+    return value;
+}
+
+template<typename T>
+static T checked(result<T> &&value)
+{
+    if (not value)
+        raise(value.error());
+    return value.value();
+}
+
+result<timestamp> try_read_timestamp(decoder &dec)
+{
+    return read_tagged<timestamp>(dec, tag_datetime, tag_epoch, timestamp_item);
+}
+
+timestamp read_timestamp(decoder &dec)
+{
+    return checked(try_read_timestamp(dec));
+}
+
+result<bignum> try_read_bignum(decoder &dec)
+{
+    return read_tagged<bignum>(dec, tag_positive_bignum, tag_negative_bignum, bignum_item);
+}
+
+bignum read_bignum(decoder &dec)
+{
+    return checked(try_read_bignum(dec));
+}
+
+result<decimal> try_read_decimal(decoder &dec)
+{
+    return read_tagged<decimal>(dec, tag_decimal_fraction, tag_bigfloat, decimal_item);
+}
+
+decimal read_decimal(decoder &dec)
+{
+    return checked(try_read_decimal(dec));
+}
+
+error_code timestamp_handler::on_tagged(uint64_t tag, decoder &item)
+{
+    timestamp value;
+    error_code error = timestamp_item(tag, item, value);
+    if (error == error_code::ok)
+        on_timestamp(tag, value);
+    return error;
+}
+
+error_code bignum_handler::on_tagged(uint64_t tag, decoder &item)
+{
+    bignum value;
+    error_code error = bignum_item(tag, item, value);
+    if (error == error_code::ok)
+        on_bignum(value);
+    return error;
+}
+
+error_code decimal_handler::on_tagged(uint64_t tag, decoder &item)
+{
+    decimal value;
+    error_code error = decimal_item(tag, item, value);
+    if (error == error_code::ok)
+        on_decimal(value);
+    return error;
+}
+
+void tag_registry::add(uint64_t tag, tag_handler &handler)
+{
+    _handlers[tag] = &handler;
+    if (tag < 64)
+        _small |= 1ULL << tag;
+}
+
+void tag_registry::remove(uint64_t tag)
+{
+    _handlers.erase(tag);
+    if (tag < 64)
+        _small &= ~(1ULL << tag);
+}
+
+}
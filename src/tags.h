@@ -0,0 +1,145 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "decoder.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace cbor {
+
+    enum : uint64_t
+    {
+        tag_datetime = 0,       //< RFC 3339 text
+        tag_epoch = 1,          //< seconds since 1970 as integer or float
+        tag_positive_bignum = 2,
+        tag_negative_bignum = 3,
+        tag_decimal_fraction = 4,
+        tag_bigfloat = 5
+    };
+
+    struct timestamp
+    {
+        int64_t seconds;        //< since 1970-01-01T00:00:00Z
+        uint32_t nanoseconds;
+        int32_t utc_offset;     //< minutes, as written in a tag 0 string
+
+        timestamp() : seconds(0), nanoseconds(0), utc_offset(0) {}
+    };
+
+    /// view of a tag 2/3 byte string: magnitude for tag 2, -1 - magnitude for tag 3
+    struct bignum
+    {
+        bool negative;
+        const unsigned char *magnitude; //< big endian, points into the input
+        size_t size;
+
+        bignum() : negative(false), magnitude(nullptr), size(0) {}
+
+        /// nearest double
+        double to_double() const;
+
+#ifdef __SIZEOF_INT128__
+        /// false if the value does not fit
+        bool to_int128(__int128 &value) const;
+#endif
+    };
+
+    /// tag 4: mantissa * 10^exponent, tag 5: mantissa * 2^exponent
+    struct decimal
+    {
+        bool binary;
+        int64_t exponent;
+        bool big;               //< the mantissa is big_mantissa
+        int64_t mantissa;
+        bignum big_mantissa;
+
+        decimal() : binary(false), exponent(0), big(false), mantissa(0) {}
+
+        double to_double() const;
+    };
+
+    /// seconds, nanoseconds and offset of YYYY-MM-DDTHH:MM:SS[.frac](Z|+HH:MM|-HH:MM)
+    result<timestamp> parse_rfc3339(const char *text, size_t size);
+
+    /// formats with the given offset, fractions only when nanoseconds is not 0
+    std::string format_rfc3339(const timestamp &value);
+
+    /*
+     * Pull API for the built-in tags. They read the tag and the tagged item,
+     * and leave the decoder where it was on error.
+     */
+    result<timestamp> try_read_timestamp(decoder &dec);     //< tag 0 or 1
+    timestamp read_timestamp(decoder &dec);
+
+    result<bignum> try_read_bignum(decoder &dec);           //< tag 2 or 3
+    bignum read_bignum(decoder &dec);
+
+    result<decimal> try_read_decimal(decoder &dec);         //< tag 4 or 5
+    decimal read_decimal(decoder &dec);
+
+    class tag_handler {
+    public:
+        virtual ~tag_handler() {}
+
+        /// item decodes exactly the tagged item, errors are reported to the listener
+        virtual error_code on_tagged(uint64_t tag, decoder &item) = 0;
+    };
+
+    /// built-in handlers: decode the item and pass on the value
+    class timestamp_handler : public tag_handler {
+    public:
+        error_code on_tagged(uint64_t tag, decoder &item) override;
+        virtual void on_timestamp(uint64_t tag, const timestamp &value) = 0;
+    };
+
+    class bignum_handler : public tag_handler {
+    public:
+        error_code on_tagged(uint64_t tag, decoder &item) override;
+        virtual void on_bignum(const bignum &value) = 0;
+    };
+
+    class decimal_handler : public tag_handler {
+    public:
+        error_code on_tagged(uint64_t tag, decoder &item) override;
+        virtual void on_decimal(const decimal &value) = 0;
+    };
+
+    /**
+     * Handlers by tag number, see decoder::set_tag_registry(). run() hands
+     * a registered tag and its item to the handler in one call instead of
+     * on_tag() followed by the item. Unregistered tags take the usual path.
+     */
+    class tag_registry {
+    private:
+        uint64_t _small; //< bit per registered tag below 64
+        std::unordered_map<uint64_t, tag_handler *> _handlers;
+
+    public:
+        tag_registry() : _small(0) {}
+
+        void add(uint64_t tag, tag_handler &handler);
+        void remove(uint64_t tag);
+
+        tag_handler *find(uint64_t tag) const
+        {
+            if (tag < 64 and (_small >> tag & 1) == 0)
+                return nullptr;
+            auto it = _handlers.find(tag);
+            return it == _handlers.end() ? nullptr : it->second;
+        }
+    };
+}
@@ -14,12 +14,2302 @@
 	   limitations under the License.
 */
 
+#include <fcntl.h>
+#include <locale.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include "cbor.h"
 
 using std::cout;
 
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (not (condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+#ifndef CBOR_NO_EXCEPTIONS
+/// statement raises, checked only where errors are exceptions
+#define CHECK_RAISES(statement) \
+    do { \
+        bool raised = false; \
+        try { statement; } catch (const std::exception &) { raised = true; } \
+        if (not raised) \
+        { \
+            fprintf(stderr, "%s:%d: did not raise: %s\n", __FILE__, __LINE__, #statement); \
+            failures++; \
+        } \
+    } while (0)
+#else
+#define CHECK_RAISES(statement) do { if (false) { statement; } } while (0)
+#endif
+
+/// decoder events as text, "a2 i1 s:foo " and so on
+class recording_listener : public cbor::listener {
+public:
+    std::string events;
+    std::string error;
+
+    void on_integer(int value) override { events += "i" + std::to_string(value) + " "; }
+    void on_bytes(unsigned char *data, int size) override { events += "b" + std::to_string(size) + " "; }
+    void on_string(std::string &str) override { events += "s:" + str + " "; }
+    void on_array(int size) override { events += "a" + std::to_string(size) + " "; }
+    void on_map(int size) override { events += "m" + std::to_string(size) + " "; }
+    void on_tag(unsigned int tag) override { events += "t" + std::to_string(tag) + " "; }
+    void on_special(unsigned int code) override { events += "x" + std::to_string(code) + " "; }
+    void on_bool(bool value) override { events += value ? "true " : "false "; }
+    void on_null() override { events += "null "; }
+    void on_undefined() override { events += "undefined "; }
+    void on_half(float v) override { events += "h" + std::to_string(v) + " "; }
+    void on_float(float v) override { events += "f" + std::to_string(v) + " "; }
+    void on_double(double v) override { events += "d" + std::to_string(v) + " "; }
+    void on_error(const char *message) override { if (error.empty()) error = message; }
+    void on_extra_integer(unsigned long long value, int sign) override
+    {
+        events += (sign < 0 ? "n" : "u") + std::to_string(value) + " ";
+    }
+    void on_extra_tag(unsigned long long tag) override { events += "t" + std::to_string(tag) + " "; }
+    void on_string_chunk(const char *data, size_t size, unsigned long long offset, unsigned long long total) override
+    {
+        events += "c:" + std::string(data, size) + " ";
+    }
+};
+
+/// counts what goes through it to new/delete
+class counting_resource : public cbor::memory_resource {
+public:
+    size_t allocations = 0;
+    size_t deallocations = 0;
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        allocations++;
+        return cbor::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        deallocations++;
+        cbor::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const cbor::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+static std::string run_events(const std::vector<unsigned char> &data, const cbor::decoder_limits &limits,
+                              std::string *error = nullptr, cbor::memory_resource *resource = cbor::get_default_resource(),
+                              const cbor::tag_registry *tags = nullptr)
+{
+    cbor::input input(data.data(), data.size());
+    recording_listener listener;
+    cbor::decoder decoder(input, listener, resource);
+    decoder.set_limits(limits);
+    decoder.set_tag_registry(tags);
+    decoder.run();
+    if (error != nullptr)
+        *error = listener.error;
+    return listener.events;
+}
+
+/// the integer at value, as found by map_index::find()
+static long long map_value(const cbor::map_index &index, const unsigned char *value)
+{
+    cbor::input input(value, index.end() - value);
+    cbor::decoder decoder(input);
+    return decoder.try_read_long().value_or(-1000);
+}
+
+static void test_map_index()
+{
+    // below the threshold a map is scanned, from it on hashed
+    for (int count : {3, 7, 8, 50})
+    {
+        cbor::output_dynamic map;
+        cbor::encoder encoder(map);
+        encoder.write_map(2 * count);
+        for (int i = 0; i < count; ++i)
+        {
+            encoder.write_string("key" + std::to_string(i));
+            encoder.write_int(i * 10);
+            // integer keys, negative ones too, next to the strings
+            encoder.write_int(i - 2);
+            encoder.write_int(-i);
+        }
+
+        cbor::map_index index(map.data(), map.size());
+        CHECK(index.size() == (size_t) (2 * count));
+        const unsigned char *value = index.find(cbor::map_index::key("key" + std::to_string(count - 1)));
+        CHECK(value != nullptr and map_value(index, value) == (count - 1) * 10);
+        CHECK(index.indexed() == (index.size() >= cbor::map_index::default_threshold));
+        CHECK(index.find(cbor::map_index::key("key" + std::to_string(count))) == nullptr);
+        CHECK(index.find(cbor::map_index::key("nope")) == nullptr);
+
+        value = index.find(cbor::map_index::key(-2LL));
+        CHECK(value != nullptr and map_value(index, value) == 0);
+        value = index.find(cbor::map_index::key((long long) count - 3));
+        CHECK(value != nullptr and map_value(index, value) == 1 - count);
+        CHECK(index.find(cbor::map_index::key((long long) count - 2)) == nullptr);
+        // 1.5 slots of 4 bytes per entry, rounded up
+        CHECK(index.indexed() ? index.memory_usage() <= index.size() * 8 : index.memory_usage() == 0);
+    }
+
+    // {"a": 1, "b": 2, "a": 3}: the first of two equal keys wins, scanned or hashed
+    const std::vector<unsigned char> duplicates = {0xa3, 0x61, 'a', 0x01, 0x61, 'b', 0x02, 0x61, 'a', 0x03};
+    for (size_t threshold : {(size_t) 16, (size_t) 1})
+    {
+        cbor::map_index index(duplicates.data(), duplicates.size(), threshold);
+        const unsigned char *value = index.find(cbor::map_index::key("a"));
+        CHECK(value != nullptr and map_value(index, value) == 1);
+        CHECK(index.indexed() == (threshold == 1));
+        value = index.find(cbor::map_index::key("b"));
+        CHECK(value != nullptr and map_value(index, value) == 2);
+    }
+}
+
+/// projected values as "path:hex "
+class recording_projection : public cbor::projection_listener {
+public:
+    std::string values;
+
+    void on_value(size_t path, const unsigned char *data, size_t size) override
+    {
+        static const char digits[] = "0123456789abcdef";
+        values += std::to_string(path) + ":";
+        for (size_t i = 0; i < size; ++i)
+        {
+            values += digits[data[i] >> 4];
+            values += digits[data[i] & 15];
+        }
+        values += " ";
+    }
+};
+
+static void test_projection()
+{
+    // {"meta": {"trace": {"id": "abc"}}, "events": [{"ts": 1}, 100({"ts": 2})], "items": [10, 20, 30], 5: "x"}
+    cbor::output_dynamic doc;
+    cbor::encoder encoder(doc);
+    encoder.write_map(4);
+    encoder.write_string("meta");
+    encoder.write_map(1);
+    encoder.write_string("trace");
+    encoder.write_map(1);
+    encoder.write_string("id");
+    encoder.write_string("abc");
+    encoder.write_string("events");
+    encoder.write_array(2);
+    encoder.write_map(1);
+    encoder.write_string("ts");
+    encoder.write_int(1);
+    encoder.write_tag(100);
+    encoder.write_map(1);
+    encoder.write_string("ts");
+    encoder.write_int(2);
+    encoder.write_string("items");
+    encoder.write_array(3);
+    encoder.write_int(10);
+    encoder.write_int(20);
+    encoder.write_int(30);
+    encoder.write_int(5);
+    encoder.write_string("x");
+
+    cbor::projection paths;
+    CHECK(paths.add("meta.trace.id") == 0);
+    paths.add("events[*].ts");
+    paths.add("items[1]");
+    paths.add("items[*]");
+    paths.add("meta");
+    CHECK(paths.size() == 5);
+
+    recording_projection found;
+    CHECK(paths.try_run(doc.data(), doc.size(), found) == cbor::error_code::ok);
+    CHECK(found.values == "4:a1657472616365a162696463616263 0:63616263 1:01 1:02 3:0a 3:14 2:14 3:181e ");
+
+    // malformed input is an error, not an exception or an abort
+    for (size_t cut = 0; cut < doc.size(); ++cut)
+    {
+        recording_projection partial;
+        CHECK(paths.try_run(doc.data(), cut, partial) != cbor::error_code::ok);
+        CHECK(found.values.compare(0, partial.values.size(), partial.values) == 0);
+    }
+    const unsigned char reserved[] = {0xa1, 0x64, 'm', 'e', 't', 'a', 0x1c};
+    recording_projection none;
+    CHECK(paths.try_run(reserved, sizeof(reserved), none) == cbor::error_code::invalid_additional_info);
+    CHECK(none.values.empty());
+    CHECK_RAISES(paths.run(doc.data(), doc.size() - 1, none));
+}
+
+static void test_long_lengths()
+{
+    cbor::decoder_limits limits;
+
+    // 8-byte heads for every length, with the items after them
+    CHECK(run_events({0x9b, 0, 0, 0, 0, 0, 0, 0, 2, 0x01, 0x02}, limits) == "a2 i1 i2 ");
+    CHECK(run_events({0xbb, 0, 0, 0, 0, 0, 0, 0, 1, 0x61, 'k', 0x05}, limits) == "m1 s:k i5 ");
+    CHECK(run_events({0x7b, 0, 0, 0, 0, 0, 0, 0, 3, 'a', 'b', 'c', 0x7a, 0, 0, 0, 1, 'd'}, limits) == "s:abc s:d ");
+    CHECK(run_events({0x5b, 0, 0, 0, 0, 0, 0, 0, 2, 0xaa, 0xbb, 0x01}, limits) == "b2 i1 ");
+
+    // negative integers are -1 - n at every width; 8-byte ones always go to on_extra_integer()
+    // and the decoder goes on after them
+    CHECK(run_events({0x20, 0x38, 0x63, 0x39, 0x03, 0xe7, 0x3a, 0x7f, 0xff, 0xff, 0xff, 0x01}, limits)
+          == "i-1 i-100 i-1000 i-2147483648 i1 ");
+    CHECK(run_events({0x3b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3b, 0, 0, 0, 0, 0, 0, 0, 0, 0x01}, limits)
+          == "n18446744073709551615 n0 i1 ");
+
+    // counts above INT_MAX go to the extra callbacks, whose defaults report an error
+    std::string error;
+    CHECK(run_events({0x9a, 0x80, 0, 0, 0}, limits, &error) == "" and error == "extra long array");
+    CHECK(run_events({0xbb, 0, 0, 0, 1, 0, 0, 0, 0}, limits, &error) == "" and error == "extra long map");
+
+    class extra_listener : public recording_listener {
+    public:
+        void on_extra_array(unsigned long long size) override { events += "A" + std::to_string(size) + " "; }
+        void on_extra_map(unsigned long long size) override { events += "M" + std::to_string(size) + " "; }
+    };
+    const unsigned char extra[] = {0x82, 0x9a, 0x80, 0, 0, 0, 0xbb, 0, 0, 0, 1, 0, 0, 0, 0, 0x01};
+    cbor::input extra_input(extra, sizeof(extra));
+    extra_listener listener;
+    cbor::decoder extra_decoder(extra_input, listener);
+    extra_decoder.run();
+    CHECK(listener.events == "a2 A2147483648 M4294967296 i1 " and listener.error.empty());
+
+    // and the encoder writes them with 4 and 8 bytes
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    encoder.write_array(0x80000000ull);
+    encoder.write_map(0x100000000ull);
+    const unsigned char heads[] = {0x9a, 0x80, 0, 0, 0, 0xbb, 0, 0, 0, 1, 0, 0, 0, 0};
+    CHECK(encoded.size() == sizeof(heads) and memcmp(encoded.data(), heads, sizeof(heads)) == 0);
+
+    // a failed pull read rewinds the input to where it started
+    const unsigned char text[] = {0x62, 'a', 'b', 0x7b, 0, 0, 0, 0, 0, 0, 0, 9, 'c'};
+    cbor::input input(text, sizeof(text));
+    cbor::decoder decoder(input);
+    CHECK(decoder.try_read_int().error() == cbor::error_code::wrong_type and input.offset() == 0);
+    CHECK(decoder.try_read_string().value() == "ab" and input.offset() == 3);
+    CHECK(decoder.try_read_string().error() == cbor::error_code::truncated and input.offset() == 3);
+    CHECK(input.remaining() == sizeof(text) - 3);
+    input.advance(2);
+    input.rewind(3);
+    CHECK(input.offset() == 3 and input.current() == text + 3);
+}
+
+/// big-endian value of the size bytes at p, one byte at a time
+static uint64_t reference_be(const unsigned char *p, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value = value << 8 | p[i];
+    return value;
+}
+
+static void test_byte_order()
+{
+    // loads and stores at every alignment agree with a bytewise reference
+    std::mt19937_64 random(35);
+    unsigned char buffer[24];
+    for (int round = 0; round < 100; ++round)
+    {
+        for (unsigned char &byte : buffer)
+            byte = (unsigned char) random();
+        for (size_t offset = 0; offset < 8; ++offset)
+        {
+            const unsigned char *p = buffer + offset;
+            CHECK(cbor::load_be16(p) == reference_be(p, 2));
+            CHECK(cbor::load_be32(p) == reference_be(p, 4));
+            CHECK(cbor::load_be64(p) == reference_be(p, 8));
+            CHECK(cbor::load_le16(p) == (uint16_t) (p[0] | p[1] << 8));
+            CHECK(cbor::load_le64(p) == ((uint64_t) cbor::load_le32(p + 4) << 32 | cbor::load_le32(p)));
+
+            const uint64_t value = random();
+            unsigned char stored[8];
+            cbor::store_be16(buffer + 16, (uint16_t) value);
+            CHECK(reference_be(buffer + 16, 2) == (uint16_t) value);
+            cbor::store_be32(buffer + offset + 1, (uint32_t) value);
+            CHECK(reference_be(buffer + offset + 1, 4) == (uint32_t) value);
+            cbor::store_be64(stored, value);
+            CHECK(reference_be(stored, 8) == value and cbor::load_be64(stored) == value);
+        }
+    }
+    const unsigned char bytes[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+    CHECK(cbor::load_be64(bytes) == 0x0102030405060708ull and cbor::load_le32(bytes) == 0x04030201u);
+
+    // the encoder heads and the input reads built on them, at every width
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    encoder.write_int(0x17u);
+    encoder.write_int(0xabu);
+    encoder.write_int(0xabcdu);
+    encoder.write_int(0xabcdef01u);
+    encoder.write_int(0x0123456789abcdefull);
+    encoder.write_int(-0x1235);
+    encoder.write_float(-2.5f);
+    encoder.write_double(0.1);
+    const unsigned char heads[] = {
+        0x17, 0x18, 0xab, 0x19, 0xab, 0xcd, 0x1a, 0xab, 0xcd, 0xef, 0x01,
+        0x1b, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0x39, 0x12, 0x34,
+        0xfa, 0xc0, 0x20, 0x00, 0x00,
+        0xfb, 0x3f, 0xb9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a
+    };
+    CHECK(encoded.size() == sizeof(heads) and memcmp(encoded.data(), heads, sizeof(heads)) == 0);
+
+    cbor::input input(encoded.data(), encoded.size());
+    cbor::decoder decoder(input);
+    CHECK(decoder.try_read_uint().value() == 0x17u and decoder.try_read_uint().value() == 0xabu);
+    CHECK(decoder.try_read_uint().value() == 0xabcdu and decoder.try_read_uint().value() == 0xabcdef01u);
+    CHECK(decoder.try_read_ulong().value() == 0x0123456789abcdefull and decoder.try_read_int().value() == -0x1235);
+    CHECK(decoder.try_read_float().value() == -2.5f and decoder.try_read_double().value() == 0.1);
+    CHECK(input.remaining() == 0);
+}
+
+/// batch events in the format of recording_listener
+class recording_consumer : public cbor::batch_consumer {
+public:
+    std::string events;
+    std::vector<size_t> sizes;
+
+    void on_batch(const cbor::event_batch &batch) override
+    {
+        sizes.push_back(batch.size);
+        for (size_t i = 0; i < batch.size; ++i)
+        {
+            const long long value = batch.value[i];
+            switch (batch.type[i])
+            {
+                case cbor::event_type::integer: events += "i" + std::to_string(value) + " "; break;
+                case cbor::event_type::big_positive: events += "u" + std::to_string((uint64_t) value) + " "; break;
+                case cbor::event_type::big_negative: events += "n" + std::to_string((uint64_t) value) + " "; break;
+                case cbor::event_type::bytes: events += "b" + std::to_string(value) + " "; break;
+                case cbor::event_type::string:
+                    events += "s:" + std::string((const char *) batch.data(i), (size_t) value) + " ";
+                    break;
+                case cbor::event_type::array: events += "a" + std::to_string(value) + " "; break;
+                case cbor::event_type::map: events += "m" + std::to_string(value) + " "; break;
+                case cbor::event_type::tag: events += "t" + std::to_string(value) + " "; break;
+                case cbor::event_type::simple: events += "x" + std::to_string(value) + " "; break;
+                case cbor::event_type::boolean: events += value ? "true " : "false "; break;
+                case cbor::event_type::null: events += "null "; break;
+                case cbor::event_type::undefined: events += "undefined "; break;
+                case cbor::event_type::floating: events += "d" + std::to_string(batch.number[i]) + " "; break;
+            }
+        }
+    }
+};
+
+static void test_batch_decoder()
+{
+    // 2500 events of every kind fill two batches and part of a third
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    for (int i = 0; i < 2500; ++i)
+    {
+        switch (i % 10)
+        {
+            case 0: encoder.write_int(i * 997 - 100000); break;
+            case 1: encoder.write_string("item " + std::to_string(i)); break;
+            case 2: encoder.write_array(i); break;
+            case 3: encoder.write_map(i % 24); break;
+            case 4: encoder.write_tag(i % 300); break;
+            case 5: encoder.write_bool(i % 20 == 5); break;
+            case 6: encoder.write_double(i * 0.125); break;
+            case 7:
+                encoder.write_bytes((const unsigned char *) "\x01\x02\x03", (unsigned) (i % 4));
+                break;
+            case 8: encoder.write_null(); break;
+            default: i % 20 == 9 ? encoder.write_undefined() : encoder.write_special(16);
+        }
+    }
+    encoder.write_int(0xffffffffffffffffull);
+    encoder.write_negative(0x8000000000000000ull);
+    encoder.write_int(-0x7fffffffll - 1);
+    const std::vector<unsigned char> data(encoded.data(), encoded.data() + encoded.size());
+    cbor::decoder_limits limits;
+    const std::string expected = run_events(data, limits);
+
+    cbor::input input(data.data(), data.size());
+    recording_consumer consumer;
+    cbor::batch_decoder decoder(input, consumer);
+    CHECK(decoder.run() == cbor::error_code::ok and input.remaining() == 0);
+    CHECK(consumer.events == expected);
+    CHECK(consumer.sizes == std::vector<size_t>({1024, 1024, 455}));
+
+    // half and single precision are widened
+    const std::vector<unsigned char> floats = {0xf9, 0x3e, 0x00, 0xfa, 0xc0, 0x20, 0x00, 0x00};
+    cbor::input float_input(floats.data(), floats.size());
+    recording_consumer widened;
+    cbor::batch_decoder float_decoder(float_input, widened);
+    CHECK(float_decoder.run() == cbor::error_code::ok);
+    CHECK(widened.events == "d1.500000 d-2.500000 " and widened.sizes == std::vector<size_t>({2}));
+
+    // an input cut inside a string stops before it, the rest continues on the next buffer
+    for (size_t cut : {(size_t) 1, (size_t) 7, data.size() / 2, data.size() - 5})
+    {
+        cbor::input first(data.data(), cut);
+        recording_consumer split;
+        cbor::batch_decoder split_decoder(first, split);
+        const cbor::error_code error = split_decoder.run();
+        CHECK(error == cbor::error_code::ok or error == cbor::error_code::truncated);
+        const size_t done = cut - first.remaining();
+        CHECK((error == cbor::error_code::ok) == (done == cut));
+
+        cbor::input rest(data.data() + done, data.size() - done);
+        split_decoder.set_input(rest);
+        CHECK(split_decoder.run() == cbor::error_code::ok and rest.remaining() == 0);
+        CHECK(split.events == expected);
+    }
+
+    // indefinite lengths and reserved additional info stop the decoder where they are
+    const std::vector<unsigned char> invalid = {0x01, 0x02, 0x9f, 0x03};
+    cbor::input invalid_input(invalid.data(), invalid.size());
+    recording_consumer stopped;
+    cbor::batch_decoder invalid_decoder(invalid_input, stopped);
+    CHECK(invalid_decoder.run() == cbor::error_code::invalid_additional_info);
+    CHECK(stopped.events == "i1 i2 " and invalid_input.remaining() == 2);
+    const std::vector<unsigned char> reserved = {0x1c};
+    cbor::input reserved_input(reserved.data(), reserved.size());
+    cbor::batch_decoder reserved_decoder(reserved_input, stopped);
+    CHECK(reserved_decoder.run() == cbor::error_code::invalid_additional_info and reserved_input.remaining() == 1);
+}
+
+static void test_memory_resource()
+{
+    // the decoder stack, pmr strings, map_index tables and sequence offsets come from the resource given
+    const std::vector<unsigned char> nested = {0x82, 0x81, 0x82, 0x01, 0x02, 0x63, 'a', 'b', 'c'};
+    counting_resource resource;
+    CHECK(run_events(nested, cbor::decoder_limits(), nullptr, &resource) == "a2 a1 a2 i1 i2 s:abc ");
+    CHECK(resource.allocations > 0 and resource.allocations == resource.deallocations);
+
+    std::vector<unsigned char> long_text = {0x78, 40};
+    long_text.resize(2 + 40, 'x');
+    cbor::input input(long_text.data(), long_text.size());
+    cbor::decoder decoder(input, &resource);
+    CHECK(decoder.resource() == &resource);
+    const size_t before = resource.allocations;
+    {
+        // copies take the default resource, like std::pmr, so the string is moved out
+        const cbor::pmr_string value = std::move(decoder.try_read_pmr_string().value());
+        CHECK(std::string(value.data(), value.size()) == std::string(40, 'x') and value.get_allocator().resource() == &resource);
+        CHECK(resource.allocations == before + 1);
+    }
+    CHECK(resource.allocations == resource.deallocations);
+
+    cbor::output_dynamic map;
+    cbor::encoder encoder(map);
+    encoder.write_map(20);
+    for (int i = 0; i < 20; ++i)
+    {
+        encoder.write_int(i);
+        encoder.write_int(i * i);
+    }
+    counting_resource table;
+    {
+        cbor::map_index index(map.data(), map.size(), 4, &table);
+        CHECK(map_value(index, index.find(cbor::map_index::key(7ll))) == 49);
+        CHECK(index.indexed() and table.allocations > 0);
+    }
+    CHECK(table.allocations == table.deallocations);
+
+    counting_resource offsets;
+    cbor::thread_pool pool(2);
+    cbor::sequence_reader reader(map.data() + 1, map.size() - 1, pool, &offsets);
+    CHECK(reader.scan() == 40 and offsets.allocations > 0);
+
+    // the default resource is what decoders get when none is given
+    counting_resource fallback;
+    CHECK(cbor::set_default_resource(&fallback) == cbor::new_delete_resource());
+    CHECK(cbor::get_default_resource() == &fallback);
+    {
+        cbor::input again(nested.data(), nested.size());
+        recording_listener listener;
+        cbor::decoder defaulted(again, listener);
+        CHECK(defaulted.resource() == &fallback);
+        defaulted.run();
+        CHECK(listener.events == "a2 a1 a2 i1 i2 s:abc " and fallback.allocations > 0);
+    }
+    CHECK(cbor::set_default_resource(nullptr) == &fallback);
+    CHECK(cbor::get_default_resource() == cbor::new_delete_resource());
+
+    // an arena serves small requests from its buffer, aligned, and takes blocks upstream after that
+    alignas(16) unsigned char buffer[64];
+    counting_resource upstream;
+    {
+        cbor::monotonic_buffer_resource arena(buffer, sizeof(buffer), &upstream);
+        void *first = arena.allocate(3, 1);
+        void *aligned = arena.allocate(8, 8);
+        CHECK(first == buffer and (uintptr_t) aligned % 8 == 0 and aligned < buffer + sizeof(buffer));
+        arena.deallocate(first, 3, 1);
+        CHECK(upstream.allocations == 0);
+
+        cbor::pmr_vector<int> values(&arena);
+        for (int i = 0; i < 1000; ++i)
+            values.push_back(i);
+        CHECK(values.back() == 999 and upstream.allocations > 0 and upstream.deallocations == 0);
+        values.clear();
+        values.shrink_to_fit();
+        CHECK(upstream.deallocations == 0);
+
+        arena.release();
+        CHECK(upstream.deallocations == upstream.allocations);
+        CHECK(arena.allocate(3, 1) == buffer);
+
+        // the string still fits the buffer
+        const size_t blocks = upstream.allocations;
+        cbor::input arena_input(long_text.data(), long_text.size());
+        cbor::decoder arena_decoder(arena_input, &arena);
+        const cbor::pmr_string in_arena = std::move(arena_decoder.try_read_pmr_string().value());
+        CHECK(in_arena.size() == 40 and upstream.allocations == blocks);
+        CHECK((const unsigned char *) in_arena.data() > buffer and (const unsigned char *) in_arena.data() < buffer + sizeof(buffer));
+    }
+    CHECK(upstream.deallocations == upstream.allocations);
+
+    cbor::polymorphic_allocator<int> a(&resource), b(&resource), c(&table);
+    CHECK(a == b and a != c and cbor::polymorphic_allocator<char>(a) == b);
+}
+
+static void test_key_table()
+{
+    // every key finds its own position, near misses find nothing
+    for (size_t count : {(size_t) 0, (size_t) 1, (size_t) 5, (size_t) 100, (size_t) 2000})
+    {
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < count; ++i)
+            keys.push_back(i % 3 == 0 ? "field_" + std::to_string(i) : std::string(i % 7, 'k') + std::to_string(i * 31));
+        const cbor::key_table table(keys);
+        CHECK(table.size() == count);
+
+        // near misses can be other keys, "field_3" is a prefix of "field_30"
+        auto position = [&keys](const std::string &key) {
+            const auto found = std::find(keys.begin(), keys.end(), key);
+            return found == keys.end() ? cbor::key_table::npos : (int) (found - keys.begin());
+        };
+        bool found = true;
+        for (size_t i = 0; i < count; ++i)
+        {
+            found = found and table.find(keys[i]) == (int) i and table.name((int) i) == keys[i];
+            found = found and table.find(keys[i] + "x") == position(keys[i] + "x");
+            found = found and table.find(keys[i].data(), keys[i].size() - 1) == position(keys[i].substr(0, keys[i].size() - 1));
+        }
+        CHECK(found);
+        CHECK(table.find("") == cbor::key_table::npos and table.find("missing") == cbor::key_table::npos);
+        CHECK(table.memory_usage() >= count * sizeof(int32_t));
+    }
+
+    const cbor::key_table odd({"", "a", std::string("a\0b", 3), "\xc3\xa9t\xc3\xa9"});
+    CHECK(odd.find("") == 0 and odd.find("a") == 1 and odd.find(std::string("a\0b", 3)) == 2);
+    CHECK(odd.find("\xc3\xa9t\xc3\xa9") == 3 and odd.find("a\0c", 3) == cbor::key_table::npos);
+    CHECK_RAISES(cbor::key_table({"id", "name", "id"}));
+
+    // the decoder interns keys as it reads them, other items are left where they are
+    const cbor::key_table table({"id", "name", "tags"});
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    encoder.write_map(4);
+    encoder.write_string("name");
+    encoder.write_string("cbor");
+    encoder.write_string("other");
+    encoder.write_null();
+    encoder.write_string("id");
+    encoder.write_int(7);
+    encoder.write_int(1);
+    encoder.write_int(2);
+    cbor::input input(encoded.data(), encoded.size());
+    cbor::decoder decoder(input);
+    CHECK(decoder.try_read_map().value() == 4);
+    CHECK(decoder.try_read_key(table).value() == 1 and decoder.try_read_string().value() == "cbor");
+    CHECK(decoder.try_read_key(table).value() == cbor::key_table::npos and decoder.try_skip() == cbor::error_code::ok);
+    CHECK(decoder.read_key(table) == 0 and decoder.try_read_int().value() == 7);
+    const size_t offset = decoder.offset();
+    CHECK(decoder.try_read_key(table).error() == cbor::error_code::wrong_type and decoder.offset() == offset);
+    CHECK_RAISES(decoder.read_key(table));
+}
+
+static void test_limits()
+{
+    // each limit trips on the declared size, before anything is allocated or waited for
+    {
+        const std::vector<unsigned char> text = {0x7b, 0, 0, 1, 0, 0, 0, 0, 0};    // 2^40 byte text string
+        cbor::decoder_limits limits;
+        limits.max_string_length = 1024;
+
+        counting_resource resource;
+        std::string error;
+        run_events(text, limits, &error, &resource);
+        CHECK(error == "string too long");
+        CHECK(resource.allocations == 0);
+
+        cbor::input input(text.data(), text.size());
+        cbor::decoder decoder(input, &resource);
+        decoder.set_limits(limits);
+        CHECK(decoder.try_read_string().error() == cbor::error_code::size_limit);
+        CHECK(decoder.try_skip() == cbor::error_code::size_limit);
+        CHECK(decoder.offset() == 0);
+        CHECK(decoder.allocated() == 0 and resource.allocations == 0);
+    }
+    {
+        const std::vector<unsigned char> text = {0x6b, 'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd'};
+        cbor::decoder_limits limits;
+        limits.allocation_budget = 4;
+
+        std::string error;
+        run_events(text, limits, &error);
+        CHECK(error == "allocation budget exceeded");
+
+        cbor::input input(text.data(), text.size());
+        cbor::decoder decoder(input);
+        decoder.set_limits(limits);
+        CHECK(decoder.try_read_string().error() == cbor::error_code::allocation_limit);
+        CHECK(decoder.try_read_pmr_string().error() == cbor::error_code::allocation_limit);
+        CHECK(decoder.allocated() == 0 and decoder.offset() == 0);
+
+        limits.allocation_budget = 11;
+        decoder.set_limits(limits);
+        CHECK(decoder.try_read_string().value() == "hello world");
+        CHECK(decoder.allocated() == 11);
+    }
+    {
+        const std::vector<unsigned char> array = {0x9b, 0, 0, 1, 0, 0, 0, 0, 0};   // 2^40 elements
+        const std::vector<unsigned char> map = {0xbb, 0, 0, 1, 0, 0, 0, 0, 0};
+        cbor::decoder_limits limits;
+        limits.max_container_size = 1000;
+
+        counting_resource resource;
+        std::string error;
+        run_events(array, limits, &error, &resource);
+        CHECK(error == "array too large");
+        run_events(map, limits, &error, &resource);
+        CHECK(error == "map too large");
+        CHECK(resource.allocations == 0);
+
+        cbor::input input(array.data(), array.size());
+        cbor::decoder decoder(input);
+        decoder.set_limits(limits);
+        CHECK(decoder.try_read_array().error() == cbor::error_code::size_limit);
+        CHECK(decoder.try_skip() == cbor::error_code::size_limit);
+        CHECK(decoder.offset() == 0);
+    }
+    {
+        // pull API: more elements declared than bytes left
+        const std::vector<unsigned char> array = {0x8a, 1, 2};
+        cbor::input input(array.data(), array.size());
+        cbor::decoder decoder(input);
+        CHECK(decoder.try_read_array().error() == cbor::error_code::truncated);
+        cbor::decoder_limits limits;
+        limits.container_fits_input = false;
+        decoder.set_limits(limits);
+        CHECK(decoder.try_read_array().value() == 10);
+    }
+    {
+        // arrays and tags both count towards max_depth, on both paths
+        cbor::decoder_limits limits;
+        limits.max_depth = 4;
+        const std::vector<unsigned char> arrays4 = {0x81, 0x81, 0x81, 0x81, 0x01};
+        const std::vector<unsigned char> arrays5 = {0x81, 0x81, 0x81, 0x81, 0x81, 0x01};
+        const std::vector<unsigned char> tags4 = {0xc6, 0xc6, 0xd8, 100, 0xc6, 0x01};
+        const std::vector<unsigned char> tags5 = {0xc6, 0xc6, 0xd8, 100, 0xc6, 0x81, 0x01};
+
+        for (const auto *data : {&arrays4, &arrays5, &tags4, &tags5})
+        {
+            const bool deep = data == &arrays5 or data == &tags5;
+            std::string error;
+            run_events(*data, limits, &error);
+            CHECK(error == (deep ? "nesting too deep" : ""));
+
+            cbor::input input(data->data(), data->size());
+            cbor::decoder decoder(input);
+            decoder.set_limits(limits);
+            CHECK(decoder.try_skip() == (deep ? cbor::error_code::depth_limit : cbor::error_code::ok));
+        }
+
+        // a tagged item completes the container around it
+        CHECK(run_events({0x82, 0xc1, 0x01, 0x02}, cbor::decoder_limits()) == "a2 t1 i1 i2 ");
+    }
+    {
+        // registered tags share the allocation budget with the rest of the input
+        class string_handler : public cbor::tag_handler {
+        public:
+            std::string strings;
+
+            cbor::error_code on_tagged(uint64_t tag, cbor::decoder &item) override
+            {
+                auto str = item.try_read_string();
+                if (not str)
+                    return str.error();
+                strings += str.value() + " ";
+                return cbor::error_code::ok;
+            }
+        } handler;
+        cbor::tag_registry tags;
+        tags.add(7, handler);
+
+        // ["abc", 7("hello"), 7("world!")]
+        const std::vector<unsigned char> data = {0x83, 0x63, 'a', 'b', 'c', 0xc7, 0x65, 'h', 'e', 'l', 'l', 'o',
+                                                 0xc7, 0x66, 'w', 'o', 'r', 'l', 'd', '!'};
+        cbor::decoder_limits limits;
+        limits.allocation_budget = 13;
+        std::string error;
+        CHECK(run_events(data, limits, &error, cbor::get_default_resource(), &tags) == "a3 s:abc ");
+        CHECK(handler.strings == "hello " and error == cbor::to_string(cbor::error_code::allocation_limit));
+
+        handler.strings.clear();
+        limits.allocation_budget = 6;
+        run_events(data, limits, &error, cbor::get_default_resource(), &tags);
+        CHECK(handler.strings.empty() and error == cbor::to_string(cbor::error_code::allocation_limit));
+
+        handler.strings.clear();
+        limits.allocation_budget = 14;
+        run_events(data, limits, &error, cbor::get_default_resource(), &tags);
+        CHECK(handler.strings == "hello world! " and error.empty());
+
+        // the decoder counts what its tags allocated
+        cbor::input input(data.data(), data.size());
+        recording_listener listener;
+        cbor::decoder decoder(input, listener);
+        decoder.set_tag_registry(&tags);
+        decoder.run();
+        CHECK(decoder.allocated() == 14);
+    }
+}
+
+/// feeds data to run() in pieces of size bytes, carrying over what run() left, as set_input() describes
+static std::string run_split(const std::vector<unsigned char> &data, size_t size, cbor::decoder_limits limits,
+                             const cbor::tag_registry *tags = nullptr)
+{
+    recording_listener listener;
+    std::vector<unsigned char> buffer;
+    cbor::input empty(buffer.data(), 0);
+    cbor::decoder decoder(empty, listener);
+    decoder.set_limits(limits);
+    decoder.set_tag_registry(tags);
+
+    for (size_t offset = 0; offset < data.size(); offset += size)
+    {
+        const size_t end = offset + size < data.size() ? offset + size : data.size();
+        buffer.insert(buffer.end(), data.begin() + offset, data.begin() + end);
+        cbor::input input(buffer.data(), buffer.size());
+        decoder.set_input(input);
+        decoder.run();
+        buffer.erase(buffer.begin(), buffer.begin() + (buffer.size() - input.remaining()));
+    }
+    CHECK(buffer.empty());
+    return listener.events + listener.error;
+}
+
+static void test_set_input()
+{
+    cbor::output_dynamic output;
+    cbor::encoder encoder(output);
+    encoder.write_array(3);
+    encoder.write_string("a string waits until it is complete");
+    encoder.write_tag(1);
+    encoder.write_int(1500000000);
+    encoder.write_int(-70000);
+    const std::vector<unsigned char> data(output.data(), output.data() + output.size());
+
+    const std::string whole = run_split(data, data.size(), cbor::decoder_limits());
+    CHECK(whole == "a3 s:a string waits until it is complete t1 i1500000000 i-70000 ");
+    for (size_t size = 1; size < data.size(); ++size)
+        CHECK(run_split(data, size, cbor::decoder_limits()) == whole);
+
+    // a registered tag waits for its whole item
+    class counting_handler : public cbor::tag_handler {
+    public:
+        int calls = 0;
+
+        cbor::error_code on_tagged(uint64_t tag, cbor::decoder &item) override
+        {
+            calls++;
+            return item.try_skip();
+        }
+    } handler;
+    cbor::tag_registry tags;
+    tags.add(1, handler);
+    for (size_t size = 1; size <= data.size(); ++size)
+    {
+        handler.calls = 0;
+        CHECK(run_split(data, size, cbor::decoder_limits(), &tags) ==
+              "a3 s:a string waits until it is complete i-70000 ");
+        CHECK(handler.calls == 1);
+    }
+}
+
+/// records registered tags and skips their item
+class recording_tag_handler : public cbor::tag_handler {
+public:
+    std::string events;
+
+    cbor::error_code on_tagged(uint64_t tag, cbor::decoder &item) override
+    {
+        const size_t start = item.offset();
+        const cbor::error_code error = item.try_skip();
+        events += "T" + std::to_string(tag) + ":" + std::to_string(item.offset() - start) + " ";
+        return error;
+    }
+};
+
+static void test_tag_registry()
+{
+    recording_tag_handler handler;
+    cbor::tag_registry tags;
+    tags.add(7, handler);
+    tags.add(100000, handler);
+
+    // tag(5) 1, tag(7) [1, 2], tag(100000) "ab", 8 byte head tag(6) 3, tag(7) [[1]]
+    const std::vector<unsigned char> data = {
+            0x85, 0xc5, 0x01, 0xc7, 0x82, 0x01, 0x02, 0xda, 0x00, 0x01, 0x86, 0xa0, 0x62, 'a', 'b',
+            0xdb, 0, 0, 0, 0, 0, 0, 0, 6, 0x03, 0xc7, 0x81, 0x81, 0x01};
+
+    cbor::input input(data.data(), data.size());
+    recording_listener listener;
+    cbor::decoder decoder(input, listener);
+    decoder.set_tag_registry(&tags);
+    decoder.run();
+    CHECK(listener.events == "a5 t5 i1 t6 i3 ");
+    CHECK(handler.events == "T7:3 T100000:3 T7:3 ");
+    CHECK(listener.error.empty() and input.remaining() == 0);
+
+    // a registered tag is a level of nesting too, its item gets the rest of max_depth
+    cbor::memory_resource *resource = cbor::get_default_resource();
+    const std::vector<unsigned char> deep = {0x81, 0xc7, 0x81, 0x81, 0x01};
+    cbor::decoder_limits limits;
+    limits.max_depth = 4;
+    handler.events.clear();
+    std::string error;
+    run_events(deep, limits, &error, resource, &tags);
+    CHECK(handler.events == "T7:3 " and error.empty());
+    limits.max_depth = 3;
+    run_events(deep, limits, &error, resource, &tags);
+    CHECK(error == cbor::to_string(cbor::error_code::depth_limit));
+    run_events({0x81, 0x81, 0xc7, 0x01}, limits, &error, resource, &tags);
+    CHECK(error.empty());
+    run_events({0x81, 0x81, 0x81, 0xc7, 0x01}, limits, &error, resource, &tags);
+    CHECK(error == "nesting too deep");
+}
+
+/// byte by byte UTF-8 check after RFC 3629, the reference for is_valid_utf8()
+static bool reference_utf8(const unsigned char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        const unsigned char lead = data[i];
+        if (lead < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        size_t length;
+        uint32_t code, min;
+        if ((lead & 0xe0) == 0xc0)
+            length = 2, code = lead & 0x1f, min = 0x80;
+        else if ((lead & 0xf0) == 0xe0)
+            length = 3, code = lead & 0x0f, min = 0x800;
+        else if ((lead & 0xf8) == 0xf0)
+            length = 4, code = lead & 0x07, min = 0x10000;
+        else
+            return false;
+
+        if (size - i < length)
+            return false;
+        for (size_t k = 1; k < length; ++k)
+        {
+            if ((data[i + k] & 0xc0) != 0x80)
+                return false;
+            code = code << 6 | (data[i + k] & 0x3f);
+        }
+        if (code < min or code > 0x10ffff or (code >= 0xd800 and code <= 0xdfff))
+            return false;
+        i += length;
+    }
+    return true;
+}
+
+static bool valid_utf8(const std::string &text)
+{
+    return cbor::is_valid_utf8(text.data(), text.size());
+}
+
+/// every way of cutting text into two and three chunks agrees with the reference
+static void check_utf8_chunks(const std::string &text)
+{
+    const bool expected = reference_utf8((const unsigned char *) text.data(), text.size());
+    for (size_t cut = 0; cut <= text.size(); ++cut)
+    {
+        cbor::utf8_validator validator;
+        validator.update(text.data(), cut);
+        validator.update(text.data() + cut, text.size() - cut);
+        CHECK(validator.finish() == expected);
+
+        for (size_t second = cut; second <= text.size() and text.size() <= 24; ++second)
+        {
+            cbor::utf8_validator three;
+            three.update(text.data(), cut);
+            three.update(text.data() + cut, second - cut);
+            three.update(text.data() + second, text.size() - second);
+            CHECK(three.finish() == expected);
+        }
+    }
+}
+
+static void test_utf8()
+{
+    const std::string padding(40, 'x');
+    const std::vector<std::pair<std::string, bool>> cases = {
+            {"\xc2\x80", true}, {"\xdf\xbf", true}, {"\xe0\xa0\x80", true}, {"\xed\x9f\xbf", true},
+            {"\xee\x80\x80", true}, {"\xef\xbf\xbf", true}, {"\xf0\x90\x80\x80", true},
+            {"\xf4\x8f\xbf\xbf", true},
+            // overlong forms
+            {"\xc0\x80", false}, {"\xc1\xbf", false}, {"\xe0\x80\x80", false}, {"\xe0\x9f\xbf", false},
+            {"\xf0\x80\x80\x80", false}, {"\xf0\x8f\xbf\xbf", false},
+            // surrogates
+            {"\xed\xa0\x80", false}, {"\xed\xaf\xbf", false}, {"\xed\xb0\x80", false}, {"\xed\xbf\xbf", false},
+            // past U+10FFFF, bad leads, stray and missing continuations
+            {"\xf4\x90\x80\x80", false}, {"\xf5\x80\x80\x80", false}, {"\xf8\x88\x80\x80\x80", false},
+            {"\xff", false}, {"\x80", false}, {"\xc2", false}, {"\xe0\xa0", false}, {"\xf0\x90\x80", false},
+            {"\xc2\x41", false}, {"\xe0\xa0\xc0", false},
+    };
+    for (const auto &c : cases)
+    {
+        CHECK(reference_utf8((const unsigned char *) c.first.data(), c.first.size()) == c.second);
+        CHECK(valid_utf8(c.first) == c.second);
+        // at every offset of a block, and across the block boundaries of the SIMD path
+        for (size_t at = 0; at <= 33; ++at)
+            CHECK(valid_utf8(padding.substr(0, at) + c.first + padding) == c.second);
+        check_utf8_chunks(c.first);
+        check_utf8_chunks("ab" + c.first + "\xc3\xa9");
+    }
+
+    // every two and three byte sequence, placed across a 16 byte boundary
+    std::string text = padding;
+    for (unsigned a = 0x80; a < 0x100; ++a)
+    {
+        for (unsigned b = 0; b < 0x100; ++b)
+        {
+            text[14] = (char) a;
+            text[15] = (char) b;
+            text[16] = 'x';
+            const unsigned char *bytes = (const unsigned char *) text.data();
+            CHECK(valid_utf8(text) == reference_utf8(bytes, text.size()));
+            if (a < 0xe0 or a > 0xef)
+                continue;
+            for (unsigned c = 0x80; c < 0xc0; ++c)
+            {
+                text[16] = (char) c;
+                if (valid_utf8(text) != reference_utf8(bytes, text.size()))
+                {
+                    CHECK(false);
+                    break;
+                }
+            }
+        }
+    }
+
+    // random mixes of code points with the odd byte broken, against the reference
+    std::mt19937 random(36);
+    const uint32_t ranges[][2] = {{0x20, 0x7f}, {0x80, 0x7ff}, {0x800, 0xd7ff}, {0xe000, 0xffff}, {0x10000, 0x10ffff}};
+    for (int round = 0; round < 20000; ++round)
+    {
+        std::string sample;
+        const size_t code_points = random() % 80;
+        for (size_t i = 0; i < code_points; ++i)
+        {
+            const uint32_t *range = ranges[random() % 5];
+            const uint32_t code = range[0] + random() % (range[1] - range[0] + 1);
+            if (code < 0x80)
+            {
+                sample += (char) code;
+            } else if (code < 0x800)
+            {
+                sample += (char) (0xc0 | code >> 6);
+                sample += (char) (0x80 | (code & 0x3f));
+            } else if (code < 0x10000)
+            {
+                sample += (char) (0xe0 | code >> 12);
+                sample += (char) (0x80 | (code >> 6 & 0x3f));
+                sample += (char) (0x80 | (code & 0x3f));
+            } else
+            {
+                sample += (char) (0xf0 | code >> 18);
+                sample += (char) (0x80 | (code >> 12 & 0x3f));
+                sample += (char) (0x80 | (code >> 6 & 0x3f));
+                sample += (char) (0x80 | (code & 0x3f));
+            }
+        }
+        if (not sample.empty() and random() % 2 == 0)
+            sample[random() % sample.size()] = (char) random();
+        if (not sample.empty() and random() % 8 == 0)
+            sample.resize(random() % sample.size());
+
+        const bool expected = reference_utf8((const unsigned char *) sample.data(), sample.size());
+        CHECK(valid_utf8(sample) == expected);
+        if (round % 50 == 0)
+            check_utf8_chunks(sample);
+    }
+
+    // through the decoder: whole strings and ones streamed in chunks
+    for (const auto &c : cases)
+    {
+        const std::string value = padding + c.first;
+        cbor::output_dynamic output;
+        cbor::encoder encoder(output);
+        encoder.write_string(value);
+        const std::vector<unsigned char> data(output.data(), output.data() + output.size());
+
+        for (uint64_t threshold : {0, 8})
+        {
+            for (size_t size = 1; size <= data.size(); size += 7)
+            {
+                recording_listener listener;
+                std::vector<unsigned char> buffer;
+                cbor::input empty(buffer.data(), 0);
+                cbor::decoder decoder(empty, listener);
+                decoder.set_validate_utf8(true);
+                decoder.set_chunk_threshold(threshold);
+                for (size_t offset = 0; offset < data.size(); offset += size)
+                {
+                    const size_t end = offset + size < data.size() ? offset + size : data.size();
+                    buffer.insert(buffer.end(), data.begin() + offset, data.begin() + end);
+                    cbor::input input(buffer.data(), buffer.size());
+                    decoder.set_input(input);
+                    decoder.run();
+                    buffer.erase(buffer.begin(), buffer.begin() + (buffer.size() - input.remaining()));
+                }
+                CHECK(listener.error.empty() == c.second);
+            }
+        }
+
+        cbor::input input(data.data(), data.size());
+        cbor::decoder decoder(input);
+        decoder.set_validate_utf8(true);
+        CHECK((decoder.try_read_string().error() == cbor::error_code::ok) == c.second);
+    }
+}
+
+/// significant digits of a formatted number, "1.25e-7" has 3
+static int significant_digits(const char *text)
+{
+    std::string digits;
+    for (const char *c = text; *c != 0 and *c != 'e'; ++c)
+    {
+        if (*c >= '0' and *c <= '9')
+            digits += *c;
+    }
+    digits.erase(0, digits.find_first_not_of('0'));
+    digits.erase(digits.find_last_not_of('0') + 1);
+    return digits.empty() ? 1 : (int) digits.size();
+}
+
+/// fewest significant digits printf needs for value to read back
+static int shortest_digits(double value)
+{
+    char text[40];
+    for (int precision = 1; precision < 17; ++precision)
+    {
+        snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+        if (strtod(text, nullptr) == value)
+            return precision;
+    }
+    return 17;
+}
+
+static std::string json_of(const cbor::output_dynamic &encoded)
+{
+    cbor::output_dynamic text;
+    cbor::input input(encoded.data(), encoded.size());
+    cbor::listener_json listener(text);
+    cbor::decoder decoder(input, listener);
+    decoder.run();
+    listener.flush();
+    return std::string((const char *) text.data(), text.size());
+}
+
+static std::string diag_of(const cbor::output_dynamic &encoded)
+{
+    cbor::output_dynamic text;
+    cbor::input input(encoded.data(), encoded.size());
+    cbor::listener_diag listener(text);
+    cbor::decoder decoder(input, listener);
+    decoder.run();
+    listener.flush();
+    return std::string((const char *) text.data(), text.size());
+}
+
+static void test_dtoa()
+{
+    char text[32];
+    int longer = 0, checked = 0;
+    auto check_double = [&](double value) {
+        const size_t size = cbor::format_double(value, text);
+        CHECK(size < sizeof(text));
+        text[size] = 0;
+        // reads back exactly and as a float, not an integer
+        CHECK(strtod(text, nullptr) == value and signbit(strtod(text, nullptr)) == signbit(value));
+        CHECK(strpbrk(text, ".e") != nullptr);
+        const int digits = significant_digits(text);
+        CHECK(digits <= 17);
+        longer += digits > shortest_digits(value);
+        checked++;
+    };
+
+    CHECK(std::string(text, cbor::format_double(0.0, text)) == "0.0");
+    CHECK(std::string(text, cbor::format_double(-0.0, text)) == "-0.0");
+    CHECK(std::string(text, cbor::format_double(1.5, text)) == "1.5");
+    CHECK(std::string(text, cbor::format_double(100.0, text)) == "100.0");
+    CHECK(std::string(text, cbor::format_double(0.1, text)) == "0.1");
+    CHECK(std::string(text, cbor::format_double(5e-324, text)) == "5e-324");
+    CHECK(std::string(text, cbor::format_double(1.7976931348623157e308, text)) == "1.7976931348623157e+308");
+
+    for (double value : {0.0, -0.0, 1.0, -1.0, 0.1, 1e23, 9007199254740993.0, 5e-324, -5e-324,
+                         2.2250738585072009e-308, 2.2250738585072014e-308, 1.7976931348623157e308, 123456789012345680.0})
+        check_double(value);
+
+    // powers of two and ten, where the neighbours are unevenly spaced
+    for (int exponent = -1074; exponent <= 1023; ++exponent)
+        check_double(ldexp(1.0, exponent));
+    for (int exponent = -323; exponent <= 308; ++exponent)
+        check_double(strtod(("1e" + std::to_string(exponent)).c_str(), nullptr));
+
+    std::mt19937_64 random(41);
+    for (int round = 0; round < 200000; ++round)
+    {
+        uint64_t bits = random();
+        // every fifth one subnormal
+        if (round % 5 == 0)
+            bits &= 0x800fffffffffffffULL;
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (isfinite(value))
+            check_double(value);
+    }
+    // Grisu2 is shortest for all but a few inputs, those whose shortest form lies on the boundary
+    CHECK(longer * 1000 < checked);
+
+    for (int round = 0; round < 100000; ++round)
+    {
+        const uint32_t bits = (uint32_t) random();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (not isfinite(value))
+            continue;
+        const size_t size = cbor::format_float(value, text);
+        text[size] = 0;
+        CHECK(strtof(text, nullptr) == value);
+    }
+
+    // infinities and NaN are up to the callers
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    encoder.write_array(5);
+    encoder.write_double(INFINITY);
+    encoder.write_double(-INFINITY);
+    encoder.write_double(NAN);
+    encoder.write_float(-0.0f);
+    encoder.write_double(5e-324);
+    CHECK(json_of(encoded) == "[null,null,null,-0.0,5e-324]\n");
+    CHECK(diag_of(encoded) == "[Infinity_3, -Infinity_3, NaN_3, -0.0_2, 5e-324_3]\n");
+}
+
+static std::string json_to_cbor(const char *text)
+{
+    cbor::output_dynamic encoded;
+    cbor::encoder encoder(encoded);
+    cbor::json_reader reader;
+    CHECK(reader.try_convert(text, strlen(text), encoder) == cbor::error_code::ok);
+    return std::string((const char *) encoded.data(), encoded.size());
+}
+
+/// data as JSON text, or the listener's error
+static std::string json_text(const std::vector<unsigned char> &data,
+                             const cbor::json_options &options = cbor::json_options())
+{
+    cbor::output_dynamic text;
+    cbor::input input(data.data(), data.size());
+    cbor::listener_json listener(text, options);
+    cbor::decoder decoder(input, listener);
+    decoder.run();
+    listener.flush();
+    if (listener.failed())
+        return "error: " + listener.error();
+    return std::string((const char *) text.data(), text.size());
+}
+
+static void test_json_output()
+{
+    // quotes, backslashes and control characters are escaped, UTF-8 and '/' are not
+    CHECK(json_text({0x68, 'a', '"', '\\', '\n', 0x01, 0x1f, 0xc3, 0xa9}) == "\"a\\\"\\\\\\n\\u0001\\u001f\xc3\xa9\"\n");
+    CHECK(json_text({0x64, '\b', '\t', '\f', '\r'}) == "\"\\b\\t\\f\\r\"\n");
+    CHECK(json_text({0x63, '/', 0x7f, ' '}) == "\"/\x7f \"\n");
+    cbor::output_dynamic long_text;
+    cbor::encoder encoder(long_text);
+    encoder.write_string(std::string(20, 'x') + "\"" + std::string(20, 'y') + "\x02");
+    CHECK(json_of(long_text) == "\"" + std::string(20, 'x') + "\\\"" + std::string(20, 'y') + "\\u0002\"\n");
+
+    // byte strings are unpadded base64url
+    CHECK(json_text({0x85, 0x40, 0x41, 0xff, 0x42, 0xff, 0xfe, 0x43, 0, 1, 2, 0x44, 0xfb, 0xff, 0xbf, 0x03}) ==
+          "[\"\",\"_w\",\"__4\",\"AAEC\",\"-_-_Aw\"]\n");
+
+    // keys that are not strings are written as strings, or rejected
+    const std::vector<unsigned char> keys = {0xa5, 0x01, 0x02, 0xf5, 0xf6, 0xf6, 0xf9, 0x3e, 0x00, 0x22, 0x61, 'x',
+                                             0xf9, 0x3e, 0x00, 0x01};
+    CHECK(json_text(keys) == "{\"1\":2,\"true\":null,\"null\":1.5,\"-3\":\"x\",\"1.5\":1}\n");
+    cbor::json_options strict;
+    strict.stringify_keys = false;
+    CHECK(json_text(keys, strict) == "error: map key is not a string");
+    CHECK(json_text({0xa1, 0x80, 0x01}) == "error: map key is a container");
+
+    // NaN and infinities have no JSON form
+    CHECK(json_text({0x85, 0xf9, 0x7e, 0x00, 0xf9, 0x7c, 0x00, 0xfa, 0xff, 0x80, 0, 0,
+                     0xfb, 0x7f, 0xf8, 0, 0, 0, 0, 0, 1, 0xfb, 0x7f, 0xf0, 0, 0, 0, 0, 0, 0}) ==
+          "[null,null,null,null,null]\n");
+
+    // {"a": 1(2(3)), "b": 4}, tags dropped or wrapped
+    const std::vector<unsigned char> tagged = {0xa2, 0x61, 'a', 0xc1, 0xc2, 0x03, 0x61, 'b', 0x04};
+    CHECK(json_text(tagged) == "{\"a\":3,\"b\":4}\n");
+    cbor::json_options wrapped;
+    wrapped.wrap_tags = true;
+    CHECK(json_text(tagged, wrapped) == "{\"a\":{\"tag\":1,\"value\":{\"tag\":2,\"value\":3}},\"b\":4}\n");
+    CHECK(json_text({0x82, 0xc1, 0xc2, 0x03, 0xc3, 0x80}, wrapped) ==
+          "[{\"tag\":1,\"value\":{\"tag\":2,\"value\":3}},{\"tag\":3,\"value\":[]}]\n");
+
+    // {1(2(5)): 2}: the tagged key stays a key through both tags
+    const std::vector<unsigned char> tagged_key = {0xa1, 0xc1, 0xc2, 0x05, 0x02};
+    CHECK(json_text(tagged_key) == "{\"5\":2}\n");
+    CHECK(json_text(tagged_key, wrapped) == "error: tagged map key");
+    cbor::output_dynamic key_diag;
+    key_diag.put_bytes(tagged_key.data(), (int) tagged_key.size());
+    CHECK(diag_of(key_diag) == "{1(2(5)): 2}\n");
+
+    // listener_json fails at the tag already, a listener that takes tagged keys sees the item as a key
+    class key_marking_diag : public cbor::listener_diag {
+    public:
+        explicit key_marking_diag(cbor::output &out) : listener_diag(out) {}
+
+    protected:
+        void scalar(const char *text, size_t size) override
+        {
+            if (not begin_item())
+                return;
+            if (_key)
+                put('K');
+            put(text, size);
+            end_item();
+        }
+    };
+    cbor::output_dynamic marked;
+    {
+        cbor::input input(tagged_key.data(), tagged_key.size());
+        key_marking_diag listener(marked);
+        cbor::decoder decoder(input, listener);
+        decoder.run();
+    }
+    CHECK(std::string((const char *) marked.data(), marked.size()) == "{1(2(K5)): 2}\n");
+}
+
+/// diagnostic notation of data, or the listener's error
+static std::string diag_text(const std::vector<unsigned char> &data, size_t chunk_threshold = 0)
+{
+    cbor::output_dynamic text;
+    cbor::input input(data.data(), data.size());
+    cbor::listener_diag listener(text);
+    cbor::decoder decoder(input, listener);
+    decoder.set_chunk_threshold(chunk_threshold);
+    decoder.run();
+    listener.flush();
+    if (listener.failed())
+        return "error: " + listener.error();
+    if (not listener.complete())
+        return "incomplete: " + std::string((const char *) text.data(), text.size());
+    return std::string((const char *) text.data(), text.size());
+}
+
+static void test_diag_output()
+{
+    // one line per top level item
+    CHECK(diag_text({0x01, 0x20, 0x1a, 0x00, 0x0f, 0x42, 0x40, 0x39, 0x03, 0xe7}) == "1\n-1\n1000000\n-1000\n");
+    CHECK(diag_text({0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                     0xff, 0xff}) == "18446744073709551615\n-18446744073709551616\n");
+    CHECK(diag_text({0x8b, 0x63, 'a', '"', '\n', 0x42, 0x00, 0xff, 0x40, 0x60, 0xf5, 0xf4, 0xf6, 0xf7, 0xf0, 0xf8, 0xff,
+                     0xa1, 0x61, 'k', 0x80}) ==
+          "[\"a\\\"\\n\", h'00ff', h'', \"\", true, false, null, undefined, simple(16), simple(255), {\"k\": []}]\n");
+    CHECK(diag_text({0xa2, 0x01, 0xa0, 0x02, 0x81, 0x80}) == "{1: {}, 2: [[]]}\n");
+
+    // tags, nested and with 8 byte numbers
+    CHECK(diag_text({0xc1, 0x1a, 0x59, 0x68, 0x2f, 0x00}) == "1(1500000000)\n");
+    CHECK(diag_text({0x82, 0xc2, 0xd8, 0x18, 0x41, 0x01, 0xdb, 0, 0, 0, 1, 0, 0, 0, 0, 0x01}) ==
+          "[2(24(h'01')), 4294967296(1)]\n");
+
+    // floats carry their width
+    CHECK(diag_text({0x83, 0xf9, 0x3e, 0x00, 0xfa, 0x3f, 0xc0, 0, 0, 0xfb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0}) ==
+          "[1.5_1, 1.5_2, 1.5_3]\n");
+    CHECK(diag_text({0x84, 0xf9, 0x7c, 0x00, 0xfa, 0xff, 0x80, 0, 0, 0xfb, 0x7f, 0xf8, 0, 0, 0, 0, 0, 0,
+                     0xf9, 0x80, 0x00}) == "[Infinity_1, -Infinity_2, NaN_3, -0.0_1]\n");
+    cbor::output_dynamic floats;
+    cbor::encoder encoder(floats);
+    encoder.write_array(2);
+    encoder.write_float(0.1f);
+    encoder.write_double(0.1);
+    CHECK(diag_of(floats) == "[0.1_2, 0.1_3]\n");
+
+    // indefinite lengths are not decoded, a break code is not a value
+    CHECK(diag_text({0x9f, 0x01, 0xff}) == "error: invalid array type");
+    CHECK(diag_text({0xbf, 0xff}) == "error: invalid array type");
+    CHECK(diag_text({0x5f, 0x41, 0x00, 0xff}) == "error: invalid bytes type");
+    CHECK(diag_text({0x7f, 0x61, 'a', 0xff}) == "error: invalid string type");
+    CHECK(diag_text({0x81, 0xff}) == "error: invalid special type");
+
+    // what arrives so far, and long strings written in pieces as they are decoded
+    CHECK(diag_text({0x82, 0x01}) == "incomplete: [1");
+    std::vector<unsigned char> big = {0x59, 0x01, 0x00};
+    std::string hex = "h'";
+    for (int i = 0; i < 256; ++i)
+    {
+        big.push_back((unsigned char) i);
+        hex += "0123456789abcdef"[i >> 4];
+        hex += "0123456789abcdef"[i & 15];
+    }
+    CHECK(diag_text(big, 16) == hex + "'\n");
+    CHECK(diag_text(big) == hex + "'\n");
+}
+
+/// contents of a file descriptor from the start
+static std::string file_contents(int fd)
+{
+    std::string contents;
+    char buffer[256];
+    ssize_t n;
+    off_t offset = 0;
+    while ((n = pread(fd, buffer, sizeof(buffer), offset)) > 0)
+    {
+        contents.append(buffer, (size_t) n);
+        offset += n;
+    }
+    return contents;
+}
+
+static void test_output_file()
+{
+    char path[] = "/tmp/cborcpp-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+
+    {
+        // 4 byte buffer: small puts wait in it, a put that does not fit flushes it first
+        cbor::output_file out(fd, 4);
+        out.put_byte('a');
+        out.put_bytes((const unsigned char *) "bc", 2);
+        CHECK(file_contents(fd).empty() and out.size() == 3 and out.written() == 3);
+        CHECK(out.toString() == "616263");
+        out.put_bytes((const unsigned char *) "de", 2);
+        CHECK(file_contents(fd) == "abc" and out.size() == 2 and out.written() == 5);
+        out.put_byte('f');
+        out.put_byte('g');
+        out.put_byte('h');
+        CHECK(file_contents(fd) == "abcdefg" and out.size() == 1);
+
+        // as large as the buffer or larger goes straight through
+        out.put_bytes((const unsigned char *) "12345678", 8);
+        CHECK(file_contents(fd) == "abcdefgh12345678" and out.size() == 0 and out.written() == 16);
+
+        out.put_bytes((const unsigned char *) "xy", 2);
+        out.flush();
+        CHECK(file_contents(fd) == "abcdefgh12345678xy" and out.size() == 0);
+        out.put_byte('z');
+        out.sync();
+        CHECK(file_contents(fd) == "abcdefgh12345678xyz");
+        out.put_byte('!');
+    }
+    // the destructor flushes, and leaves a descriptor it does not own open
+    CHECK(file_contents(fd) == "abcdefgh12345678xyz!");
+    close(fd);
+
+    {
+        cbor::output_file truncated(path, 2);
+        truncated.put_bytes((const unsigned char *) "new", 3);
+        CHECK(truncated.written() == 3);
+    }
+    const int check = open(path, O_RDONLY);
+    CHECK(check >= 0 and file_contents(check) == "new");
+    if (check >= 0)
+        close(check);
+
+    {
+        cbor::output_file appended(path, 65536, true);
+        appended.put_byte(0x01);
+    }
+    const int reopened = open(path, O_RDONLY);
+    CHECK(reopened >= 0 and file_contents(reopened) == "new\x01");
+    if (reopened >= 0)
+        close(reopened);
+    unlink(path);
+    CHECK_RAISES(cbor::output_file("/nonexistent-directory/file"));
+}
+
+static void test_sharded_array()
+{
+    // shard i holds i strings, shard 0 stays empty and is left out of the segments
+    cbor::sharded_array array(4);
+    std::vector<std::string> expected;
+    for (unsigned shard = 0; shard < array.shards(); ++shard)
+    {
+        for (unsigned i = 0; i < shard; ++i)
+        {
+            expected.push_back("s" + std::to_string(shard) + "." + std::to_string(i));
+            array.shard(shard).write_string(expected.back());
+            array.add_items(shard);
+        }
+    }
+    CHECK(array.size() == 6 and array.segments().size() == 4);
+
+    cbor::output_dynamic copied;
+    array.copy_to(copied);
+    CHECK(copied.size() == array.encoded_size());
+    cbor::input input(copied.data(), copied.size());
+    cbor::decoder decoder(input);
+    CHECK(decoder.try_read_array().value() == expected.size());
+    for (const std::string &text : expected)
+        CHECK(decoder.try_read_string().value() == text);
+    CHECK(input.remaining() == 0);
+
+    char path[] = "/tmp/cborcpp-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+    CHECK(array.write_to(fd) == (ssize_t) copied.size());
+    CHECK(file_contents(fd) == std::string((const char *) copied.data(), copied.size()));
+
+    // more segments than one writev() takes, with a header wider than a byte
+    cbor::sharded_array many(1500);
+    cbor::output_dynamic sequential;
+    cbor::encoder encoder(sequential);
+    encoder.write_array(1500 * 2);
+    for (unsigned shard = 0; shard < many.shards(); ++shard)
+    {
+        many.shard(shard).write_int(shard);
+        many.shard(shard).write_string("x");
+        many.add_items(shard, 2);
+        encoder.write_int(shard);
+        encoder.write_string("x");
+    }
+    CHECK(ftruncate(fd, 0) == 0 and lseek(fd, 0, SEEK_SET) == 0);
+    CHECK(many.write_to(fd) == (ssize_t) sequential.size() and many.encoded_size() == sequential.size());
+    CHECK(file_contents(fd) == std::string((const char *) sequential.data(), sequential.size()));
+    close(fd);
+    unlink(path);
+
+    // cleared shards start over
+    many.clear();
+    CHECK(many.size() == 0 and many.segments().size() == 1 and many.encoded_size() == 1);
+    many.shard(7).write_null();
+    many.add_items(7);
+    cbor::output_dynamic one;
+    many.copy_to(one);
+    CHECK(one.size() == 2 and one.data()[0] == 0x81 and one.data()[1] == 0xf6);
+}
+
+/// events of one record decoded on its own
+static std::string record_events(const unsigned char *data, size_t size)
+{
+    recording_listener listener;
+    cbor::input input(data, size);
+    cbor::decoder decoder(input, listener);
+    decoder.run();
+    return listener.events + listener.error;
+}
+
+static void test_sequence_reader()
+{
+    cbor::thread_pool pool(4);
+    CHECK(pool.size() == 4);
+
+    // every task runs once, on a worker of the pool
+    std::vector<int> runs(1000, 0);
+    bool workers_in_range = true;
+    pool.run(runs.size(), [&](unsigned worker, size_t task) {
+        runs[task]++;
+        if (worker >= 4)
+            workers_in_range = false;
+    });
+    CHECK(workers_in_range and std::count(runs.begin(), runs.end(), 1) == (long) runs.size());
+    CHECK_RAISES(pool.run(100, [](unsigned, size_t task) {
+        if (task == 37)
+            cbor::raise("task failed");
+    }));
+    size_t after_error = 0;
+    pool.run(1, [&](unsigned, size_t) { after_error++; });
+    CHECK(after_error == 1);
+
+    // a sequence of records of different kinds and sizes, each also encoded on its own
+    std::vector<std::string> expected;
+    cbor::output_dynamic sequence;
+    cbor::encoder encoder(sequence);
+    for (int i = 0; i < 1000; ++i)
+    {
+        cbor::output_dynamic record;
+        cbor::encoder single(record);
+        switch (i % 4)
+        {
+            case 0: single.write_int(i * 1000); break;
+            case 1: single.write_string("record " + std::string(i % 40, 'x')); break;
+            case 2:
+                single.write_array(2);
+                single.write_int(-i);
+                single.write_double(i * 0.5);
+                break;
+            default:
+                single.write_map(2);
+                single.write_string("k");
+                single.write_int(i);
+                single.write_string("v");
+                single.write_array(2);
+                single.write_bool(true);
+                single.write_null();
+                break;
+        }
+        expected.push_back(record_events(record.data(), record.size()));
+        sequence.put_bytes(record.data(), record.size());
+    }
+
+    char path[] = "/tmp/cborcpp-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+    CHECK(write(fd, sequence.data(), sequence.size()) == (ssize_t) sequence.size());
+    close(fd);
+    cbor::mapped_file file(path);
+    unlink(path);
+    CHECK(file.size() == sequence.size() and memcmp(file.data(), sequence.data(), file.size()) == 0);
+
+    cbor::sequence_reader reader(file.data(), file.size(), pool);
+    CHECK(reader.scan() == expected.size());
+    size_t size;
+    const unsigned char *third = reader.record(3, size);
+    CHECK(record_events(third, size) == expected[3]);
+    CHECK(reader.scan(10) == 10 and reader.scan() == expected.size());
+
+    class events_handler : public cbor::record_handler {
+    public:
+        std::vector<std::string> events;
+        std::vector<std::pair<size_t, size_t>> ordered;
+
+        explicit events_handler(size_t records) : events(records) {}
+
+        void on_record(unsigned worker, size_t index, const unsigned char *data, size_t size) override
+        {
+            events[index] = record_events(data, size);
+        }
+
+        void on_ordered(size_t first, size_t last) override { ordered.emplace_back(first, last); }
+    };
+
+    reader.set_chunk_size(7);
+    events_handler unordered(expected.size());
+    reader.run(unordered);
+    CHECK(unordered.events == expected and unordered.ordered.empty());
+
+    // ordered ranges come contiguous and in order, whatever order the chunks finish in
+    events_handler ordered(expected.size());
+    reader.run(ordered, true);
+    CHECK(ordered.events == expected and not ordered.ordered.empty());
+    size_t next = 0;
+    for (const auto &range : ordered.ordered)
+    {
+        CHECK(range.first == next and range.second > range.first and range.second - range.first <= 7);
+        next = range.second;
+    }
+    CHECK(next == expected.size());
+
+    // one listener per worker sees every record once between them
+    reader.set_chunk_size(0);
+    std::vector<recording_listener> listeners(pool.size());
+    std::vector<cbor::listener *> pointers;
+    for (recording_listener &listener : listeners)
+        pointers.push_back(&listener);
+    reader.run(pointers);
+    size_t events = 0, sequential = 0;
+    for (const recording_listener &listener : listeners)
+        events += listener.events.size();
+    for (const std::string &record : expected)
+        sequential += record.size();
+    CHECK(events == sequential);
+    pointers.pop_back();
+    CHECK_RAISES(reader.run(pointers));
+}
+
+static void test_array_reader()
+{
+    // write_double() puts its head once, followed by the big-endian bits
+    cbor::output_dynamic floats;
+    cbor::encoder float_encoder(floats);
+    float_encoder.write_double(1.5);
+    float_encoder.write_float(1.5f);
+    float_encoder.write_double(-0.0);
+    const unsigned char float_bytes[] = {
+        0xfb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,
+        0xfa, 0x3f, 0xc0, 0, 0,
+        0xfb, 0x80, 0, 0, 0, 0, 0, 0, 0
+    };
+    CHECK(floats.size() == sizeof(float_bytes) and memcmp(floats.data(), float_bytes, sizeof(float_bytes)) == 0);
+
+    // an array split across workers decodes to what a sequential decode gives
+    cbor::thread_pool pool(3);
+    const size_t count = 3000;
+    cbor::output_dynamic array;
+    cbor::encoder encoder(array);
+    encoder.write_array(count);
+    for (size_t i = 0; i < count; ++i)
+        encoder.write_double(i % 3 == 0 ? i * 0.25 : -(double) i);
+
+    cbor::input input(array.data(), array.size());
+    cbor::decoder decoder(input);
+    std::vector<double> decoded(decoder.read_array());
+    for (double &value : decoded)
+        value = decoder.read_double();
+    CHECK(input.remaining() == 0);
+
+    cbor::array_reader elements(array.data(), array.size(), pool);
+    CHECK(elements.size() == count and elements.scan() == count and elements.encoded_size() == array.size());
+    size_t size;
+    const unsigned char *last = elements.element(count - 1, size);
+    CHECK(last == array.data() + array.size() - 9 and size == 9);
+    std::vector<double> slots(count, 1.0);
+    elements.set_chunk_size(64);
+    elements.decode(slots.data(), [](cbor::decoder &dec, double &slot) { slot = dec.read_double(); });
+    CHECK(slots == decoded);
+
+    cbor::array_reader truncated(array.data(), array.size() - 1, pool);
+    CHECK_RAISES(truncated.scan());
+    cbor::output_dynamic empty;
+    cbor::encoder(empty).write_array(0);
+    cbor::array_reader none(empty.data(), empty.size(), pool);
+    CHECK(none.scan() == 0 and none.encoded_size() == 1);
+    none.decode(slots.data(), [](cbor::decoder &dec, double &slot) { slot = 0; });
+    CHECK(slots == decoded);
+}
+
+static void test_json_reader()
+{
+    // integers down to -2^64 stay integers
+    CHECK(json_to_cbor("-18446744073709551616") == std::string("\x3b\xff\xff\xff\xff\xff\xff\xff\xff", 9));
+    CHECK(json_to_cbor("-18446744073709551615") == std::string("\x3b\xff\xff\xff\xff\xff\xff\xff\xfe", 9));
+    CHECK(json_to_cbor("-9223372036854775808") == std::string("\x3b\x7f\xff\xff\xff\xff\xff\xff\xff", 9));
+    CHECK(json_to_cbor("18446744073709551615") == std::string("\x1b\xff\xff\xff\xff\xff\xff\xff\xff", 9));
+    CHECK(json_to_cbor("-0") == std::string("\x00", 1));
+    // one below is a float again
+    CHECK(json_to_cbor("-18446744073709551617") == std::string("\xfa\xdf\x80\x00\x00", 5));
+    CHECK(json_to_cbor("[-18446744073709551616]") == std::string("\x81\x3b\xff\xff\xff\xff\xff\xff\xff\xff", 10));
+
+    // a decimal comma locale must not change how numbers read
+    const std::string with_c = json_to_cbor("[0.30000000000000004, 1.5e-300, 123456789.123456789]");
+    for (const char *name : {"de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "fr_FR"})
+    {
+        if (setlocale(LC_NUMERIC, name) == nullptr)
+            continue;
+        CHECK(json_to_cbor("[0.30000000000000004, 1.5e-300, 123456789.123456789]") == with_c);
+        setlocale(LC_NUMERIC, "C");
+        break;
+    }
+}
+
+static void test_stats()
+{
+    if (not cbor::stats_enabled())
+        return;
+
+    recording_tag_handler handler;
+    cbor::tag_registry tags;
+    tags.add(7, handler);
+
+    // tag(5) 1, tag(7) 2; the handler skips the 2, and skipped items are not counted
+    const std::vector<unsigned char> data = {0xc5, 0x01, 0xc7, 0x02};
+
+    cbor::reset_stats();
+    run_events(data, cbor::decoder_limits(), nullptr, cbor::get_default_resource(), &tags);
+    cbor::stats_snapshot stats = cbor::get_stats();
+    CHECK(stats.decoded_items[6] == 2 and stats.decoded_bytes[6] == 2);
+    CHECK(stats.decoded_items[0] == 1);
+
+    // resuming an incomplete tag must not count it again
+    cbor::reset_stats();
+    run_split(data, 1, cbor::decoder_limits(), &tags);
+    stats = cbor::get_stats();
+    CHECK(stats.decoded_items[6] == 2 and stats.decoded_bytes[6] == 2);
+    CHECK(stats.decoded_items[0] == 1);
+
+    const std::vector<unsigned char> long_head = {0xd9, 0x01, 0x00, 0x01, 0xd9, 0x00, 0x07, 0x82, 0x01, 0x02};
+    cbor::reset_stats();
+    run_split(long_head, 1, cbor::decoder_limits(), &tags);
+    stats = cbor::get_stats();
+    CHECK(stats.decoded_items[6] == 2 and stats.decoded_bytes[6] == 6);
+}
+
+/// bit at a time, straight from the polynomial
+static uint32_t reference_crc32c(const unsigned char *data, size_t size, uint32_t crc)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+    }
+    return ~crc;
+}
+
+static void test_crc32c()
+{
+    CHECK(cbor::crc32c("123456789", 9) == 0xe3069283);
+    CHECK(cbor::crc32c_portable("123456789", 9) == 0xe3069283);
+    CHECK(cbor::crc32c("", 0) == 0);
+
+    // RFC 3720 B.4
+    unsigned char block[32];
+    memset(block, 0, sizeof(block));
+    CHECK(cbor::crc32c(block, 32) == 0x8a9136aa);
+    memset(block, 0xff, sizeof(block));
+    CHECK(cbor::crc32c(block, 32) == 0x62a8ab43);
+    for (int i = 0; i < 32; ++i)
+        block[i] = (unsigned char) i;
+    CHECK(cbor::crc32c(block, 32) == 0x46dd794e);
+
+    // whatever crc32c_hardware() says, both paths agree with the reference at every length and alignment
+    std::mt19937_64 random(47);
+    std::vector<unsigned char> data(4096 + 16);
+    for (unsigned char &b : data)
+        b = (unsigned char) random();
+    for (int round = 0; round < 2000; ++round)
+    {
+        const size_t size = round < 1040 ? round % 65 : random() % 4096;
+        const unsigned char *p = data.data() + random() % 16;
+        const uint32_t expected = reference_crc32c(p, size, 0);
+        CHECK(cbor::crc32c(p, size) == expected);
+        CHECK(cbor::crc32c_portable(p, size) == expected);
+
+        // continued over two pieces
+        const size_t split = size == 0 ? 0 : random() % size;
+        CHECK(cbor::crc32c(p + split, size - split, cbor::crc32c(p, split)) == expected);
+        CHECK(cbor::crc32c_portable(p + split, size - split, cbor::crc32c_portable(p, split)) == expected);
+    }
+}
+
+struct log_contents
+{
+    std::vector<std::string> records;
+    size_t valid_end;
+    unsigned long long corrupt;
+    bool truncated;
+};
+
+static log_contents read_log(const std::vector<unsigned char> &data)
+{
+    cbor::input input(data.data(), data.size());
+    cbor::log_reader reader(input);
+    log_contents log;
+    const unsigned char *record;
+    size_t size;
+    while (reader.next(record, size))
+        log.records.push_back(std::string((const char *) record, size));
+    log.valid_end = reader.valid_end();
+    log.corrupt = reader.corrupt_records();
+    log.truncated = reader.truncated();
+    return log;
+}
+
+static void test_record_log()
+{
+    std::mt19937_64 random(48);
+    std::vector<std::string> records;
+    std::vector<size_t> starts, ends;
+    cbor::output_dynamic framed;
+    cbor::log_writer writer(framed);
+    for (int i = 0; i < 200; ++i)
+    {
+        std::string record = "r" + std::to_string(i) + ":";
+        const size_t size = random() % 100;
+        for (size_t k = 0; k < size; ++k)
+            record += (char) random();
+        // a magic inside a payload must not start a frame
+        if (i % 10 == 0)
+            record += "\xff" "LOG";
+
+        starts.push_back(framed.size());
+        writer.append(record.data(), record.size());
+        ends.push_back(framed.size());
+        records.push_back(record);
+    }
+    writer.commit();
+    const std::vector<unsigned char> log(framed.data(), framed.data() + framed.size());
+
+    log_contents intact = read_log(log);
+    CHECK(intact.records == records);
+    CHECK(intact.valid_end == log.size() and intact.corrupt == 0 and not intact.truncated);
+
+    // records that do not touch the damaged bytes [first, last) all survive, the others are lost
+    auto survivors = [&](size_t first, size_t last) {
+        std::vector<std::string> expected;
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            if (ends[i] <= first or starts[i] >= last)
+                expected.push_back(records[i]);
+        }
+        return expected;
+    };
+
+    for (int round = 0; round < 500; ++round)
+    {
+        std::vector<unsigned char> damaged = log;
+        const size_t at = random() % log.size();
+        damaged[at] ^= (unsigned char) (1 << (random() % 8));
+        const log_contents read = read_log(damaged);
+        CHECK(read.records == survivors(at, at + 1));
+        CHECK(read.corrupt != 0 or read.truncated);
+    }
+
+    for (int round = 0; round < 300; ++round)
+    {
+        const size_t first = random() % log.size();
+        const size_t last = std::min(log.size(), first + 1 + (size_t) (random() % 200));
+        std::vector<unsigned char> damaged = log;
+        damaged.erase(damaged.begin() + first, damaged.begin() + last);
+        CHECK(read_log(damaged).records == survivors(first, last));
+    }
+
+    // a crash mid-write leaves a prefix: whole records survive, the tail is truncated
+    for (int round = 0; round < 500; ++round)
+    {
+        const size_t cut = round < 40 ? round : random() % (log.size() + 1);
+        const std::vector<unsigned char> prefix(log.begin(), log.begin() + cut);
+        const log_contents read = read_log(prefix);
+
+        size_t complete = 0;
+        while (complete < ends.size() and ends[complete] <= cut)
+            complete++;
+        const size_t boundary = complete == 0 ? 0 : ends[complete - 1];
+        CHECK(read.records == std::vector<std::string>(records.begin(), records.begin() + complete));
+        CHECK(read.valid_end == boundary and read.corrupt == 0 and read.truncated == (cut != boundary));
+
+        // appending after truncating to valid_end gives a clean log again
+        std::vector<unsigned char> repaired(prefix.begin(), prefix.begin() + read.valid_end);
+        repaired.insert(repaired.end(), log.begin() + boundary, log.end());
+        CHECK(read_log(repaired).records == records);
+    }
+
+    // a damaged record and then a torn last one: both lost, and the log is still truncated. The
+    // record right before the torn one is the hard case, one scan goes over both
+    const size_t last = records.size() - 1;
+    for (int round = 0; round < 200; ++round)
+    {
+        const size_t damaged_record = last - 1 - random() % 3;
+        const size_t at = starts[damaged_record] + random() % (ends[damaged_record] - starts[damaged_record]);
+        const size_t cut = starts[last] + 1 + random() % (ends[last] - starts[last] - 1);
+        std::vector<unsigned char> damaged(log.begin(), log.begin() + cut);
+        damaged[at] ^= (unsigned char) (1 << (random() % 8));
+
+        std::vector<std::string> expected = survivors(at, at + 1);
+        expected.pop_back();
+        const log_contents read = read_log(damaged);
+        CHECK(read.records == expected);
+        CHECK(read.valid_end == starts[damaged_record + 1 == last ? damaged_record : last] and read.truncated);
+    }
+}
+
+static void test_columnar()
+{
+    // one declared column, the other fields of the first row are still inferred
+    cbor::output_dynamic rows;
+    cbor::encoder encoder(rows);
+    encoder.write_array(2);
+    encoder.write_map(3);
+    encoder.write_string("ts");
+    encoder.write_int(1);
+    encoder.write_string("host");
+    encoder.write_string("a");
+    encoder.write_string("value");
+    encoder.write_int(3);
+    encoder.write_map(3);
+    encoder.write_string("ts");
+    encoder.write_int(2);
+    encoder.write_string("host");
+    encoder.write_string("b");
+    encoder.write_string("value");
+    encoder.write_double(2.5);
+
+    cbor::columnar_table table;
+    table.add("ts", cbor::column_type::float64);
+    cbor::columnar_reader reader;
+    CHECK(reader.try_read(rows.data(), rows.size(), table) == cbor::error_code::ok);
+    CHECK(table.rows() == 2 and table.size() == 3);
+    CHECK(table.find("ts") != nullptr and table.find("ts")->type == cbor::column_type::float64);
+    CHECK(table.find("host") != nullptr and table.find("host")->type == cbor::column_type::string);
+    CHECK(table.find("value") != nullptr and table.find("value")->type == cbor::column_type::float64);
+    CHECK(table.find("value")->doubles[0] == 3 and table.find("value")->doubles[1] == 2.5);
+
+    // the second row widens n and adds a dictionary entry to s, then fails on k
+    const long long big = (1LL << 53) + 1;
+    cbor::output_dynamic failing;
+    cbor::encoder failing_encoder(failing);
+    failing_encoder.write_array(2);
+    failing_encoder.write_map(3);
+    failing_encoder.write_string("n");
+    failing_encoder.write_int(big);
+    failing_encoder.write_string("s");
+    failing_encoder.write_string("a");
+    failing_encoder.write_string("k");
+    failing_encoder.write_string("q");
+    failing_encoder.write_map(3);
+    failing_encoder.write_string("s");
+    failing_encoder.write_string("new");
+    failing_encoder.write_string("n");
+    failing_encoder.write_double(2.5);
+    failing_encoder.write_string("k");
+    failing_encoder.write_int(7);
+
+    cbor::columnar_table undone;
+    CHECK(reader.try_read(failing.data(), failing.size(), undone) == cbor::error_code::wrong_type);
+    CHECK(reader.error_row() == 1 and undone.rows() == 1 and undone.size() == 3);
+    const cbor::column *n = undone.find("n");
+    CHECK(n != nullptr and n->type == cbor::column_type::int64 and n->ints.size() == 1 and n->ints[0] == big);
+    CHECK(n->doubles.empty());
+    const cbor::column *text = undone.find("s");
+    CHECK(text != nullptr and text->dictionary.size() == 1 and text->codes.size() == 1);
+
+    // and reading goes on from there
+    cbor::output_dynamic more;
+    cbor::encoder more_encoder(more);
+    more_encoder.write_array(1);
+    more_encoder.write_map(3);
+    more_encoder.write_string("n");
+    more_encoder.write_int(5);
+    more_encoder.write_string("s");
+    more_encoder.write_string("b");
+    more_encoder.write_string("k");
+    more_encoder.write_null();
+    CHECK(reader.try_read(more.data(), more.size(), undone) == cbor::error_code::ok);
+    CHECK(undone.rows() == 2 and n->type == cbor::column_type::int64 and n->ints[1] == 5);
+    CHECK(text->dictionary.size() == 2 and text->text(1) == "b");
+    CHECK(undone.find("k")->is_null(1) and undone.find("k")->null_count == 1);
+
+    // a failed first row leaves no inferred columns behind
+    cbor::output_dynamic nested;
+    cbor::encoder nested_encoder(nested);
+    nested_encoder.write_array(1);
+    nested_encoder.write_map(2);
+    nested_encoder.write_string("a");
+    nested_encoder.write_int(1);
+    nested_encoder.write_string("b");
+    nested_encoder.write_array(0);
+    cbor::columnar_table empty;
+    CHECK(reader.try_read(nested.data(), nested.size(), empty) == cbor::error_code::wrong_type);
+    CHECK(empty.rows() == 0 and empty.size() == 0);
+}
+
+static cbor::result<cbor::numeric_aggregate> aggregate_of(const std::vector<unsigned char> &data,
+                                                          size_t *consumed = nullptr)
+{
+    size_t used = 0;
+    auto result = cbor::try_aggregate_array(data.data(), data.size(), used);
+    if (consumed != nullptr)
+        *consumed = used;
+    return result;
+}
+
+/// a typed array, tag(tag) h'bytes'
+static std::vector<unsigned char> typed_array(unsigned tag, const std::vector<unsigned char> &bytes)
+{
+    std::vector<unsigned char> data = {0xd8, (unsigned char) tag, 0x58, (unsigned char) bytes.size()};
+    data.insert(data.end(), bytes.begin(), bytes.end());
+    return data;
+}
+
+static void test_aggregate()
+{
+    // [1, 2.5 as half, -3, 1.5 as float], and what follows the array is not read
+    size_t consumed = 0;
+    auto mixed = aggregate_of({0x84, 0x01, 0xf9, 0x41, 0x00, 0x22, 0xfa, 0x3f, 0xc0, 0, 0, 0x01}, &consumed);
+    CHECK(mixed and consumed == 11);
+    CHECK(mixed.value().count == 4 and mixed.value().sum == 2 and mixed.value().mean() == 0.5);
+    CHECK(mixed.value().min == -3 and mixed.value().max == 2.5 and not mixed.value().exact);
+
+    // [1, -100, 100] stays exact
+    auto ints = aggregate_of({0x83, 0x01, 0x38, 0x63, 0x18, 0x64});
+    CHECK(ints and ints.value().exact and ints.value().int_sum == 1);
+    CHECK(ints.value().int_min == -100 and ints.value().int_max == 100 and ints.value().sum == 1);
+
+    // integers outside int64 are counted as doubles
+    auto huge = aggregate_of({0x82, 0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                              0x3b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff});
+    CHECK(huge and huge.value().count == 2 and not huge.value().exact);
+    CHECK(huge.value().max == 18446744073709551615.0 and huge.value().min == -18446744073709551616.0);
+
+    // an int64 sum that overflows goes on in the double sum
+    cbor::output_dynamic overflow;
+    cbor::encoder encoder(overflow);
+    encoder.write_array(3);
+    encoder.write_int((long long) INT64_MAX);
+    encoder.write_int(1LL);
+    encoder.write_int(1LL);
+    auto wide = cbor::aggregate_array(overflow.data(), overflow.size());
+    CHECK(wide.count == 3 and not wide.exact and wide.sum == 9223372036854775808.0);
+    CHECK(wide.min == 1 and wide.max == 9223372036854775807.0);
+    overflow.clear();
+    encoder.write_array(2);
+    encoder.write_int((long long) INT64_MAX);
+    encoder.write_int(-1LL);
+    auto within = cbor::aggregate_array(overflow.data(), overflow.size());
+    CHECK(within.exact and within.int_sum == INT64_MAX - 1 and within.int_max == INT64_MAX);
+
+    // NaN makes the sum NaN but not min and max; null and undefined are only counted
+    auto nan = aggregate_of({0x86, 0xf9, 0x7e, 0x00, 0x01, 0xf6, 0xfb, 0x40, 0, 0, 0, 0, 0, 0, 0, 0xf7, 0xf6});
+    CHECK(nan and nan.value().count == 3 and nan.value().nulls == 3);
+    CHECK(isnan(nan.value().sum) and nan.value().min == 1 and nan.value().max == 2);
+
+    auto empty = aggregate_of({0x80});
+    CHECK(empty and empty.value().count == 0 and empty.value().exact and isnan(empty.value().mean()));
+    CHECK(empty.value().min == INFINITY and empty.value().max == -INFINITY);
+
+    // indefinite length, with a byte after the break
+    auto indefinite = aggregate_of({0x9f, 0x01, 0x02, 0xff, 0x05}, &consumed);
+    CHECK(indefinite and consumed == 4 and indefinite.value().int_sum == 3);
+    CHECK(aggregate_of({0x9f}).error() == cbor::error_code::truncated);
+    CHECK(aggregate_of({0x9f, 0x01, 0x02}).error() == cbor::error_code::truncated);
+    CHECK(aggregate_of({0x83, 0x01, 0x02}).error() == cbor::error_code::truncated);
+    CHECK(aggregate_of({0x81, 0xfb, 0x40, 0}).error() == cbor::error_code::truncated);
+    CHECK(aggregate_of({0x81, 0x61, 'a'}).error() == cbor::error_code::wrong_type);
+    CHECK(aggregate_of({0x81, 0x9f, 0xff}).error() == cbor::error_code::wrong_type);
+    CHECK(aggregate_of({0x81, 0xf5}).error() == cbor::error_code::wrong_type);
+    CHECK(aggregate_of({0x01}).error() == cbor::error_code::wrong_type);
+
+    // typed arrays: sint8, sint16 big and little endian, uint32 little endian
+    auto sint8 = aggregate_of(typed_array(72, {0xff, 0x80, 0x7f}));
+    CHECK(sint8 and sint8.value().exact and sint8.value().int_sum == -2);
+    CHECK(sint8.value().int_min == -128 and sint8.value().int_max == 127);
+    auto sint16_be = aggregate_of(typed_array(73, {0xff, 0xfe, 0x01, 0x00}));
+    CHECK(sint16_be and sint16_be.value().int_min == -2 and sint16_be.value().int_max == 256);
+    auto sint16_le = aggregate_of(typed_array(77, {0xff, 0xfe, 0x01, 0x00}));
+    CHECK(sint16_le and sint16_le.value().int_min == -257 and sint16_le.value().int_max == 1);
+    auto uint32_le = aggregate_of(typed_array(70, {0xff, 0xff, 0xff, 0xff, 0x02, 0, 0, 0}));
+    CHECK(uint32_le and uint32_le.value().int_sum == 4294967297LL and uint32_le.value().int_min == 2);
+    auto uint64_le = aggregate_of(typed_array(71, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}));
+    CHECK(uint64_le and not uint64_le.value().exact and uint64_le.value().max == 18446744073709551615.0);
+
+    // clamped uint8 reads as uint8, its signed counterpart is reserved
+    auto clamped = aggregate_of(typed_array(68, {0xff, 0x01}));
+    CHECK(clamped and clamped.value().int_sum == 256 and clamped.value().int_min == 1);
+    CHECK(aggregate_of(typed_array(76, {0x01})).error() == cbor::error_code::invalid_tag_content);
+    CHECK(aggregate_of(typed_array(73, {0x01, 0x02, 0x03})).error() == cbor::error_code::invalid_tag_content);
+    CHECK(aggregate_of(typed_array(83, std::vector<unsigned char>(16))).error() == cbor::error_code::wrong_type);
+    CHECK(aggregate_of(typed_array(87, std::vector<unsigned char>(16))).error() == cbor::error_code::wrong_type);
+    CHECK(aggregate_of({0xd8, 0x40, 0x01}).error() == cbor::error_code::invalid_tag_content);
+    CHECK(aggregate_of({0xc1, 0x81, 0x01}).error() == cbor::error_code::wrong_type);
+
+    // float16 little endian, and float64 in both byte orders past one lane block
+    auto half_le = aggregate_of(typed_array(84, {0x00, 0x3c, 0x00, 0xc0}));
+    CHECK(half_le and half_le.value().sum == -1 and half_le.value().min == -2 and half_le.value().max == 1);
+    std::vector<unsigned char> be, le;
+    for (int i = 0; i < 5; ++i)
+    {
+        double value = i - 1.5;
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (int k = 0; k < 8; ++k)
+        {
+            be.push_back((unsigned char) (bits >> (56 - 8 * k)));
+            le.push_back((unsigned char) (bits >> (8 * k)));
+        }
+    }
+    for (auto typed : {aggregate_of(typed_array(82, be)), aggregate_of(typed_array(86, le))})
+    {
+        CHECK(typed and typed.value().count == 5 and typed.value().sum == 2.5);
+        CHECK(typed.value().min == -1.5 and typed.value().max == 2.5);
+    }
+
+    // float64 items go through the lanes four at a time, the rest one by one
+    for (size_t n = 0; n <= 11; ++n)
+    {
+        for (size_t gap = 0; gap <= n; ++gap)
+        {
+            // an integer at position gap breaks the run, none when gap == n
+            cbor::output_dynamic array;
+            cbor::encoder array_encoder(array);
+            array_encoder.write_array(n + (gap < n ? 1 : 0));
+            double sum = 0, min = INFINITY, max = -INFINITY;
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (i == gap)
+                {
+                    array_encoder.write_int(100);
+                    sum += 100;
+                    max = 100;
+                }
+                // exact in binary, so the lane order does not matter
+                const double value = i % 2 == 0 ? (double) i * 0.25 : -(double) i;
+                array_encoder.write_double(value);
+                sum += value;
+                min = value < min ? value : min;
+                max = value > max ? value : max;
+            }
+            size_t used = 0;
+            auto result = cbor::try_aggregate_array(array.data(), array.size(), used);
+            const uint64_t count = n + (gap < n ? 1 : 0);
+            CHECK(result and used == array.size() and result.value().count == count);
+            CHECK(result.value().sum == sum);
+            if (count != 0)
+                CHECK(result.value().min == min and result.value().max == max);
+        }
+    }
+
+    // NaN inside a run is skipped by the lanes' min and max as well
+    cbor::output_dynamic nans;
+    cbor::encoder nan_encoder(nans);
+    nan_encoder.write_array(6);
+    for (double value : {1.0, (double) NAN, -4.0, 2.0, (double) NAN, 3.0})
+        nan_encoder.write_double(value);
+    auto lanes = cbor::aggregate_array(nans.data(), nans.size());
+    CHECK(lanes.count == 6 and isnan(lanes.sum) and lanes.min == -4 and lanes.max == 3);
+
+    // pull API: moves past the array, or stays where it was
+    const std::vector<unsigned char> pulled = {0x83, 0x82, 0x01, 0x02, 0x82, 0x01, 0x61, 'a', 0x83, 1, 2, 3};
+    cbor::input input(pulled.data(), pulled.size());
+    cbor::decoder decoder(input);
+    CHECK(decoder.try_read_array().value() == 3);
+    auto first = cbor::try_read_aggregate(decoder);
+    CHECK(first and first.value().int_sum == 3 and decoder.offset() == 4);
+    CHECK(cbor::try_read_aggregate(decoder).error() == cbor::error_code::wrong_type);
+    CHECK(decoder.offset() == 4);
+    CHECK(decoder.try_skip() == cbor::error_code::ok);
+    cbor::decoder_limits limits;
+    limits.max_container_size = 2;
+    decoder.set_limits(limits);
+    CHECK(cbor::try_read_aggregate(decoder).error() == cbor::error_code::size_limit);
+    CHECK(decoder.offset() == 8);
+    limits.max_container_size = 3;
+    decoder.set_limits(limits);
+    CHECK(cbor::read_aggregate(decoder).int_sum == 6 and decoder.offset() == pulled.size());
+}
+
+/// an indexed record, {"id": id, "v": value}
+static std::vector<unsigned char> id_record(long long id, int value)
+{
+    cbor::output_dynamic record;
+    cbor::encoder encoder(record);
+    encoder.write_map(2);
+    encoder.write_string("id");
+    encoder.write_int(id);
+    encoder.write_string("v");
+    encoder.write_int(value);
+    return std::vector<unsigned char>(record.data(), record.data() + record.size());
+}
+
+static void test_indexed_file()
+{
+    // ids 0 0 0 2 2 2 4 ..., so runs of equal keys cross the fences every 4 records; 3 bytes come before
+    const int count = 23;
+    cbor::output_dynamic file;
+    const unsigned char prefix[3] = {1, 2, 3};
+    file.put_bytes(prefix, sizeof(prefix));
+    std::vector<std::vector<unsigned char>> records;
+    {
+        cbor::indexed_writer writer(file, "id", 4, sizeof(prefix));
+        for (int i = 0; i < count; ++i)
+        {
+            records.push_back(id_record(i / 3 * 2, i));
+            writer.append(records.back().data(), records.back().size());
+        }
+        CHECK(writer.size() == (size_t) count);
+        writer.finish();
+    }
+
+    cbor::indexed_reader reader(file.data(), file.size());
+    CHECK(reader.size() == (size_t) count and reader.keyed() and reader.key_field() == "id");
+    for (int i = 0; i < count; ++i)
+    {
+        size_t size;
+        const unsigned char *record = reader.record(i, size);
+        CHECK(size == records[i].size() and memcmp(record, records[i].data(), size) == 0);
+    }
+    size_t first_size;
+    CHECK(reader.record(0, first_size) == file.data() + sizeof(prefix));
+    CHECK_RAISES(reader.record(count, first_size));
+
+    for (long long id = 0; id <= 16; ++id)
+    {
+        // the first record with a key at least id, found in the records when it is odd
+        int expected = 0;
+        while (expected < count and expected / 3 * 2 < id)
+            expected++;
+        const cbor::map_index::key key(id);
+        CHECK(reader.lower_bound(key) == (size_t) expected);
+        CHECK(reader.find(key) == (id % 2 == 0 and expected < count ? (size_t) expected : reader.size()));
+    }
+
+    // keys must be there and in order
+    cbor::output_dynamic rejected;
+    cbor::indexed_writer checked(rejected, "id");
+    const auto five = id_record(5, 0), three = id_record(3, 0), again = id_record(5, 1);
+    checked.append(five.data(), five.size());
+    CHECK_RAISES(checked.append(three.data(), three.size()));
+    checked.append(again.data(), again.size());
+    const unsigned char no_key[] = {0xa1, 0x61, 'v', 0x01};
+    const unsigned char not_map[] = {0x82, 0x01, 0x02};
+    const unsigned char two_items[] = {0x01, 0x02};
+    CHECK_RAISES(checked.append(no_key, sizeof(no_key)));
+    CHECK_RAISES(checked.append(not_map, sizeof(not_map)));
+    CHECK_RAISES(checked.append(two_items, sizeof(two_items)));
+    CHECK(checked.size() == 2);
+    checked.finish();
+    CHECK_RAISES(checked.append(five.data(), five.size()));
+    cbor::indexed_reader two(rejected.data(), rejected.size());
+    CHECK(two.size() == 2 and two.find(cbor::map_index::key(5LL)) == 0);
+
+    // a damaged or cut trailer is not read
+    std::vector<unsigned char> damaged(file.data(), file.data() + file.size());
+    damaged[damaged.size() - 20] ^= 1;
+    CHECK_RAISES(cbor::indexed_reader(damaged.data(), damaged.size()));
+    CHECK_RAISES(cbor::indexed_reader(file.data(), file.size() - 1));
+    CHECK_RAISES(cbor::indexed_reader(file.data(), file.size() - cbor::indexed_trailer_size));
+    CHECK_RAISES(cbor::indexed_reader(file.data(), cbor::indexed_trailer_size - 1));
+
+    // without a key field records are found by index only
+    cbor::output_dynamic unkeyed;
+    cbor::indexed_writer plain(unkeyed);
+    const std::vector<unsigned char> item_list[] = {{0x01}, {0x63, 'a', 'b', 'c'}, {0x82, 0x01, 0x02}, {0xf6}};
+    for (const auto &item : item_list)
+        plain.append(item.data(), item.size());
+    plain.finish();
+    cbor::indexed_reader by_index(unkeyed.data(), unkeyed.size());
+    CHECK(by_index.size() == 4 and not by_index.keyed());
+    for (size_t i = 0; i < 4; ++i)
+    {
+        size_t size;
+        const unsigned char *record = by_index.record(i, size);
+        CHECK(size == item_list[i].size() and memcmp(record, item_list[i].data(), size) == 0);
+    }
+    CHECK_RAISES(by_index.lower_bound(cbor::map_index::key(1LL)));
+
+    // an empty keyed container
+    cbor::output_dynamic none;
+    cbor::indexed_writer nothing(none, "id");
+    nothing.finish();
+    cbor::indexed_reader empty(none.data(), none.size());
+    CHECK(empty.size() == 0 and empty.keyed() and empty.find(cbor::map_index::key(1LL)) == 0);
+}
+
 int main() {
     cbor::output_dynamic output;
 
@@ -89,5 +2379,33 @@ int main() {
         decoder.run();
     }
 
-    return 0;
+    test_map_index();
+    test_projection();
+    test_long_lengths();
+    test_byte_order();
+    test_batch_decoder();
+    test_memory_resource();
+    test_key_table();
+    test_limits();
+    test_set_input();
+    test_tag_registry();
+    test_utf8();
+    test_dtoa();
+    test_json_output();
+    test_json_reader();
+    test_diag_output();
+    test_output_file();
+    test_sharded_array();
+    test_sequence_reader();
+    test_array_reader();
+    test_stats();
+    test_crc32c();
+    test_record_log();
+    test_columnar();
+    test_aggregate();
+    test_indexed_file();
+
+    if (failures != 0)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
 }
@@ -0,0 +1,181 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "thread_pool.h"
+
+namespace cbor {
+
+thread_pool::thread_pool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    _fn = nullptr;
+    _generation = 0;
+    _running = 0;
+    _stop = false;
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        _queues.emplace_back(new queue());
+        _queues.back()->next = _queues.back()->end = 0;
+    }
+
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        _threads.emplace_back([this, i]() {
+            unsigned long seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(_lock);
+                    _start.wait(guard, [&]() { return _stop or _generation != seen; });
+                    if (_stop)
+                        return;
+                    seen = _generation;
+                }
+                work(i);
+            }
+        });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+    _start.notify_all();
+
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void thread_pool::run(size_t count, const task_function &fn)
+{
+    if (count == 0)
+        return;
+
+    const size_t workers = _queues.size();
+    for (size_t i = 0; i < workers; ++i)
+    {
+        std::lock_guard<std::mutex> guard(_queues[i]->lock);
+        _queues[i]->next = count * i / workers;
+        _queues[i]->end = count * (i + 1) / workers;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _fn = &fn;
+        _error = nullptr;
+        _running = (unsigned) workers;
+        ++_generation;
+    }
+    _start.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _done.wait(guard, [this]() { return _running == 0; });
+    _fn = nullptr;
+
+#ifndef CBOR_NO_EXCEPTIONS
+    if (_error)
+        std::rethrow_exception(_error);
+#endif
+}
+
+void thread_pool::work(unsigned worker)
+{
+    size_t task;
+    while (pop(worker, task) or steal(worker, task))
+    {
+#ifdef CBOR_NO_EXCEPTIONS
+        (*_fn)(worker, task);
+#else
+        try
+        {
+            (*_fn)(worker, task);
+        } catch (...)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            if (not _error)
+                _error = std::current_exception();
+        }
+#endif
+    }
+
+    std::lock_guard<std::mutex> guard(_lock);
+    if (--_running == 0)
+        _done.notify_all();
+}
+
+bool thread_pool::pop(unsigned worker, size_t &task)
+{
+    queue &own = *_queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (own.next == own.end)
+        return false;
+    task = own.next++;
+    return true;
+}
+
+bool thread_pool::steal(unsigned worker, size_t &task)
+{
+    while (true)
+    {
+        // the victim is the worker with the most work left; its range may
+        // shrink before it is locked again, so that is rechecked below
+        size_t victim = worker;
+        size_t most = 0;
+        for (size_t i = 0; i < _queues.size(); ++i)
+        {
+            std::lock_guard<std::mutex> guard(_queues[i]->lock);
+            size_t left = _queues[i]->end - _queues[i]->next;
+            if (left > most)
+            {
+                most = left;
+                victim = i;
+            }
+        }
+        if (most == 0)
+            return false;
+
+        size_t first, last;
+        {
+            queue &other = *_queues[victim];
+            std::lock_guard<std::mutex> guard(other.lock);
+            size_t left = other.end - other.next;
+            if (left == 0)
+                continue;
+            first = other.end - (left + 1) / 2;
+            last = other.end;
+            other.end = first;
+        }
+
+        queue &own = *_queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        task = first;
+        own.next = first + 1;
+        own.end = last;
+        return true;
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cbor {
+
+    /**
+     * Fixed set of worker threads running batches of indexed tasks.
+     *
+     * Each batch is split into one contiguous task range per worker. A worker
+     * takes tasks from the front of its own range and, once that is empty,
+     * steals the back half of the largest remaining range. The calling thread
+     * works as worker 0.
+     */
+    class thread_pool {
+    public:
+        typedef std::function<void(unsigned worker, size_t task)> task_function;
+
+        /// threads == 0 uses std::thread::hardware_concurrency()
+        explicit thread_pool(unsigned threads = 0);
+
+        thread_pool(const thread_pool &) = delete;
+
+        ~thread_pool();
+
+        unsigned size() const { return (unsigned) _queues.size(); }
+
+        /// runs fn for every task in [0, count) and blocks until all are done;
+        /// the first exception thrown by a task is rethrown here
+        void run(size_t count, const task_function &fn);
+
+    private:
+        struct queue {
+            std::mutex lock;
+            size_t next;
+            size_t end;
+        };
+
+        std::vector<std::unique_ptr<queue>> _queues;
+        std::vector<std::thread> _threads;
+
+        std::mutex _lock;
+        std::condition_variable _start;
+        std::condition_variable _done;
+        const task_function *_fn;
+        unsigned long _generation;
+        unsigned _running;
+        bool _stop;
+        std::exception_ptr _error;
+
+        void work(unsigned worker);
+        bool pop(unsigned worker, size_t &task);
+        bool steal(unsigned worker, size_t &task);
+    };
+}
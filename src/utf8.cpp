@@ -0,0 +1,299 @@
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include "utf8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CBOR_UTF8_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace cbor {
+
+/// length of the sequence started by lead, 0 if lead can not start one
+static inline unsigned sequence_length(unsigned char lead)
+{
+    if (lead < 0x80) return 1;
+    if (lead < 0xC2) return 0;
+    if (lead < 0xE0) return 2;
+    if (lead < 0xF0) return 3;
+    if (lead < 0xF5) return 4;
+    return 0;
+}
+
+/// size of the prefix of data that does not end in a truncated sequence
+static size_t complete_prefix(const unsigned char *data, size_t size)
+{
+    for (size_t back = 1; back <= 3 and back <= size; ++back)
+    {
+        const unsigned char c = data[size - back];
+        if ((c & 0xC0) != 0x80)
+            return sequence_length(c) > back ? size - back : size;
+    }
+    return size;
+}
+
+/// start of the last sequence if it begins in the last three bytes
+static size_t last_lead(const unsigned char *data, size_t size)
+{
+    for (size_t back = 1; back <= 3 and back <= size; ++back)
+    {
+        const unsigned char c = data[size - back];
+        if ((c & 0xC0) != 0x80)
+            return c >= 0xC0 ? size - back : size;
+    }
+    return size;
+}
+
+static bool validate_scalar(const unsigned char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        if (size - i >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0)
+            {
+                i += 8;
+                continue;
+            }
+        }
+
+        const unsigned char lead = data[i];
+        if (lead < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        const unsigned length = sequence_length(lead);
+        if (length == 0 or size - i < length)
+            return false;
+
+        // the lead restricts the second byte to rule out overlong forms,
+        // surrogates and code points past U+10FFFF
+        unsigned char low = 0x80, high = 0xBF;
+        switch (lead)
+        {
+            case 0xE0: low = 0xA0; break;
+            case 0xED: high = 0x9F; break;
+            case 0xF0: low = 0x90; break;
+            case 0xF4: high = 0x8F; break;
+        }
+        if (data[i + 1] < low or data[i + 1] > high)
+            return false;
+
+        for (unsigned k = 2; k < length; ++k)
+        {
+            if ((data[i + k] & 0xC0) != 0x80)
+                return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+#ifdef CBOR_UTF8_SSSE3
+
+/*
+ * Lookup based validation (Keiser and Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte"). Each error class is one bit; a byte pair
+ * is an error if the bit is set in all three tables indexed by the high and
+ * low nibble of the first byte and the high nibble of the second.
+ */
+enum : uint8_t
+{
+    TOO_SHORT = 1 << 0,     // lead not followed by a continuation
+    TOO_LONG = 1 << 1,      // continuation after ASCII
+    OVERLONG_3 = 1 << 2,
+    TOO_LARGE = 1 << 3,
+    SURROGATE = 1 << 4,
+    OVERLONG_2 = 1 << 5,
+    TOO_LARGE_1000 = 1 << 6,
+    OVERLONG_4 = 1 << 6,
+    TWO_CONTS = 1 << 7,     // continuation after continuation, checked below
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+__attribute__((target("ssse3")))
+static inline __m128i high_nibbles(__m128i v)
+{
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i check_block(__m128i input, __m128i previous)
+{
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            TOO_SHORT | OVERLONG_2,
+            TOO_SHORT,
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY,
+            CARRY,
+            CARRY | TOO_LARGE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000);
+
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    const __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+    const __m128i special = _mm_and_si128(
+            _mm_and_si128(_mm_shuffle_epi8(byte_1_high_table, high_nibbles(prev1)),
+                          _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+            _mm_shuffle_epi8(byte_2_high_table, high_nibbles(input)));
+
+    // the third and fourth byte of a sequence must be continuations, which
+    // is exactly where a TWO_CONTS pair is allowed
+    const __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+    const __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+    const __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xE0 - 0x80)));
+    const __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xF0 - 0x80)));
+    const __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char) 0x80));
+
+    return _mm_xor_si128(must_continue, special);
+}
+
+__attribute__((target("ssse3")))
+static bool validate_ssse3(const unsigned char *data, size_t size)
+{
+    // a sequence that starts in the last bytes of the previous block and
+    // does not fit into it
+    const __m128i incomplete_max = _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1));
+
+    __m128i error = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i previous_incomplete = _mm_setzero_si128();
+
+    const size_t blocks = size & ~(size_t) 15;
+    for (size_t i = 0; i < blocks; i += 16)
+    {
+        const __m128i input = _mm_loadu_si128((const __m128i *) (data + i));
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            error = _mm_or_si128(error, previous_incomplete);
+            previous_incomplete = _mm_setzero_si128();
+        } else
+        {
+            error = _mm_or_si128(error, check_block(input, previous));
+            previous_incomplete = _mm_subs_epu8(input, incomplete_max);
+        }
+        previous = input;
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF)
+        return false;
+
+    // the rest, including a sequence cut by the last block, is checked
+    // from its first byte
+    const size_t tail = last_lead(data, blocks);
+    return validate_scalar(data + tail, size - tail);
+}
+
+static bool has_ssse3()
+{
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+#endif
+
+static bool validate(const unsigned char *data, size_t size)
+{
+#ifdef CBOR_UTF8_SSSE3
+    if (size >= 16 and has_ssse3())
+        return validate_ssse3(data, size);
+#endif
+    return validate_scalar(data, size);
+}
+
+bool is_valid_utf8(const char *data, size_t size)
+{
+    return validate((const unsigned char *) data, size);
+}
+
+void utf8_validator::reset()
+{
+    _pendingSize = 0;
+    _valid = true;
+}
+
+bool utf8_validator::update(const char *data, size_t size)
+{
+    if (not _valid)
+        return false;
+
+    auto bytes = (const unsigned char *) data;
+
+    if (_pendingSize != 0)
+    {
+        // finish the code point split off the previous chunk
+        const size_t length = sequence_length(_pending[0]);
+        size_t take = length - _pendingSize;
+        if (take > size)
+            take = size;
+
+        memcpy(_pending + _pendingSize, bytes, take);
+        _pendingSize += (unsigned) take;
+        bytes += take;
+        size -= take;
+
+        if (_pendingSize < length)
+            return true;
+
+        _pendingSize = 0;
+        if (not validate_scalar(_pending, length))
+            return _valid = false;
+    }
+
+    const size_t complete = complete_prefix(bytes, size);
+    if (not validate(bytes, complete))
+        return _valid = false;
+
+    _pendingSize = (unsigned) (size - complete);
+    memcpy(_pending, bytes + complete, _pendingSize);
+    return true;
+}
+
+}
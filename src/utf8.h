@@ -0,0 +1,50 @@
+#pragma once
+/*
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+#include <stddef.h>
+
+namespace cbor {
+
+    /**
+     * True if data is well-formed UTF-8 as required for CBOR text strings
+     * (RFC 3629: no overlong forms, surrogates or code points past U+10FFFF).
+     *
+     * Uses SSSE3 when the CPU has it (checked once at runtime on x86), a
+     * word-at-a-time ASCII skip plus scalar checks otherwise.
+     */
+    bool is_valid_utf8(const char *data, size_t size);
+
+    /**
+     * Incremental validation of a string that arrives in chunks. A code
+     * point split between chunks is carried over, no byte is read twice.
+     */
+    class utf8_validator {
+    private:
+        unsigned char _pending[4];
+        unsigned _pendingSize;
+        bool _valid;
+
+    public:
+        utf8_validator() { reset(); }
+
+        void reset();
+
+        /// false once the string is known to be invalid
+        bool update(const char *data, size_t size);
+
+        /// true if the whole string was valid and did not end mid code point
+        bool finish() const { return _valid and _pendingSize == 0; }
+    };
+}